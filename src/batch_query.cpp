@@ -0,0 +1,127 @@
+#include "batch_query.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "route_model.h"
+#include "route_planner.h"
+#include "thread_pool.h"
+
+namespace {
+
+// A line of the query stream.
+struct Query {
+    std::string text;
+    std::size_t line;  // Line number, counting from 1
+};
+
+// Parses "start_x start_y end_x end_y"; returns false if the line holds anything else.
+bool ParseQuery(std::string_view text, std::array<float, 4>& coords) {
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+    const auto skip_blanks = [&] {
+        while (first != last && (*first == ' ' || *first == '\t' || *first == '\r')) ++first;
+    };
+    for (float& value : coords) {
+        skip_blanks();
+        const auto [end, error] = std::from_chars(first, last, value);
+        if (error != std::errc{}) return false;
+        first = end;
+    }
+    skip_blanks();
+    return first == last;
+}
+
+}  // namespace
+
+/**
+ * Answers a single query line in the format of RunBatchQueries().
+ * @param model The route model.
+ * @param context The search state to reuse; must not be shared with a concurrent query.
+ * @param query The query line, without the line break.
+ * @param line The line number reported if the query is invalid.
+ * @param options The settings; only the hierarchy and the landmarks are used.
+ * @param result Receives the result line, without the line break.
+ */
+void AnswerQuery(const RouteModel& model, SearchContext& context, std::string_view query, std::size_t line,
+                 const BatchOptions& options, std::string& result) {
+    std::array<float, 4> coords;
+    if (!ParseQuery(query, coords)) {
+        result = "error " + std::to_string(line);
+        return;
+    }
+
+    RoutePlanner planner{model, context, coords[0], coords[1], coords[2], coords[3]};
+    if (options.hierarchy) {
+        planner.SetSearchMode(RoutePlanner::SearchMode::ContractionHierarchy);
+        planner.SetContractionHierarchy(options.hierarchy);
+    }
+    planner.SetLandmarks(options.landmarks);
+    planner.AStarSearch();
+
+    const auto& path = planner.Path();
+    if (path.empty()) {
+        result = "-1";
+        return;
+    }
+    char buffer[32];
+    result.assign(buffer, std::to_chars(buffer, buffer + sizeof(buffer), planner.GetDistance(),
+                                        std::chars_format::fixed, 2).ptr);
+    for (const auto& node : path) {
+        result += ' ';
+        result.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), node.Index()).ptr);
+    }
+}
+
+/**
+ * Answers a stream of route queries on one loaded map.
+ * @param model The route model.
+ * @param in The query stream.
+ * @param out The result stream.
+ * @param options The settings.
+ * @return The number of queries answered, including invalid ones.
+ */
+std::size_t RunBatchQueries(const RouteModel& model, std::istream& in, std::ostream& out, const BatchOptions& options) {
+    ThreadPool pool{options.threads};
+    const std::size_t chunk_size = std::max<std::size_t>(1, options.chunk_size);
+    const std::size_t blocks = 4 * pool.Size();
+    std::vector<SearchContext> contexts(blocks);  // One per block; a block runs on one worker at a time
+
+    std::vector<Query> queries;
+    std::vector<std::string> results;
+    std::size_t line_number = 0;
+    std::size_t answered = 0;
+    std::string line;
+    bool more = true;
+    while (more) {
+        queries.clear();
+        while (queries.size() < chunk_size && (more = static_cast<bool>(std::getline(in, line)))) {
+            ++line_number;
+            const auto text = std::string_view{line}.substr(std::min(line.find_first_not_of(" \t\r"), line.size()));
+            if (text.empty() || text.front() == '#') continue;
+            queries.push_back({std::string{text}, line_number});
+        }
+        if (queries.empty()) break;
+
+        results.resize(queries.size());
+        const std::size_t used_blocks = std::min(blocks, queries.size());
+        pool.ParallelFor(used_blocks, [&](std::size_t block) {
+            const std::size_t first = block * queries.size() / used_blocks;
+            const std::size_t last = (block + 1) * queries.size() / used_blocks;
+            for (std::size_t i = first; i < last; ++i) {
+                AnswerQuery(model, contexts[block], queries[i].text, queries[i].line, options, results[i]);
+            }
+        });
+
+        for (std::size_t i = 0; i < queries.size(); ++i) {
+            out << results[i] << '\n';
+        }
+        out.flush();
+        answered += queries.size();
+    }
+    return answered;
+}
@@ -0,0 +1,57 @@
+#ifndef BATCH_QUERY_H
+#define BATCH_QUERY_H
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+class ContractionHierarchy;
+class Landmarks;
+class RouteModel;
+class SearchContext;
+
+/**
+ * Settings of RunBatchQueries().
+ */
+struct BatchOptions {
+    std::size_t threads = 0;                          // Worker threads; 0 uses one per hardware thread
+    std::size_t chunk_size = 4096;                    // Queries read and solved at a time
+    const ContractionHierarchy* hierarchy = nullptr;  // Hierarchy to answer queries with, if any
+    const Landmarks* landmarks = nullptr;             // Landmarks for the A* heuristic, if any
+};
+
+/**
+ * Answers a single query line in the format of RunBatchQueries().
+ * @param model The route model.
+ * @param context The search state to reuse; must not be shared with a concurrent query.
+ * @param query The query line, without the line break.
+ * @param line The line number reported if the query is invalid.
+ * @param options The settings; only the hierarchy and the landmarks are used.
+ * @param result Receives the result line, without the line break.
+ */
+void AnswerQuery(const RouteModel& model, SearchContext& context, std::string_view query, std::size_t line,
+                 const BatchOptions& options, std::string& result);
+
+/**
+ * Answers a stream of route queries on one loaded map.
+ *
+ * Every input line holds one query, "start_x start_y end_x end_y" in the coordinate range taken
+ * by RoutePlanner; empty lines and lines starting with '#' are skipped. For every query one line
+ * is written, in input order:
+ *   "<distance in meters> <node index> <node index> ..." for the path from start to end,
+ *   "-1" if the end cannot be reached, or
+ *   "error <line number>" if the line is not a valid query.
+ * Queries are read in chunks and each chunk is solved in parallel, every worker reusing one
+ * SearchContext, so the memory use does not grow with the length of the stream.
+ *
+ * @param model The route model.
+ * @param in The query stream.
+ * @param out The result stream.
+ * @param options The settings.
+ * @return The number of queries answered, including invalid ones.
+ */
+std::size_t RunBatchQueries(const RouteModel& model, std::istream& in, std::ostream& out,
+                            const BatchOptions& options = {});
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "span.h"
+
+/**
+ * Helpers for the binary file formats (map snapshots, contraction hierarchies): a file is a
+ * fixed header followed by length-prefixed arrays of trivially copyable values, each padded
+ * so that the next array starts on an 8-byte boundary and can be viewed in place.
+ */
+namespace binary_io {
+
+constexpr std::size_t kAlignment = 8;  // Every array starts on an 8-byte boundary
+
+/**
+ * Appends length-prefixed, padded arrays to an in-memory image of a file.
+ */
+class Writer {
+public:
+    std::size_t Position() const noexcept { return m_Buffer.size(); }
+
+    template <typename T>
+    void Array(const T* data, std::size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const std::uint64_t n = count;
+        Append(&n, sizeof(n));
+        Append(data, count * sizeof(T));
+        m_Buffer.resize((m_Buffer.size() + kAlignment - 1) / kAlignment * kAlignment, '\0');
+    }
+
+    template <typename T>
+    void Array(const std::vector<T>& values) { Array(values.data(), values.size()); }
+
+    void Patch(std::size_t position, const void* data, std::size_t size) {
+        std::memcpy(m_Buffer.data() + position, data, size);
+    }
+
+    void Reserve(std::size_t size) { m_Buffer.resize(m_Buffer.size() + size, '\0'); }
+
+    const std::string& Buffer() const noexcept { return m_Buffer; }
+
+private:
+    void Append(const void* data, std::size_t size) {
+        m_Buffer.append(static_cast<const char*>(data), size);
+    }
+
+    std::string m_Buffer;
+};
+
+/**
+ * Reads the arrays written by Writer, checking every access against the buffer bounds.
+ * Any violation throws std::logic_error with the message given to the constructor.
+ */
+class Reader {
+public:
+    Reader(Span<const std::byte> data, std::uint64_t offset, const char* corrupt_message)
+        : m_Data(data), m_Pos(offset), m_CorruptMessage(corrupt_message) {
+        if (offset > data.size()) Fail();
+    }
+
+    template <typename T>
+    Span<const T> Array() {
+        std::uint64_t count;
+        Read(&count, sizeof(count));
+        if (count > (m_Data.size() - m_Pos) / sizeof(T)) Fail();
+        const auto* first = m_Data.data() + m_Pos;
+        if (reinterpret_cast<std::uintptr_t>(first) % alignof(T) != 0) Fail();
+        m_Pos += count * sizeof(T);
+        m_Pos = std::min<std::uint64_t>((m_Pos + kAlignment - 1) / kAlignment * kAlignment, m_Data.size());
+        return {reinterpret_cast<const T*>(first), static_cast<std::size_t>(count)};
+    }
+
+    [[noreturn]] void Fail() const { throw std::logic_error(m_CorruptMessage); }
+
+private:
+    void Read(void* out, std::size_t size) {
+        if (size > m_Data.size() - m_Pos) Fail();
+        std::memcpy(out, m_Data.data() + m_Pos, size);
+        m_Pos += size;
+    }
+
+    Span<const std::byte> m_Data;
+    std::uint64_t m_Pos;
+    const char* m_CorruptMessage;  // Message of the exception thrown on malformed input
+};
+
+}  // namespace binary_io
+
+#endif
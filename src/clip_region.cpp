@@ -0,0 +1,194 @@
+#include "clip_region.h"
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Bands of a polygon at most; more only pay off for polygons of very many edges.
+constexpr int kMaxBands = 4096;
+
+// Reads the numbers of a line separated by blanks or the given separator; returns false if the
+// line holds anything else.
+bool ParseNumbers(std::string_view text, char separator, double* values, std::size_t count) {
+    const char* first = text.data();
+    const char* last = text.data() + text.size();
+    const auto skip_blanks = [&] {
+        while (first != last && (*first == ' ' || *first == '\t' || *first == '\r')) ++first;
+    };
+    for (std::size_t i = 0; i < count; ++i) {
+        skip_blanks();
+        if (i > 0 && separator != ' ') {
+            if (first == last || *first != separator) return false;
+            ++first;
+            skip_blanks();
+        }
+        if (first != last && *first == '+') ++first;  // Accepted by strtod, not by from_chars
+        const auto [end, error] = std::from_chars(first, last, values[i]);
+        if (error != std::errc{}) return false;
+        first = end;
+    }
+    skip_blanks();
+    return first == last;
+}
+
+// Returns the next line of a text without its line break and blanks around it, and advances past it.
+std::string_view NextLine(std::string_view& text) {
+    const auto end = text.find('\n');
+    auto line = text.substr(0, end);
+    text = end == std::string_view::npos ? std::string_view{} : text.substr(end + 1);
+    const auto first = line.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos) return {};
+    return line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+}
+
+}  // namespace
+
+/**
+ * Creates a box region.
+ * @param min_lat The southern edge.
+ * @param min_lon The western edge.
+ * @param max_lat The northern edge.
+ * @param max_lon The eastern edge.
+ * @return The region.
+ */
+ClipRegion ClipRegion::Box(double min_lat, double min_lon, double max_lat, double max_lon) {
+    if (!(min_lat < max_lat) || !(min_lon < max_lon)) {
+        throw std::invalid_argument("Clip box is empty.");
+    }
+    ClipRegion region;
+    region.m_MinLat = min_lat;
+    region.m_MinLon = min_lon;
+    region.m_MaxLat = max_lat;
+    region.m_MaxLon = max_lon;
+    return region;
+}
+
+/**
+ * Creates a polygon region. Rings of fewer than three vertices are ignored.
+ * @param rings The rings of the polygon.
+ * @return The region.
+ */
+ClipRegion ClipRegion::Polygon(const std::vector<std::vector<Point>>& rings) {
+    ClipRegion region;
+    std::vector<Edge> edges;
+    for (const auto& ring : rings) {
+        if (ring.size() < 3) continue;
+        for (std::size_t i = 0; i < ring.size(); ++i) {
+            const auto& from = ring[i];
+            const auto& to = ring[(i + 1) % ring.size()];
+            if (edges.empty()) {
+                region.m_MinLat = region.m_MaxLat = from.lat;
+                region.m_MinLon = region.m_MaxLon = from.lon;
+            }
+            region.m_MinLat = std::min(region.m_MinLat, from.lat);
+            region.m_MaxLat = std::max(region.m_MaxLat, from.lat);
+            region.m_MinLon = std::min(region.m_MinLon, from.lon);
+            region.m_MaxLon = std::max(region.m_MaxLon, from.lon);
+            edges.push_back({from.lat, from.lon, to.lat, to.lon});
+        }
+    }
+    if (edges.empty() || !(region.m_MinLat < region.m_MaxLat) || !(region.m_MinLon < region.m_MaxLon)) {
+        throw std::invalid_argument("Clip polygon is empty.");
+    }
+
+    // Counting sort of the edges into every band their latitudes span
+    const int bands = std::min<int>(static_cast<int>(edges.size()), kMaxBands);
+    region.m_BandHeight = (region.m_MaxLat - region.m_MinLat) / bands;
+    region.m_BandStart.assign(bands + 1, 0);
+    const auto band_range = [&](const Edge& edge) {
+        return std::pair{region.Band(std::min(edge.lat0, edge.lat1)), region.Band(std::max(edge.lat0, edge.lat1))};
+    };
+    for (const auto& edge : edges) {
+        const auto [first, last] = band_range(edge);
+        for (int band = first; band <= last; ++band) {
+            ++region.m_BandStart[band + 1];
+        }
+    }
+    for (int band = 0; band < bands; ++band) {
+        region.m_BandStart[band + 1] += region.m_BandStart[band];
+    }
+    region.m_Edges.resize(region.m_BandStart.back());
+    auto next = region.m_BandStart;
+    for (const auto& edge : edges) {
+        const auto [first, last] = band_range(edge);
+        for (int band = first; band <= last; ++band) {
+            region.m_Edges[next[band]++] = edge;
+        }
+    }
+    return region;
+}
+
+/**
+ * Parses a box given as "min_lat,min_lon,max_lat,max_lon".
+ * @param text The box.
+ * @return The region.
+ */
+ClipRegion ClipRegion::ParseBox(std::string_view text) {
+    double values[4];
+    if (!ParseNumbers(text, ',', values, 4)) {
+        throw std::invalid_argument("Clip box must be given as min_lat,min_lon,max_lat,max_lon: " + std::string{text});
+    }
+    return Box(values[0], values[1], values[2], values[3]);
+}
+
+/**
+ * Parses a polygon in the Osmosis .poly format. Holes need no special treatment, as rings
+ * inside other rings already exclude their inside.
+ * @param text The contents of the .poly file.
+ * @return The region.
+ */
+ClipRegion ClipRegion::ParsePoly(std::string_view text) {
+    const auto fail = [] { throw std::invalid_argument("Clip polygon is not in the .poly format."); };
+    std::vector<std::vector<Point>> rings;
+    NextLine(text);  // Name of the polygon
+    while (true) {
+        if (text.empty()) fail();
+        const auto section = NextLine(text);
+        if (section == "END") break;
+        auto& ring = rings.emplace_back();
+        while (true) {
+            if (text.empty()) fail();
+            const auto line = NextLine(text);
+            if (line == "END") break;
+            double lon_lat[2];
+            if (!ParseNumbers(line, ' ', lon_lat, 2)) fail();
+            ring.push_back({lon_lat[1], lon_lat[0]});
+        }
+    }
+    return Polygon(rings);
+}
+
+/**
+ * Checks whether a point lies in the region. For a polygon, a ray from the point eastwards
+ * crosses the edges of the point's band an odd number of times if the point is inside.
+ * @param lat The latitude of the point.
+ * @param lon The longitude of the point.
+ * @return True if the point is inside.
+ */
+bool ClipRegion::Contains(double lat, double lon) const noexcept {
+    if (lat < m_MinLat || lat > m_MaxLat || lon < m_MinLon || lon > m_MaxLon) return false;
+    if (m_BandStart.empty()) return true;  // A box
+
+    const int band = Band(lat);
+    bool inside = false;
+    for (int i = m_BandStart[band]; i < m_BandStart[band + 1]; ++i) {
+        const auto& e = m_Edges[i];
+        if ((e.lat0 > lat) != (e.lat1 > lat) && lon < e.lon0 + (lat - e.lat0) * (e.lon1 - e.lon0) / (e.lat1 - e.lat0)) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+/**
+ * Returns the band holding a latitude inside the bounding box.
+ * @param lat The latitude.
+ * @return The index of the band.
+ */
+int ClipRegion::Band(double lat) const noexcept {
+    const int bands = static_cast<int>(m_BandStart.size()) - 1;
+    return std::clamp(static_cast<int>((lat - m_MinLat) / m_BandHeight), 0, bands - 1);
+}
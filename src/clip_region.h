@@ -0,0 +1,81 @@
+#ifndef CLIP_REGION_H
+#define CLIP_REGION_H
+
+#include <string_view>
+#include <vector>
+
+/**
+ * The ClipRegion class describes the part of an OSM extract to load: a latitude/longitude
+ * box or a polygon. A polygon may have several rings; a point is inside if it lies inside an
+ * odd number of them, so rings inside other rings are holes. Polygon edges are bucketed into
+ * horizontal bands in compressed-sparse-row form, so a test only visits the edges of one band.
+ */
+class ClipRegion {
+public:
+    // A vertex of a polygon.
+    struct Point {
+        double lat = 0.0;
+        double lon = 0.0;
+    };
+
+    /**
+     * Creates a box region.
+     * @throws std::invalid_argument if the box is empty.
+     */
+    static ClipRegion Box(double min_lat, double min_lon, double max_lat, double max_lon);
+
+    /**
+     * Creates a polygon region.
+     * @param rings The rings of the polygon; they need not repeat their first vertex at the end.
+     * @throws std::invalid_argument if there is no ring of at least three vertices.
+     */
+    static ClipRegion Polygon(const std::vector<std::vector<Point>>& rings);
+
+    /**
+     * Parses a box given as "min_lat,min_lon,max_lat,max_lon".
+     * @throws std::invalid_argument if the text is not such a box.
+     */
+    static ClipRegion ParseBox(std::string_view text);
+
+    /**
+     * Parses a polygon in the Osmosis .poly format: a name line, then sections of "lon lat"
+     * lines ended by END, where sections whose name starts with '!' are holes, then END.
+     * @throws std::invalid_argument if the text is not such a polygon.
+     */
+    static ClipRegion ParsePoly(std::string_view text);
+
+    /**
+     * Checks whether a point lies in the region.
+     * @param lat The latitude of the point.
+     * @param lon The longitude of the point.
+     * @return True if the point is inside.
+     */
+    bool Contains(double lat, double lon) const noexcept;
+
+    // The bounding box of the region.
+    double MinLat() const noexcept { return m_MinLat; }
+    double MinLon() const noexcept { return m_MinLon; }
+    double MaxLat() const noexcept { return m_MaxLat; }
+    double MaxLon() const noexcept { return m_MaxLon; }
+
+private:
+    // An edge of a polygon ring, from (lat0, lon0) to (lat1, lon1).
+    struct Edge {
+        double lat0, lon0, lat1, lon1;
+    };
+
+    ClipRegion() = default;
+
+    // Returns the band holding a latitude inside the bounding box.
+    int Band(double lat) const noexcept;
+
+    double m_MinLat = 0.0;
+    double m_MinLon = 0.0;
+    double m_MaxLat = 0.0;
+    double m_MaxLon = 0.0;
+    std::vector<Edge> m_Edges;    // Polygon edges, band after band; empty for a box
+    std::vector<int> m_BandStart; // Edge range start per band, plus a final sentinel
+    double m_BandHeight = 1.0;    // Latitude span of a band
+};
+
+#endif
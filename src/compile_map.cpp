@@ -0,0 +1,90 @@
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "clip_region.h"
+#include "contraction_hierarchy.h"
+#include "map_snapshot.h"
+#include "mapped_file.h"
+#include "route_model.h"
+
+/**
+ * Offline map compiler: parses an OSM XML extract once and writes a binary snapshot
+ * that OSM_A_star_search (and anything else building a RouteModel) loads directly.
+ * Optionally also preprocesses a contraction hierarchy of the road graph. With --routing-only,
+ * the snapshot keeps only the roads and their nodes, for headless routing; with --bbox or
+ * --poly, only the part of the extract inside a box or a polygon.
+ *
+ * Usage: compile_map [--routing-only] [--bbox min_lat,min_lon,max_lat,max_lon | --poly region.poly]
+ *                    input.osm[.gz|.bz2|.pbf] output.rpmap [output.rpch]
+ */
+int main(int argc, const char** argv) {
+    auto profile = RouteModel::Profile::Full;
+    std::optional<ClipRegion> clip;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (arg == "--routing-only") {
+            profile = RouteModel::Profile::Routing;
+        } else if ((arg == "--bbox" || arg == "--poly") && ++i < argc) {
+            try {
+                if (arg == "--bbox") {
+                    clip = ClipRegion::ParseBox(argv[i]);
+                } else if (auto poly_data = MappedFile::Open(argv[i])) {
+                    clip = ClipRegion::ParsePoly(
+                        {reinterpret_cast<const char*>(poly_data->Bytes().data()), poly_data->Bytes().size()});
+                } else {
+                    std::cerr << "Failed to open file or file is empty: " << argv[i] << std::endl;
+                    return -1;
+                }
+            } catch (const std::invalid_argument& e) {
+                std::cerr << e.what() << std::endl;
+                return -1;
+            }
+        } else {
+            files.emplace_back(arg);
+        }
+    }
+    if (files.size() != 2 && files.size() != 3) {
+        std::cerr << "Usage: " << argv[0] << " [--routing-only] [--bbox min_lat,min_lon,max_lat,max_lon | "
+                  << "--poly region.poly] input.osm[.gz|.bz2|.pbf] output.rpmap [output.rpch]" << std::endl;
+        return -1;
+    }
+    const std::string input = files[0];
+    const std::string output = files[1];
+    const std::string hierarchy_output = files.size() == 3 ? files[2] : "";
+
+    auto osm_data = MappedFile::Open(input);
+    if (!osm_data) {
+        std::cerr << "Failed to open file or file is empty: " << input << std::endl;
+        return -1;
+    }
+
+    try {
+        const auto start = std::chrono::steady_clock::now();
+        RouteModel model{osm_data->Bytes(), 0, profile, clip ? &*clip : nullptr};
+        MapSnapshot::Write(model, output);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << "Compiled " << model.Nodes().size() << " nodes, " << model.Ways().size() << " ways and "
+                  << model.Roads().size() << " roads into " << output << " (snapshot version "
+                  << MapSnapshot::kVersion << ") in " << elapsed.count() << " s." << std::endl;
+
+        if (!hierarchy_output.empty()) {
+            const auto ch_start = std::chrono::steady_clock::now();
+            const ContractionHierarchy hierarchy{model};
+            hierarchy.Write(hierarchy_output);
+            const std::chrono::duration<double> ch_elapsed = std::chrono::steady_clock::now() - ch_start;
+
+            std::cout << "Contracted " << hierarchy.NodeCount() << " nodes with " << hierarchy.ShortcutCount()
+                      << " shortcuts into " << hierarchy_output << " in " << ch_elapsed.count() << " s." << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to compile " << input << ": " << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,561 @@
+#include "contraction_hierarchy.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "binary_io.h"
+#include "priority_queue.h"
+#include "route_model.h"
+#include "search_context.h"
+
+namespace {
+
+using binary_io::Reader;
+using binary_io::Writer;
+
+constexpr char kMagic[8] = {'R', 'P', 'C', 'H', 'I', 'E', 'R', 'A'};
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+constexpr char kCorrupt[] = "Contraction hierarchy file is truncated or corrupt.";
+
+// Witness searches give up after settling this many nodes and add the shortcut instead.
+constexpr std::size_t kWitnessSettleLimit = 64;
+
+// Fixed-size header at the start of every hierarchy file.
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t fingerprint;  // Fingerprint of the routing graph the hierarchy was built for
+    std::uint64_t size;         // Total size of the file in bytes
+};
+
+// Rejects a malformed hierarchy file.
+[[noreturn]] void Fail() { throw std::logic_error(kCorrupt); }
+
+// An edge of the graph that remains while nodes are contracted.
+struct Arc {
+    int target;
+    float weight;
+    int middle;  // Contracted node the edge bypasses, or -1 for an edge of the routing graph
+};
+
+// A shortcut required to contract a node.
+struct Shortcut {
+    int from;
+    int to;
+    float weight;
+};
+
+/**
+ * Contracts the nodes of a routing graph, least important first. The importance of a node is
+ * estimated from its edge difference (shortcuts added minus edges removed), its number of
+ * already contracted neighbors and its depth in the hierarchy, and is re-evaluated lazily:
+ * the node on top of the queue is only contracted if its updated priority is still the smallest.
+ */
+class Contractor {
+public:
+    explicit Contractor(const RouteModel& model) : m_Graph(model.SNodes().size()) {
+        const auto node_count = m_Graph.size();
+        for (std::size_t i = 0; i < node_count; ++i) {
+            const auto targets = model.Neighbors(static_cast<int>(i));
+            const auto lengths = model.NeighborDistances(static_cast<int>(i));
+            for (std::size_t j = 0; j < targets.size(); ++j) {
+                if (targets[j] != static_cast<int>(i)) {
+                    AddArc(static_cast<int>(i), targets[j], lengths[j], -1);
+                }
+            }
+        }
+        m_ContractedNeighbors.assign(node_count, 0);
+        m_Depth.assign(node_count, 0);
+        m_Dist.assign(node_count, 0.0f);
+        m_Stamp.assign(node_count, 0);
+        m_Heap.Resize(node_count);
+    }
+
+    /**
+     * Contracts every node.
+     * @param rank Receives the contraction order per node.
+     * @param upward Receives the edges from every node to the nodes contracted after it.
+     */
+    void Run(std::vector<int>& rank, std::vector<std::vector<Arc>>& upward) {
+        const auto node_count = m_Graph.size();
+        rank.assign(node_count, 0);
+        upward.assign(node_count, {});
+
+        IndexedDaryHeap<4> queue{node_count};
+        for (std::size_t i = 0; i < node_count; ++i) {
+            FindShortcuts(static_cast<int>(i));
+            queue.Push(static_cast<int>(i), Priority(static_cast<int>(i)));
+        }
+
+        int next_rank = 0;
+        while (!queue.Empty()) {
+            const int node = queue.Pop();
+            FindShortcuts(node);
+            const float priority = Priority(node);
+            if (!queue.Empty() && priority > queue.TopKey()) {
+                queue.Push(node, priority);  // Became more important since it was queued
+                continue;
+            }
+            rank[node] = next_rank++;
+            Contract(node);
+            upward[node] = std::move(m_Graph[node]);
+        }
+    }
+
+private:
+    // Estimates the importance of a node from the shortcuts last found for it.
+    float Priority(int node) const {
+        const auto edge_difference = static_cast<float>(m_Shortcuts.size()) - static_cast<float>(m_Graph[node].size());
+        return 2.0f * edge_difference + static_cast<float>(m_ContractedNeighbors[node]) + static_cast<float>(m_Depth[node]);
+    }
+
+    // Collects in m_Shortcuts the shortcuts needed to remove a node without changing any distance.
+    void FindShortcuts(int node) {
+        m_Shortcuts.clear();
+        const auto& arcs = m_Graph[node];
+        for (std::size_t i = 0; i + 1 < arcs.size(); ++i) {
+            float limit = 0.0f;
+            for (std::size_t j = i + 1; j < arcs.size(); ++j) {
+                limit = std::max(limit, arcs[i].weight + arcs[j].weight);
+            }
+            WitnessSearch(arcs[i].target, node, limit);
+            for (std::size_t j = i + 1; j < arcs.size(); ++j) {
+                const float via = arcs[i].weight + arcs[j].weight;
+                if (Distance(arcs[j].target) > via) {
+                    m_Shortcuts.push_back({arcs[i].target, arcs[j].target, via});
+                }
+            }
+        }
+    }
+
+    // Removes a node from the graph, adding the shortcuts in m_Shortcuts.
+    void Contract(int node) {
+        for (const Arc& arc : m_Graph[node]) {
+            auto& back = m_Graph[arc.target];
+            back.erase(std::find_if(back.begin(), back.end(), [node](const Arc& a) { return a.target == node; }));
+            ++m_ContractedNeighbors[arc.target];
+            m_Depth[arc.target] = std::max(m_Depth[arc.target], m_Depth[node] + 1);
+        }
+        for (const Shortcut& shortcut : m_Shortcuts) {
+            AddArc(shortcut.from, shortcut.to, shortcut.weight, node);
+            AddArc(shortcut.to, shortcut.from, shortcut.weight, node);
+        }
+    }
+
+    // Adds an edge, or shortens an existing edge between the same nodes.
+    void AddArc(int from, int to, float weight, int middle) {
+        for (Arc& arc : m_Graph[from]) {
+            if (arc.target == to) {
+                if (weight < arc.weight) {
+                    arc.weight = weight;
+                    arc.middle = middle;
+                }
+                return;
+            }
+        }
+        m_Graph[from].push_back({to, weight, middle});
+    }
+
+    // Runs a bounded Dijkstra search from a node that avoids the node being contracted.
+    void WitnessSearch(int source, int excluded, float limit) {
+        if (++m_Epoch == 0) {
+            std::fill(m_Stamp.begin(), m_Stamp.end(), 0);
+            m_Epoch = 1;
+        }
+        m_Heap.Clear();
+        m_Stamp[source] = m_Epoch;
+        m_Dist[source] = 0.0f;
+        m_Heap.Push(source, 0.0f);
+        for (std::size_t settled = 0; !m_Heap.Empty() && m_Heap.TopKey() <= limit && settled < kWitnessSettleLimit;
+             ++settled) {
+            const int current = m_Heap.Pop();
+            for (const Arc& arc : m_Graph[current]) {
+                if (arc.target == excluded) continue;
+                const float dist = m_Dist[current] + arc.weight;
+                if (m_Stamp[arc.target] != m_Epoch || dist < m_Dist[arc.target]) {
+                    m_Stamp[arc.target] = m_Epoch;
+                    m_Dist[arc.target] = dist;
+                    m_Heap.PushOrDecrease(arc.target, dist);
+                }
+            }
+        }
+    }
+
+    // Returns the distance found by the last witness search, or infinity.
+    float Distance(int node) const {
+        return m_Stamp[node] == m_Epoch ? m_Dist[node] : std::numeric_limits<float>::infinity();
+    }
+
+    std::vector<std::vector<Arc>> m_Graph;  // Remaining graph, every edge stored in both directions
+    std::vector<int> m_ContractedNeighbors;  // Number of contracted neighbors per node
+    std::vector<int> m_Depth;                // Upper bound of the hierarchy depth below each node
+    std::vector<Shortcut> m_Shortcuts;       // Result of the last FindShortcuts()
+
+    // Witness search state, stamped per search like a SearchContext
+    std::vector<float> m_Dist;
+    std::vector<std::uint32_t> m_Stamp;
+    std::uint32_t m_Epoch = 0;
+    IndexedDaryHeap<4> m_Heap;
+};
+
+// Reads and validates the header of a hierarchy file.
+Header ReadHeader(Span<const std::byte> data) {
+    Header header;
+    if (data.size() < sizeof(header)) Fail();
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) Fail();
+    if (header.byte_order != kByteOrderMark) {
+        throw std::logic_error("Contraction hierarchy was written on a machine with a different byte order.");
+    }
+    if (header.version != ContractionHierarchy::kVersion) {
+        throw std::logic_error("Unsupported contraction hierarchy version " + std::to_string(header.version) +
+                               "; rebuild the hierarchy.");
+    }
+    if (header.size != data.size()) Fail();
+    return header;
+}
+
+}  // namespace
+
+/**
+ * Constructor: Builds the hierarchy for the routing graph of a model.
+ * @param model The route model.
+ */
+ContractionHierarchy::ContractionHierarchy(const RouteModel& model) : m_Fingerprint(Fingerprint(model)) {
+    std::vector<std::vector<Arc>> upward;
+    Contractor{model}.Run(m_Rank, upward);
+
+    m_UpOffsets.reserve(upward.size() + 1);
+    m_UpOffsets.push_back(0);
+    for (const auto& arcs : upward) {
+        for (const Arc& arc : arcs) {
+            m_UpTargets.push_back(arc.target);
+            m_UpWeights.push_back(arc.weight);
+            m_UpMiddles.push_back(arc.middle);
+        }
+        m_UpOffsets.push_back(static_cast<int>(m_UpTargets.size()));
+    }
+}
+
+/**
+ * Identifies the routing graph of a model by hashing its edges (FNV-1a).
+ * @param model The route model.
+ * @return The fingerprint.
+ */
+std::uint64_t ContractionHierarchy::Fingerprint(const RouteModel& model) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    const auto mix = [&hash](const void* data, std::size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+        }
+    };
+    const std::uint64_t node_count = model.SNodes().size();
+    mix(&node_count, sizeof(node_count));
+    for (std::size_t i = 0; i < node_count; ++i) {
+        const auto targets = model.Neighbors(static_cast<int>(i));
+        const auto lengths = model.NeighborDistances(static_cast<int>(i));
+        const std::uint32_t degree = static_cast<std::uint32_t>(targets.size());
+        mix(&degree, sizeof(degree));
+        mix(targets.data(), targets.size() * sizeof(int));
+        mix(lengths.data(), lengths.size() * sizeof(float));
+    }
+    return hash;
+}
+
+/**
+ * Returns the number of shortcuts added by the preprocessing.
+ */
+std::size_t ContractionHierarchy::ShortcutCount() const noexcept {
+    return static_cast<std::size_t>(std::count_if(m_UpMiddles.begin(), m_UpMiddles.end(),
+                                                  [](int middle) { return middle != kNoMiddle; }));
+}
+
+/**
+ * Returns the index of the upward edge between two adjacent nodes of the hierarchy.
+ * @param from One end of the edge.
+ * @param to The other end of the edge.
+ * @return The edge index, or -1 if the nodes are not adjacent.
+ */
+int ContractionHierarchy::FindEdge(int from, int to) const {
+    if (m_Rank[from] > m_Rank[to]) {
+        std::swap(from, to);
+    }
+    for (int e = m_UpOffsets[from]; e < m_UpOffsets[from + 1]; ++e) {
+        if (m_UpTargets[e] == to) return e;
+    }
+    return -1;
+}
+
+/**
+ * Appends the graph nodes of the edge from -> to, without from, to a path.
+ * A shortcut is replaced by the two edges through its middle node until only
+ * edges of the routing graph remain.
+ * @param from The start of the edge.
+ * @param to The end of the edge.
+ * @param path The path to extend.
+ */
+void ContractionHierarchy::Unpack(int from, int to, std::vector<int>& path) const {
+    std::vector<std::pair<int, int>> pending{{from, to}};
+    while (!pending.empty()) {
+        const auto [a, b] = pending.back();
+        pending.pop_back();
+        const int middle = m_UpMiddles[FindEdge(a, b)];
+        if (middle == kNoMiddle) {
+            path.push_back(b);
+        } else {
+            pending.push_back({middle, b});  // Second half, unpacked after the first
+            pending.push_back({a, middle});
+        }
+    }
+}
+
+/**
+ * Relaxes the upward edges of a node just taken from the open list, unless the node is stalled:
+ * a higher-ranked node already reached reaches it more cheaply, so it cannot lie on a shortest
+ * route and its edges need not be followed.
+ * @param node_idx The node.
+ * @param search The search state of the direction being expanded.
+ * @param queue The open list of that direction.
+ * @return False if the node is stalled.
+ */
+template <typename Queue>
+bool ContractionHierarchy::ExpandUpward(int node_idx, SearchContext& search, Queue& queue) const {
+    const int first = m_UpOffsets[node_idx];
+    const int last = m_UpOffsets[node_idx + 1];
+    const float g = search.G(node_idx);
+    for (int e = first; e < last; ++e) {
+        if (search.G(m_UpTargets[e]) + m_UpWeights[e] < g) {
+            return false;
+        }
+    }
+    for (int e = first; e < last; ++e) {
+        const int neighbor_idx = m_UpTargets[e];
+        const bool reached = search.Reached(neighbor_idx);
+        if (reached && !queue.Contains(neighbor_idx)) {
+            continue;  // Already settled in this direction
+        }
+        const float g_value = g + m_UpWeights[e];
+        if (reached && g_value >= search.G(neighbor_idx)) {
+            continue;
+        }
+        search.SetLabel(neighbor_idx, g_value, node_idx);
+        queue.PushOrDecrease(neighbor_idx, g_value);
+    }
+    return true;
+}
+
+/**
+ * Finds a shortest route between two nodes with a bidirectional search over the upward edges.
+ * Both searches settle nodes in order of their distance and the route passes through the
+ * highest-ranked node on it, which both searches reach; the search stops once neither open
+ * list holds a node closer than the best route found. Stalled nodes are not expanded.
+ * @param start_idx The index of the start node.
+ * @param end_idx The index of the end node.
+ * @param context The search state; its backward companion holds the search from the end.
+ * @return The route, with all shortcuts unpacked.
+ */
+ContractionHierarchy::Route ContractionHierarchy::Query(int start_idx, int end_idx, SearchContext& context) const {
+    Route route;
+    SearchContext& forward = context;
+    SearchContext& backward = context.Backward();
+    forward.Prepare(NodeCount());
+    backward.Prepare(NodeCount());
+    forward.SetLabel(start_idx, 0.0f, SearchContext::kNoParent);
+    backward.SetLabel(end_idx, 0.0f, SearchContext::kNoParent);
+
+    constexpr float kInfinity = std::numeric_limits<float>::infinity();
+    float best = kInfinity;  // Length of the shortest route found so far
+    int meeting_idx = SearchContext::kNoParent;
+
+    std::visit([&](auto& forward_queue, auto& backward_queue) {
+        forward_queue.Push(start_idx, 0.0f);
+        backward_queue.Push(end_idx, 0.0f);
+
+        // Expands the top node of one direction
+        const auto expand = [&](SearchContext& search, auto& queue, const SearchContext& other) {
+            const int current_idx = queue.Pop();
+            ++route.settled_nodes;
+            const float current_g = search.G(current_idx);
+            if (other.Reached(current_idx) && current_g + other.G(current_idx) < best) {
+                best = current_g + other.G(current_idx);
+                meeting_idx = current_idx;
+            }
+            ExpandUpward(current_idx, search, queue);
+        };
+
+        while (true) {
+            const float forward_key = forward_queue.Empty() ? kInfinity : forward_queue.TopKey();
+            const float backward_key = backward_queue.Empty() ? kInfinity : backward_queue.TopKey();
+            if (std::min(forward_key, backward_key) >= best) {
+                break;  // Also reached once both queues are empty
+            }
+            if (forward_key <= backward_key) {
+                expand(forward, forward_queue, backward);
+            } else {
+                expand(backward, backward_queue, forward);
+            }
+        }
+    }, forward.Queue(), backward.Queue());
+
+    if (meeting_idx == SearchContext::kNoParent) {
+        return route;
+    }
+
+    // Hierarchy path: start ... meeting node up the forward tree, then down the backward tree
+    std::vector<int> hierarchy_path;
+    for (int node_idx = meeting_idx; node_idx != SearchContext::kNoParent; node_idx = forward.Parent(node_idx)) {
+        hierarchy_path.push_back(node_idx);
+    }
+    std::reverse(hierarchy_path.begin(), hierarchy_path.end());
+    for (int node_idx = backward.Parent(meeting_idx); node_idx != SearchContext::kNoParent;
+         node_idx = backward.Parent(node_idx)) {
+        hierarchy_path.push_back(node_idx);
+    }
+
+    route.nodes.push_back(start_idx);
+    for (std::size_t i = 1; i < hierarchy_path.size(); ++i) {
+        Unpack(hierarchy_path[i - 1], hierarchy_path[i], route.nodes);
+    }
+    route.length = best;
+    return route;
+}
+
+/**
+ * Runs a complete upward search from a node, the half of a query that only depends on one end.
+ * Combining the lists of two nodes at their common entries yields the distance between them,
+ * which is how many-to-many queries avoid a full query per pair.
+ * @param node_idx The index of the node.
+ * @param context The search state.
+ * @param settled Receives the settled nodes that are not stalled, with their distance from the node.
+ */
+void ContractionHierarchy::UpwardSearch(int node_idx, SearchContext& context,
+                                        std::vector<std::pair<int, float>>& settled) const {
+    settled.clear();
+    context.Prepare(NodeCount());
+    context.SetLabel(node_idx, 0.0f, SearchContext::kNoParent);
+    std::visit([&](auto& queue) {
+        queue.Push(node_idx, 0.0f);
+        while (!queue.Empty()) {
+            const int current_idx = queue.Pop();
+            if (ExpandUpward(current_idx, context, queue)) {
+                settled.emplace_back(current_idx, context.G(current_idx));
+            }
+        }
+    }, context.Queue());
+}
+
+/**
+ * Checks whether a buffer starts with the signature of a hierarchy file.
+ * @param data The buffer.
+ * @return True if the buffer looks like a hierarchy file (of any version).
+ */
+bool ContractionHierarchy::Matches(Span<const std::byte> data) noexcept {
+    return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+/**
+ * Writes the hierarchy to a stream.
+ * @param os The output stream, opened in binary mode.
+ */
+void ContractionHierarchy::Write(std::ostream& os) const {
+    Writer w;
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrderMark;
+    header.fingerprint = m_Fingerprint;
+    w.Reserve(sizeof(header));
+
+    w.Array(m_Rank);
+    w.Array(m_UpOffsets);
+    w.Array(m_UpTargets);
+    w.Array(m_UpWeights);
+    w.Array(m_UpMiddles);
+
+    header.size = w.Position();
+    w.Patch(0, &header, sizeof(header));
+    if (!os.write(w.Buffer().data(), static_cast<std::streamsize>(w.Buffer().size()))) {
+        throw std::runtime_error("Failed to write the contraction hierarchy.");
+    }
+}
+
+/**
+ * Writes the hierarchy to a file.
+ * @param path The path of the hierarchy file.
+ */
+void ContractionHierarchy::Write(const std::string& path) const {
+    std::ofstream os{path, std::ios::binary | std::ios::trunc};
+    if (!os) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    Write(os);
+    os.close();
+    if (!os) {
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+}
+
+/**
+ * Restores a hierarchy written by Write(), validating every index so that queries on a
+ * loaded hierarchy cannot leave the arrays or loop while unpacking.
+ * @param data The contents of the hierarchy file.
+ * @param model The route model the hierarchy was built for.
+ * @return The hierarchy.
+ */
+ContractionHierarchy ContractionHierarchy::Load(Span<const std::byte> data, const RouteModel& model) {
+    const Header header = ReadHeader(data);
+    if (header.fingerprint != Fingerprint(model)) {
+        throw std::logic_error("Contraction hierarchy was built for a different map.");
+    }
+    Reader r{data, sizeof(header), kCorrupt};
+
+    const auto rank = r.Array<int>();
+    const auto offsets = r.Array<int>();
+    const auto targets = r.Array<int>();
+    const auto weights = r.Array<float>();
+    const auto middles = r.Array<int>();
+
+    const auto node_count = model.SNodes().size();
+    if (rank.size() != node_count) Fail();
+    std::vector<bool> rank_used(node_count, false);
+    for (int position : rank) {
+        if (position < 0 || static_cast<std::size_t>(position) >= node_count || rank_used[position]) Fail();
+        rank_used[position] = true;
+    }
+    if (offsets.size() != node_count + 1 || offsets[0] != 0 || offsets.back() != static_cast<int>(targets.size()) ||
+        weights.size() != targets.size() || middles.size() != targets.size()) {
+        Fail();
+    }
+
+    ContractionHierarchy ch;
+    ch.m_Fingerprint = header.fingerprint;
+    ch.m_Rank.assign(rank.begin(), rank.end());
+    ch.m_UpOffsets.assign(offsets.begin(), offsets.end());
+    ch.m_UpTargets.assign(targets.begin(), targets.end());
+    ch.m_UpWeights.assign(weights.begin(), weights.end());
+    ch.m_UpMiddles.assign(middles.begin(), middles.end());
+
+    for (std::size_t i = 0; i < node_count; ++i) {
+        if (offsets[i] > offsets[i + 1]) Fail();
+        for (int e = offsets[i]; e < offsets[i + 1]; ++e) {
+            const int target = targets[e];
+            if (target < 0 || static_cast<std::size_t>(target) >= node_count || rank[target] <= rank[i]) Fail();
+            if (!(weights[e] >= 0.0f) || std::isinf(weights[e])) Fail();
+        }
+    }
+    // Every shortcut must bypass a lower-ranked node adjacent to both of its ends
+    for (std::size_t i = 0; i < node_count; ++i) {
+        for (int e = offsets[i]; e < offsets[i + 1]; ++e) {
+            const int middle = middles[e];
+            if (middle == kNoMiddle) continue;
+            if (middle < 0 || static_cast<std::size_t>(middle) >= node_count || rank[middle] >= rank[i]) Fail();
+            if (ch.FindEdge(middle, static_cast<int>(i)) < 0 || ch.FindEdge(middle, targets[e]) < 0) Fail();
+        }
+    }
+    return ch;
+}
@@ -0,0 +1,145 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+#include "span.h"
+
+class RouteModel;
+class SearchContext;
+
+/**
+ * The ContractionHierarchy class answers shortest-path queries on the routing graph of a
+ * RouteModel with a contraction hierarchy (CH).
+ *
+ * Preprocessing contracts the nodes one by one in order of importance: a node is removed
+ * from the graph and, for every pair of its remaining neighbors whose shortest connection
+ * ran through it, a shortcut edge is added. Each node keeps its edges to the nodes
+ * contracted after it (its upward edges). A query then runs a bidirectional Dijkstra
+ * search that only follows upward edges, which settles a few hundred nodes even on large
+ * maps, and unpacks the shortcuts of the path it finds back into graph edges.
+ *
+ * The hierarchy is immutable once built and never refers to the model it was built from,
+ * so it can be shared between threads and written to a file (see Write() and Load()).
+ * The graph is undirected, so one set of upward edges serves both search directions.
+ */
+class ContractionHierarchy {
+public:
+    // Format version of hierarchy files; bump whenever their layout changes.
+    static constexpr std::uint32_t kVersion = 1;
+
+    /**
+     * A route found by Query().
+     */
+    struct Route {
+        std::vector<int> nodes;         // Node indices from the start to the end, empty if unreachable
+        float length = 0.0f;            // Length of the route, in the model's normalized units
+        std::size_t settled_nodes = 0;  // Nodes expanded by both searches
+    };
+
+    /**
+     * Constructor: Builds the hierarchy for the routing graph of a model.
+     * @param model The route model.
+     */
+    explicit ContractionHierarchy(const RouteModel& model);
+
+    /**
+     * Restores a hierarchy written by Write().
+     * @param data The contents of the hierarchy file, e.g. a MappedFile.
+     * @param model The route model the hierarchy was built for.
+     * @return The hierarchy.
+     * @throws std::logic_error if the data is malformed or was built for a different graph.
+     */
+    static ContractionHierarchy Load(Span<const std::byte> data, const RouteModel& model);
+
+    /**
+     * Checks whether a buffer starts with the signature of a hierarchy file.
+     * @param data The buffer.
+     * @return True if the buffer looks like a hierarchy file (of any version).
+     */
+    static bool Matches(Span<const std::byte> data) noexcept;
+
+    /**
+     * Writes the hierarchy to a stream.
+     * @param os The output stream, opened in binary mode.
+     * @throws std::runtime_error if writing fails.
+     */
+    void Write(std::ostream& os) const;
+
+    /**
+     * Writes the hierarchy to a file.
+     * @param path The path of the hierarchy file.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void Write(const std::string& path) const;
+
+    /**
+     * Finds a shortest route between two nodes.
+     * @param start_idx The index of the start node.
+     * @param end_idx The index of the end node.
+     * @param context The search state; its backward companion holds the search from the end.
+     * @return The route, with all shortcuts unpacked.
+     */
+    Route Query(int start_idx, int end_idx, SearchContext& context) const;
+
+    /**
+     * Runs a complete upward search from a node, the half of a query that only depends on one end.
+     * @param node_idx The index of the node.
+     * @param context The search state.
+     * @param settled Receives the settled nodes that are not stalled, with their distance from the node.
+     */
+    void UpwardSearch(int node_idx, SearchContext& context, std::vector<std::pair<int, float>>& settled) const;
+
+    /**
+     * Returns the number of nodes in the hierarchy.
+     */
+    std::size_t NodeCount() const noexcept { return m_Rank.size(); }
+
+    /**
+     * Returns the number of upward edges, original edges and shortcuts.
+     */
+    std::size_t EdgeCount() const noexcept { return m_UpTargets.size(); }
+
+    /**
+     * Returns the number of shortcuts added by the preprocessing.
+     */
+    std::size_t ShortcutCount() const noexcept;
+
+    /**
+     * Returns the position of a node in the contraction order; higher is more important.
+     */
+    int Rank(int node_idx) const { return m_Rank[node_idx]; }
+
+private:
+    static constexpr int kNoMiddle = -1;  // Middle node of an edge that is not a shortcut
+
+    ContractionHierarchy() = default;
+
+    // Identifies the routing graph of a model, to reject hierarchies built for another map.
+    static std::uint64_t Fingerprint(const RouteModel& model);
+
+    // Relaxes the upward edges of a node taken from the open list; returns false if it is stalled.
+    template <typename Queue>
+    bool ExpandUpward(int node_idx, SearchContext& search, Queue& queue) const;
+
+    // Returns the index of the upward edge between two adjacent nodes of the hierarchy.
+    int FindEdge(int from, int to) const;
+
+    // Appends the graph nodes of the edge from -> to, without from, to a path.
+    void Unpack(int from, int to, std::vector<int>& path) const;
+
+    std::uint64_t m_Fingerprint = 0;  // Fingerprint of the graph the hierarchy was built for
+    std::vector<int> m_Rank;          // Contraction order per node
+
+    // Upward edges in CSR form: the edges of node i are [m_UpOffsets[i], m_UpOffsets[i + 1])
+    std::vector<int> m_UpOffsets;    // Edge range start per node, plus a final sentinel
+    std::vector<int> m_UpTargets;    // Higher-ranked target node per edge
+    std::vector<float> m_UpWeights;  // Length per edge, in the model's normalized units
+    std::vector<int> m_UpMiddles;    // Contracted node a shortcut bypasses, or kNoMiddle
+};
+
+#endif
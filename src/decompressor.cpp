@@ -0,0 +1,274 @@
+#include "decompressor.h"
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <bzlib.h>
+#include <zlib.h>
+
+namespace {
+
+constexpr char kCorrupt[] = "Compressed map data is corrupt or truncated.";
+
+// Number of output buffers cycling between the two threads.
+constexpr std::size_t kBuffers = 4;
+
+// Rejects malformed compressed data.
+[[noreturn]] void Fail() { throw std::logic_error(kCorrupt); }
+
+// The result of one decoding step.
+struct Step {
+    std::size_t consumed = 0;  // Input bytes used
+    std::size_t produced = 0;  // Output bytes written
+    bool end = false;          // The compressed stream has ended
+};
+
+// Decodes gzip streams with zlib.
+class GzipDecoder {
+public:
+    GzipDecoder() {
+        if (inflateInit2(&m_Stream, 16 + MAX_WBITS) != Z_OK) throw std::bad_alloc{};
+    }
+    GzipDecoder(const GzipDecoder&) = delete;
+    GzipDecoder& operator=(const GzipDecoder&) = delete;
+    ~GzipDecoder() { inflateEnd(&m_Stream); }
+
+    // Prepares for the next of several concatenated streams.
+    void Reset() {
+        if (inflateReset(&m_Stream) != Z_OK) Fail();
+    }
+
+    Step Decode(const char* in, std::size_t in_size, char* out, std::size_t out_size) {
+        m_Stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+        m_Stream.avail_in = static_cast<uInt>(std::min<std::size_t>(in_size, UINT_MAX));
+        m_Stream.next_out = reinterpret_cast<Bytef*>(out);
+        m_Stream.avail_out = static_cast<uInt>(std::min<std::size_t>(out_size, UINT_MAX));
+        const auto in_before = m_Stream.avail_in, out_before = m_Stream.avail_out;
+        const int result = inflate(&m_Stream, Z_NO_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) Fail();
+        return {in_before - m_Stream.avail_in, out_before - m_Stream.avail_out, result == Z_STREAM_END};
+    }
+
+private:
+    z_stream m_Stream{};
+};
+
+// Decodes bzip2 streams with libbzip2.
+class Bzip2Decoder {
+public:
+    Bzip2Decoder() { Init(); }
+    Bzip2Decoder(const Bzip2Decoder&) = delete;
+    Bzip2Decoder& operator=(const Bzip2Decoder&) = delete;
+    ~Bzip2Decoder() { BZ2_bzDecompressEnd(&m_Stream); }
+
+    // Prepares for the next of several concatenated streams.
+    void Reset() {
+        BZ2_bzDecompressEnd(&m_Stream);
+        Init();
+    }
+
+    Step Decode(const char* in, std::size_t in_size, char* out, std::size_t out_size) {
+        m_Stream.next_in = const_cast<char*>(in);
+        m_Stream.avail_in = static_cast<unsigned>(std::min<std::size_t>(in_size, UINT_MAX));
+        m_Stream.next_out = out;
+        m_Stream.avail_out = static_cast<unsigned>(std::min<std::size_t>(out_size, UINT_MAX));
+        const auto in_before = m_Stream.avail_in, out_before = m_Stream.avail_out;
+        const int result = BZ2_bzDecompress(&m_Stream);
+        if (result != BZ_OK && result != BZ_STREAM_END) Fail();
+        return {in_before - m_Stream.avail_in, out_before - m_Stream.avail_out, result == BZ_STREAM_END};
+    }
+
+private:
+    void Init() {
+        m_Stream = {};
+        if (BZ2_bzDecompressInit(&m_Stream, 0, 0) != BZ_OK) throw std::bad_alloc{};
+    }
+
+    bz_stream m_Stream{};
+};
+
+// A buffer of decompressed bytes.
+struct Chunk {
+    std::vector<char> bytes;  // Buffer of the full chunk size
+    std::size_t size = 0;     // Bytes filled
+};
+
+/**
+ * Hands buffers between the decompressing thread, which fills free buffers, and the consuming
+ * thread, which returns them once used. Either side can end the exchange: the producer by
+ * closing it, possibly with an error, and the consumer by cancelling it.
+ */
+class Pipe {
+public:
+    Pipe(std::size_t buffers, std::size_t buffer_size) : m_Chunks(buffers) {
+        for (auto& chunk : m_Chunks) {
+            chunk.bytes.resize(buffer_size);
+            m_Free.push_back(&chunk);
+        }
+    }
+
+    // Producer: returns a buffer to fill, or nullptr if the consumer has cancelled.
+    Chunk* Free() {
+        std::unique_lock lock{m_Mutex};
+        m_Changed.wait(lock, [this] { return m_Cancelled || !m_Free.empty(); });
+        if (m_Cancelled) return nullptr;
+        auto chunk = m_Free.front();
+        m_Free.pop_front();
+        return chunk;
+    }
+
+    // Producer: passes a filled buffer on.
+    void Push(Chunk* chunk) {
+        {
+            std::lock_guard lock{m_Mutex};
+            m_Filled.push_back(chunk);
+        }
+        m_Changed.notify_all();
+    }
+
+    // Producer: ends the output, with the error that stopped it if any.
+    void Close(std::exception_ptr error) {
+        {
+            std::lock_guard lock{m_Mutex};
+            m_Closed = true;
+            m_Error = std::move(error);
+        }
+        m_Changed.notify_all();
+    }
+
+    // Consumer: returns the next filled buffer, or nullptr at the end of the output.
+    Chunk* Pop() {
+        std::unique_lock lock{m_Mutex};
+        m_Changed.wait(lock, [this] { return m_Closed || !m_Filled.empty(); });
+        if (m_Error) std::rethrow_exception(m_Error);
+        if (m_Filled.empty()) return nullptr;
+        auto chunk = m_Filled.front();
+        m_Filled.pop_front();
+        return chunk;
+    }
+
+    // Consumer: returns a used buffer.
+    void Recycle(Chunk* chunk) {
+        {
+            std::lock_guard lock{m_Mutex};
+            m_Free.push_back(chunk);
+        }
+        m_Changed.notify_all();
+    }
+
+    // Consumer: makes the producer stop.
+    void Cancel() {
+        {
+            std::lock_guard lock{m_Mutex};
+            m_Cancelled = true;
+        }
+        m_Changed.notify_all();
+    }
+
+private:
+    std::vector<Chunk> m_Chunks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Changed;
+    std::deque<Chunk*> m_Free;    // Buffers the producer may fill
+    std::deque<Chunk*> m_Filled;  // Buffers the consumer has not taken yet, oldest first
+    bool m_Closed = false;
+    bool m_Cancelled = false;
+    std::exception_ptr m_Error;
+};
+
+/**
+ * Decompresses one or more concatenated compressed streams into the buffers of a pipe.
+ * @param data The compressed data.
+ * @param pipe The pipe to fill.
+ * @throws std::logic_error if the data is corrupt or truncated.
+ */
+template <typename Decoder>
+void Decompress(Span<const std::byte> data, Pipe& pipe) {
+    Decoder decoder;
+    auto in = reinterpret_cast<const char*>(data.data());
+    std::size_t left = data.size();
+    bool ended = false;  // The current stream has ended
+    while (auto chunk = pipe.Free()) {
+        auto& filled = chunk->size;
+        filled = 0;
+        while (filled < chunk->bytes.size() && !(ended && left == 0)) {
+            if (ended) {
+                decoder.Reset();  // Another stream follows
+                ended = false;
+            }
+            const auto step = decoder.Decode(in, left, chunk->bytes.data() + filled, chunk->bytes.size() - filled);
+            in += step.consumed;
+            left -= step.consumed;
+            filled += step.produced;
+            ended = step.end;
+            if (!ended && step.consumed == 0 && step.produced == 0) Fail();  // Input ends inside a stream
+        }
+        pipe.Push(chunk);
+        if (ended && left == 0) return;
+    }
+}
+
+}  // namespace
+
+/**
+ * Detects the compression format of data.
+ * @param data The data.
+ * @return The format, or Format::None if the data is not compressed.
+ */
+Decompressor::Format Decompressor::Detect(Span<const std::byte> data) noexcept {
+    const auto bytes = reinterpret_cast<const unsigned char*>(data.data());
+    if (data.size() >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) return Format::Gzip;
+    if (data.size() >= 3 && std::memcmp(bytes, "BZh", 3) == 0) return Format::Bzip2;
+    return Format::None;
+}
+
+/**
+ * Decompresses data on a second thread, passing the output in order to a consumer on the
+ * calling thread.
+ * @param data The compressed data; must stay valid until the call returns.
+ * @param consume Called with every chunk of output; a chunk is only valid during the call.
+ * @param chunk_size The size of the output chunks in bytes; the last one may be smaller.
+ */
+void Decompressor::Stream(Span<const std::byte> data, const std::function<void(const char*, std::size_t)>& consume,
+                          std::size_t chunk_size) {
+    const auto format = Detect(data);
+    if (format == Format::None) {
+        consume(reinterpret_cast<const char*>(data.data()), data.size());
+        return;
+    }
+
+    Pipe pipe{kBuffers, std::max<std::size_t>(chunk_size, 1)};
+    std::thread producer{[&] {
+        try {
+            if (format == Format::Gzip) {
+                Decompress<GzipDecoder>(data, pipe);
+            } else {
+                Decompress<Bzip2Decoder>(data, pipe);
+            }
+            pipe.Close(nullptr);
+        } catch (...) {
+            pipe.Close(std::current_exception());
+        }
+    }};
+
+    try {
+        while (auto chunk = pipe.Pop()) {
+            if (chunk->size > 0) {
+                consume(chunk->bytes.data(), chunk->size);
+            }
+            pipe.Recycle(chunk);
+        }
+    } catch (...) {
+        pipe.Cancel();
+        producer.join();
+        throw;
+    }
+    producer.join();
+}
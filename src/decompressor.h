@@ -0,0 +1,41 @@
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <cstddef>
+#include <functional>
+#include "span.h"
+
+/**
+ * The Decompressor class streams the contents of gzip (.osm.gz) and bzip2 (.osm.bz2) compressed
+ * data without unpacking them to disk or holding them in memory as a whole.
+ *
+ * Stream() decompresses on a thread of its own into a small ring of buffers, while the calling
+ * thread consumes the filled ones, so decompressing overlaps with e.g. parsing. Files made of
+ * several concatenated compressed streams, as written by parallel compressors, are supported.
+ */
+class Decompressor {
+public:
+    // Compression formats, recognised by the signature at the start of the data.
+    enum class Format { None, Gzip, Bzip2 };
+
+    /**
+     * Detects the compression format of data.
+     * @param data The data.
+     * @return The format, or Format::None if the data is not compressed.
+     */
+    static Format Detect(Span<const std::byte> data) noexcept;
+
+    /**
+     * Decompresses data, passing the output in order to a consumer on the calling thread.
+     * Uncompressed data is passed on in a single piece.
+     * @param data The compressed data; must stay valid until the call returns.
+     * @param consume Called with every chunk of output; a chunk is only valid during the call.
+     * @param chunk_size The size of the output chunks in bytes; the last one may be smaller.
+     * @throws std::logic_error if the data is corrupt or truncated. An exception thrown by the
+     * consumer stops the decompression and is passed on.
+     */
+    static void Stream(Span<const std::byte> data, const std::function<void(const char*, std::size_t)>& consume,
+                       std::size_t chunk_size = 1 << 20);
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "distance_matrix.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "contraction_hierarchy.h"
+#include "route_model.h"
+#include "search_context.h"
+#include "thread_pool.h"
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+// Snaps points to the closest nodes, as RoutePlanner does with its start and end.
+std::vector<int> Snap(const RouteModel& model, const std::vector<DistanceMatrix::Point>& points) {
+    std::vector<int> nodes;
+    nodes.reserve(points.size());
+    for (const auto& point : points) {
+        nodes.push_back(model.FindClosestNode(point.x * 0.01f, point.y * 0.01f));
+    }
+    return nodes;
+}
+
+/**
+ * Splits [0, count) into contiguous blocks, a few per worker, and runs body(block, first, last)
+ * for each block on the pool. Blocks amortize the per-thread search state over many searches.
+ * @return The number of blocks.
+ */
+template <typename F>
+std::size_t ForEachBlock(ThreadPool& pool, std::size_t count, F&& body) {
+    const std::size_t blocks = std::min(count, 4 * pool.Size());
+    pool.ParallelFor(blocks, [&](std::size_t block) {
+        body(block, block * count / blocks, (block + 1) * count / blocks);
+    });
+    return blocks;
+}
+
+// An entry of a bucket: a target whose upward search reached the bucket's node at some distance.
+struct BucketEntry {
+    int col;
+    float dist;
+};
+
+}  // namespace
+
+/**
+ * Constructor: Snaps the points to the closest nodes and computes the distances.
+ * @param model The route model.
+ * @param sources The row points.
+ * @param targets The column points.
+ * @param hierarchy A hierarchy built for the model to search, or nullptr to run Dijkstra searches.
+ * @param threads The number of threads; 0 uses one per hardware thread.
+ */
+DistanceMatrix::DistanceMatrix(const RouteModel& model, const std::vector<Point>& sources,
+                               const std::vector<Point>& targets, const ContractionHierarchy* hierarchy,
+                               std::size_t threads)
+    : DistanceMatrix(model, Snap(model, sources), Snap(model, targets), hierarchy, threads) {}
+
+/**
+ * Constructor: Computes the distances between nodes.
+ * @param model The route model.
+ * @param source_nodes The indices of the row nodes.
+ * @param target_nodes The indices of the column nodes.
+ * @param hierarchy A hierarchy built for the model to search, or nullptr to run Dijkstra searches.
+ * @param threads The number of threads; 0 uses one per hardware thread.
+ */
+DistanceMatrix::DistanceMatrix(const RouteModel& model, std::vector<int> source_nodes, std::vector<int> target_nodes,
+                               const ContractionHierarchy* hierarchy, std::size_t threads)
+    : m_SourceNodes(std::move(source_nodes)),
+      m_TargetNodes(std::move(target_nodes)),
+      m_Values(Rows() * Cols(), kInfinity) {
+    if (hierarchy && hierarchy->NodeCount() != model.SNodes().size()) {
+        throw std::logic_error("The contraction hierarchy was built for a different map.");
+    }
+    if (m_Values.empty()) return;
+    if (std::count(m_SourceNodes.begin(), m_SourceNodes.end(), RouteModel::kNoNode) > 0 ||
+        std::count(m_TargetNodes.begin(), m_TargetNodes.end(), RouteModel::kNoNode) > 0) {
+        return;  // Snapped on a map without routable nodes, so nothing is reachable
+    }
+
+    ThreadPool pool{threads};
+    if (hierarchy) {
+        ComputeWithHierarchy(*hierarchy, pool);
+    } else {
+        ComputeWithSweeps(model, pool);
+    }
+    for (float& value : m_Values) {
+        value *= model.MetricScale();  // Convert the distance to meters
+    }
+}
+
+/**
+ * Fills the rows with the bucket-based many-to-many search. The shortest route between two
+ * nodes runs up the hierarchy from both ends to a common top node, so it is found by joining
+ * the upward search of the source with the upward search of the target at a node both settle.
+ * The target searches run first and leave an entry in the bucket of every node they settle;
+ * each source search then only scans the buckets of its own settled nodes.
+ * @param hierarchy The contraction hierarchy.
+ * @param pool The pool running the searches.
+ */
+void DistanceMatrix::ComputeWithHierarchy(const ContractionHierarchy& hierarchy, ThreadPool& pool) {
+    const auto node_count = hierarchy.NodeCount();
+
+    // Target searches, collected per block and then sorted into buckets by node
+    std::vector<std::vector<std::pair<int, BucketEntry>>> found(Cols());
+    const auto blocks = ForEachBlock(pool, Cols(), [&](std::size_t block, std::size_t first, std::size_t last) {
+        auto& entries = found[block];
+        SearchContext context{node_count};
+        std::vector<std::pair<int, float>> settled;
+        for (std::size_t col = first; col < last; ++col) {
+            hierarchy.UpwardSearch(m_TargetNodes[col], context, settled);
+            for (const auto& [node, dist] : settled) {
+                entries.push_back({node, {static_cast<int>(col), dist}});
+            }
+        }
+    });
+
+    found.resize(blocks);
+    std::vector<int> bucket_offsets(node_count + 1, 0);
+    for (const auto& entries : found) {
+        for (const auto& entry : entries) {
+            ++bucket_offsets[entry.first + 1];
+        }
+    }
+    for (std::size_t i = 0; i < node_count; ++i) {
+        bucket_offsets[i + 1] += bucket_offsets[i];
+    }
+    std::vector<BucketEntry> buckets(bucket_offsets.back());
+    std::vector<int> fill(bucket_offsets.begin(), bucket_offsets.end() - 1);
+    for (auto& entries : found) {
+        for (const auto& entry : entries) {
+            buckets[fill[entry.first]++] = entry.second;
+        }
+        entries = {};
+    }
+
+    // Source searches, each filling its own row
+    ForEachBlock(pool, Rows(), [&](std::size_t, std::size_t first, std::size_t last) {
+        SearchContext context{node_count};
+        std::vector<std::pair<int, float>> settled;
+        for (std::size_t row = first; row < last; ++row) {
+            hierarchy.UpwardSearch(m_SourceNodes[row], context, settled);
+            float* values = m_Values.data() + row * Cols();
+            for (const auto& [node, dist] : settled) {
+                for (int b = bucket_offsets[node]; b < bucket_offsets[node + 1]; ++b) {
+                    values[buckets[b].col] = std::min(values[buckets[b].col], dist + buckets[b].dist);
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Fills each row with a Dijkstra search from its source that stops once every target is settled.
+ * @param model The route model.
+ * @param pool The pool running the searches.
+ */
+void DistanceMatrix::ComputeWithSweeps(const RouteModel& model, ThreadPool& pool) {
+    const auto node_count = model.SNodes().size();
+    std::vector<bool> is_target(node_count, false);
+    for (int node : m_TargetNodes) {
+        is_target[node] = true;
+    }
+    const auto target_count = static_cast<std::size_t>(std::count(is_target.begin(), is_target.end(), true));
+
+    ForEachBlock(pool, Rows(), [&](std::size_t, std::size_t first, std::size_t last) {
+        SearchContext context{node_count};
+        for (std::size_t row = first; row < last; ++row) {
+            const int source = m_SourceNodes[row];
+            context.Prepare(node_count);
+            context.SetLabel(source, 0.0f, SearchContext::kNoParent);
+            std::visit([&](auto& queue) {
+                queue.Push(source, 0.0f);
+                std::size_t targets_left = target_count;
+                while (!queue.Empty() && targets_left > 0) {
+                    const int current = queue.Pop();
+                    if (is_target[current]) --targets_left;
+                    const float current_g = context.G(current);
+                    const auto neighbors = model.Neighbors(current);
+                    const auto lengths = model.NeighborDistances(current);
+                    for (std::size_t i = 0; i < neighbors.size(); ++i) {
+                        const int neighbor = neighbors[i];
+                        const bool reached = context.Reached(neighbor);
+                        if (reached && !queue.Contains(neighbor)) continue;  // Already settled
+                        const float g_value = current_g + lengths[i];
+                        if (reached && g_value >= context.G(neighbor)) continue;
+                        context.SetLabel(neighbor, g_value, current);
+                        queue.PushOrDecrease(neighbor, g_value);
+                    }
+                }
+            }, context.Queue());
+
+            // Every reachable target is settled by now, so its label is final
+            float* values = m_Values.data() + row * Cols();
+            for (std::size_t col = 0; col < Cols(); ++col) {
+                values[col] = context.G(m_TargetNodes[col]);
+            }
+        }
+    });
+}
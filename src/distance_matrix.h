@@ -0,0 +1,82 @@
+#ifndef DISTANCE_MATRIX_H
+#define DISTANCE_MATRIX_H
+
+#include <cstddef>
+#include <vector>
+
+class ContractionHierarchy;
+class RouteModel;
+class ThreadPool;
+
+/**
+ * The DistanceMatrix class computes the shortest travel distances between every source and
+ * every target of two point sets in one go. Every point is snapped to the road network once,
+ * and the table is filled by a parallel many-to-many search instead of one route query per pair:
+ *  - with a ContractionHierarchy, one upward search per target fills buckets at the nodes it
+ *    settles, and one upward search per source combines its distances with those buckets;
+ *  - without one, a Dijkstra search per source runs until it has settled every target.
+ */
+class DistanceMatrix {
+public:
+    /**
+     * A point given in the coordinate range taken by RoutePlanner (0 to 100 across the map).
+     */
+    struct Point {
+        float x;
+        float y;
+    };
+
+    /**
+     * Constructor: Snaps the points to the closest nodes and computes the distances.
+     * @param model The route model.
+     * @param sources The row points.
+     * @param targets The column points.
+     * @param hierarchy A hierarchy built for the model to search, or nullptr to run Dijkstra searches.
+     * @param threads The number of threads; 0 uses one per hardware thread.
+     */
+    DistanceMatrix(const RouteModel& model, const std::vector<Point>& sources, const std::vector<Point>& targets,
+                   const ContractionHierarchy* hierarchy = nullptr, std::size_t threads = 0);
+
+    /**
+     * Constructor: Computes the distances between nodes.
+     * @param model The route model.
+     * @param source_nodes The indices of the row nodes.
+     * @param target_nodes The indices of the column nodes.
+     * @param hierarchy A hierarchy built for the model to search, or nullptr to run Dijkstra searches.
+     * @param threads The number of threads; 0 uses one per hardware thread.
+     */
+    DistanceMatrix(const RouteModel& model, std::vector<int> source_nodes, std::vector<int> target_nodes,
+                   const ContractionHierarchy* hierarchy = nullptr, std::size_t threads = 0);
+
+    std::size_t Rows() const noexcept { return m_SourceNodes.size(); }
+    std::size_t Cols() const noexcept { return m_TargetNodes.size(); }
+
+    /**
+     * Returns the distance from a source to a target in meters, or infinity if it is unreachable.
+     */
+    float operator()(std::size_t row, std::size_t col) const { return m_Values[row * Cols() + col]; }
+
+    /**
+     * Returns all distances in meters, row by row.
+     */
+    const std::vector<float>& Values() const noexcept { return m_Values; }
+
+    /**
+     * Returns the nodes the sources and targets were snapped to.
+     */
+    const std::vector<int>& SourceNodes() const noexcept { return m_SourceNodes; }
+    const std::vector<int>& TargetNodes() const noexcept { return m_TargetNodes; }
+
+private:
+    // Fills the rows from the buckets of the target searches in the hierarchy.
+    void ComputeWithHierarchy(const ContractionHierarchy& hierarchy, ThreadPool& pool);
+
+    // Fills each row with a Dijkstra search from its source.
+    void ComputeWithSweeps(const RouteModel& model, ThreadPool& pool);
+
+    std::vector<int> m_SourceNodes;  // Node index per row
+    std::vector<int> m_TargetNodes;  // Node index per column
+    std::vector<float> m_Values;     // Distances in meters, row-major
+};
+
+#endif
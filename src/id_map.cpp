@@ -0,0 +1,59 @@
+#include "id_map.h"
+#include <cassert>
+#include <utility>
+
+/**
+ * Grows the table so that it holds at least the given number of IDs without rehashing.
+ * @param size The number of IDs.
+ */
+void IdMap::Reserve(std::size_t size) {
+    std::size_t capacity = 16;
+    while (capacity < 2 * size) {
+        capacity *= 2;
+    }
+    if (capacity > m_Slots.size()) {
+        Rehash(capacity);
+    }
+}
+
+/**
+ * Maps an ID to an index, replacing the index if the ID is already present.
+ * @param id The ID; any value except the minimum int64 value.
+ * @param index The index to map it to.
+ */
+void IdMap::Insert(std::int64_t id, int index) {
+    assert(id != kEmpty);
+    if (2 * (m_Size + 1) > m_Slots.size()) {
+        Rehash(m_Slots.empty() ? 16 : 2 * m_Slots.size());
+    }
+    for (std::size_t i = Hash(id) & m_Mask;; i = (i + 1) & m_Mask) {
+        Slot& slot = m_Slots[i];
+        if (slot.id == kEmpty) {
+            slot.id = id;
+            ++m_Size;
+        }
+        if (slot.id == id) {
+            slot.index = index;
+            return;
+        }
+    }
+}
+
+/**
+ * Reallocates the slots to a power-of-two capacity and reinserts every ID.
+ * @param capacity The new number of slots.
+ */
+void IdMap::Rehash(std::size_t capacity) {
+    std::vector<Slot> old(capacity);
+    std::swap(old, m_Slots);
+    m_Mask = capacity - 1;
+    for (const Slot& slot : old) {
+        if (slot.id == kEmpty) continue;
+        for (std::size_t i = Hash(slot.id) & m_Mask;; i = (i + 1) & m_Mask) {
+            if (m_Slots[i].id == kEmpty) {
+                m_Slots[i] = slot;
+                break;
+            }
+        }
+    }
+}
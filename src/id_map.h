@@ -0,0 +1,79 @@
+#ifndef ID_MAP_H
+#define ID_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * The IdMap class maps 64-bit OSM IDs to dense indices. It is an open-addressing hash
+ * table with linear probing over a single flat array of slots, so a lookup costs one
+ * hash and usually a single cache miss, and inserting never allocates per element.
+ * The table is kept at most half full.
+ */
+class IdMap {
+public:
+    static constexpr int kNotFound = -1;
+
+    IdMap() = default;
+
+    /**
+     * Constructor: Sizes the table for an expected number of IDs.
+     * @param expected_size The number of IDs expected to be inserted.
+     */
+    explicit IdMap(std::size_t expected_size) { Reserve(expected_size); }
+
+    /**
+     * Grows the table so that it holds at least the given number of IDs without rehashing.
+     */
+    void Reserve(std::size_t size);
+
+    /**
+     * Maps an ID to an index, replacing the index if the ID is already present.
+     * @param id The ID; any value except the minimum int64 value.
+     * @param index The index to map it to.
+     */
+    void Insert(std::int64_t id, int index);
+
+    /**
+     * Looks up an ID.
+     * @return The index mapped to the ID, or kNotFound.
+     */
+    int Find(std::int64_t id) const noexcept {
+        if (m_Slots.empty()) return kNotFound;
+        for (std::size_t i = Hash(id) & m_Mask;; i = (i + 1) & m_Mask) {
+            const Slot& slot = m_Slots[i];
+            if (slot.id == id) return slot.index;
+            if (slot.id == kEmpty) return kNotFound;
+        }
+    }
+
+    std::size_t Size() const noexcept { return m_Size; }
+    bool Empty() const noexcept { return m_Size == 0; }
+
+private:
+    static constexpr std::int64_t kEmpty = std::numeric_limits<std::int64_t>::min();
+
+    struct Slot {
+        std::int64_t id = kEmpty;
+        int index = kNotFound;
+    };
+
+    // Mixes the bits of an ID (the splitmix64 finalizer); OSM IDs are often sequential.
+    static std::size_t Hash(std::int64_t id) noexcept {
+        auto x = static_cast<std::uint64_t>(id);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<std::size_t>(x ^ (x >> 31));
+    }
+
+    // Reallocates the slots to a power-of-two capacity and reinserts every ID.
+    void Rehash(std::size_t capacity);
+
+    std::vector<Slot> m_Slots;  // Hash table, capacity is a power of two
+    std::size_t m_Mask = 0;     // Capacity - 1
+    std::size_t m_Size = 0;     // Number of IDs stored
+};
+
+#endif
@@ -0,0 +1,189 @@
+#include "isochrone.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Grids with more cells than this are rejected rather than allocated.
+constexpr std::size_t kMaxGridCells = std::size_t{1} << 26;
+
+// A reachable piece of a road segment, in model coordinates.
+struct Piece {
+    double x0, y0, x1, y1;
+};
+
+/**
+ * A grid of square cells over a rectangle of the map with a one-cell border, so that the cells
+ * at the edge of the grid are always outside the area.
+ */
+class CellGrid {
+public:
+    CellGrid(double min_x, double min_y, double max_x, double max_y, double cell) : m_Cell(cell) {
+        m_OriginX = min_x - cell;
+        m_OriginY = min_y - cell;
+        const double width = std::ceil((max_x - min_x) / cell) + 3;
+        const double height = std::ceil((max_y - min_y) / cell) + 3;
+        if (width * height > static_cast<double>(kMaxGridCells)) {
+            throw std::invalid_argument("Isochrone resolution is too fine for the reachable area.");
+        }
+        m_Width = static_cast<int>(width);
+        m_Height = static_cast<int>(height);
+    }
+
+    int Width() const noexcept { return m_Width; }
+    int Height() const noexcept { return m_Height; }
+    std::size_t Size() const noexcept { return static_cast<std::size_t>(m_Width) * m_Height; }
+    std::size_t Index(int i, int j) const noexcept { return static_cast<std::size_t>(j) * m_Width + i; }
+
+    int Column(double x) const { return std::clamp(static_cast<int>((x - m_OriginX) / m_Cell), 0, m_Width - 1); }
+    int Row(double y) const { return std::clamp(static_cast<int>((y - m_OriginY) / m_Cell), 0, m_Height - 1); }
+
+    // Returns the model coordinates of a cell corner.
+    Model::Node Corner(int i, int j) const { return {m_OriginX + i * m_Cell, m_OriginY + j * m_Cell}; }
+
+private:
+    double m_OriginX, m_OriginY;  // Model coordinates of the corner of cell (0, 0)
+    double m_Cell;                // Cell size, in model units
+    int m_Width, m_Height;        // Number of columns and rows
+};
+
+// Collects the reachable pieces of the road segments at the reached nodes.
+std::vector<Piece> ReachablePieces(const RouteModel& model, const std::vector<RoutePlanner::ReachableNode>& reached,
+                                   float max_distance) {
+    const auto& nodes = model.SNodes();
+    const double scale = model.MetricScale();
+    std::vector<Piece> pieces;
+    for (const auto& r : reached) {
+        const auto& u = nodes[r.index];
+        const double budget = (max_distance - r.distance) / scale;  // Distance left, in model units
+        pieces.push_back({u.x, u.y, u.x, u.y});
+        const auto neighbors = model.Neighbors(r.index);
+        const auto lengths = model.NeighborDistances(r.index);
+        for (std::size_t i = 0; i < neighbors.size(); ++i) {
+            const auto& v = nodes[neighbors[i]];
+            const double t = lengths[i] > 0.0f ? std::min(1.0, budget / lengths[i]) : 1.0;
+            pieces.push_back({u.x, u.y, u.x + t * (v.x - u.x), u.y + t * (v.y - u.y)});
+        }
+    }
+    return pieces;
+}
+
+// Marks the cells a piece passes through, keeping consecutive cells edge-adjacent.
+void Rasterize(const CellGrid& grid, const Piece& piece, double cell, std::vector<bool>& marked) {
+    const double length = std::hypot(piece.x1 - piece.x0, piece.y1 - piece.y0);
+    const int steps = static_cast<int>(std::ceil(2.0 * length / cell));
+    int last_i = grid.Column(piece.x0);
+    int last_j = grid.Row(piece.y0);
+    marked[grid.Index(last_i, last_j)] = true;
+    for (int k = 1; k <= steps; ++k) {
+        const double t = static_cast<double>(k) / steps;
+        const int i = grid.Column(piece.x0 + t * (piece.x1 - piece.x0));
+        const int j = grid.Row(piece.y0 + t * (piece.y1 - piece.y0));
+        if (i != last_i && j != last_j) {
+            marked[grid.Index(i, last_j)] = true;  // Bridge a diagonal step
+        }
+        marked[grid.Index(i, j)] = true;
+        last_i = i;
+        last_j = j;
+    }
+}
+
+// Flood-fills the edge-connected cells matching a value from a seed cell.
+std::vector<bool> FloodFill(const CellGrid& grid, const std::vector<bool>& cells, bool value, int seed_i, int seed_j) {
+    std::vector<bool> filled(grid.Size(), false);
+    std::vector<std::pair<int, int>> pending{{seed_i, seed_j}};
+    filled[grid.Index(seed_i, seed_j)] = true;
+    while (!pending.empty()) {
+        const auto [i, j] = pending.back();
+        pending.pop_back();
+        const std::pair<int, int> next[] = {{i - 1, j}, {i + 1, j}, {i, j - 1}, {i, j + 1}};
+        for (const auto& [ni, nj] : next) {
+            if (ni < 0 || nj < 0 || ni >= grid.Width() || nj >= grid.Height()) continue;
+            const auto index = grid.Index(ni, nj);
+            if (!filled[index] && cells[index] == value) {
+                filled[index] = true;
+                pending.push_back({ni, nj});
+            }
+        }
+    }
+    return filled;
+}
+
+}  // namespace
+
+/**
+ * Traces the outline of the area reachable within a distance.
+ * @param model The route model the search ran on.
+ * @param reached The nodes reached by the search, the start node first.
+ * @param max_distance The cutoff of the search, in meters.
+ * @param resolution The size of the grid cells, in meters.
+ * @return The outline as a counter-clockwise polygon in model coordinates.
+ */
+std::vector<Model::Node> TraceIsochrone(const RouteModel& model, const std::vector<RoutePlanner::ReachableNode>& reached,
+                                        float max_distance, float resolution) {
+    if (!(resolution > 0.0f)) {
+        throw std::invalid_argument("Isochrone resolution must be positive.");
+    }
+    if (reached.empty()) {
+        return {};
+    }
+
+    const auto pieces = ReachablePieces(model, reached, max_distance);
+    double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+    double max_x = std::numeric_limits<double>::lowest(), max_y = max_x;
+    for (const auto& p : pieces) {
+        min_x = std::min({min_x, p.x0, p.x1});
+        min_y = std::min({min_y, p.y0, p.y1});
+        max_x = std::max({max_x, p.x0, p.x1});
+        max_y = std::max({max_y, p.y0, p.y1});
+    }
+    const double cell = resolution / model.MetricScale();
+    const CellGrid grid{min_x, min_y, max_x, max_y, cell};
+
+    std::vector<bool> marked(grid.Size(), false);
+    for (const auto& p : pieces) {
+        Rasterize(grid, p, cell, marked);
+    }
+
+    // The area: the cells connected to the start, plus everything they enclose
+    const auto& start = model.SNodes()[reached.front().index];
+    const auto connected = FloodFill(grid, marked, true, grid.Column(start.x), grid.Row(start.y));
+    const auto outside = FloodFill(grid, connected, false, 0, 0);
+    const auto inside = [&](int i, int j) {
+        return i >= 0 && j >= 0 && i < grid.Width() && j < grid.Height() && !outside[grid.Index(i, j)];
+    };
+
+    // Border edges between inside and outside cells, directed to keep the inside on their left.
+    // The area is edge-connected and has no holes, so every corner has at most one outgoing edge.
+    const int corners_per_row = grid.Width() + 1;
+    const auto corner = [corners_per_row](int i, int j) { return j * corners_per_row + i; };
+    std::vector<int> next(static_cast<std::size_t>(corners_per_row) * (grid.Height() + 1), -1);
+    int first = -1;
+    for (int j = 0; j < grid.Height(); ++j) {
+        for (int i = 0; i < grid.Width(); ++i) {
+            if (!inside(i, j)) continue;
+            if (!inside(i, j - 1)) {
+                next[corner(i, j)] = corner(i + 1, j);
+                if (first < 0) first = corner(i, j);
+            }
+            if (!inside(i + 1, j)) next[corner(i + 1, j)] = corner(i + 1, j + 1);
+            if (!inside(i, j + 1)) next[corner(i + 1, j + 1)] = corner(i, j + 1);
+            if (!inside(i - 1, j)) next[corner(i, j + 1)] = corner(i, j);
+        }
+    }
+
+    // Walk the border once, keeping only the corners where it turns
+    std::vector<Model::Node> polygon;
+    int current = first;
+    do {
+        const int following = next[current];
+        const int after = next[following];
+        if (following - current != after - following) {
+            polygon.push_back(grid.Corner(following % corners_per_row, following / corners_per_row));
+        }
+        current = following;
+    } while (current != first && polygon.size() < next.size());
+    return polygon;
+}
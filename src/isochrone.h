@@ -0,0 +1,28 @@
+#ifndef ISOCHRONE_H
+#define ISOCHRONE_H
+
+#include <vector>
+#include "route_model.h"
+#include "route_planner.h"
+
+/**
+ * Traces the outline of the area reachable within a distance from the shortest-path tree of a
+ * one-to-all search (see RoutePlanner::OneToAll()).
+ *
+ * Every road segment is reachable as far as the distance left at its reached ends allows. These
+ * reachable pieces are rasterized onto a grid of square cells, the cells connected to the start
+ * are kept, enclosed holes (parks, lakes, blocks without roads) are filled in, and the border of
+ * the resulting region is traced along the cell edges.
+ *
+ * @param model The route model the search ran on.
+ * @param reached The nodes reached by the search, the start node first.
+ * @param max_distance The cutoff of the search, in meters.
+ * @param resolution The size of the grid cells, in meters.
+ * @return The outline as a counter-clockwise polygon in model coordinates, without repeating the
+ *         first vertex; empty if nothing was reached.
+ * @throws std::invalid_argument if the resolution is not positive or too fine for the area.
+ */
+std::vector<Model::Node> TraceIsochrone(const RouteModel& model, const std::vector<RoutePlanner::ReachableNode>& reached,
+                                        float max_distance, float resolution);
+
+#endif
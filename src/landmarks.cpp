@@ -0,0 +1,209 @@
+#include "landmarks.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include "priority_queue.h"
+#include "route_model.h"
+#include "thread_pool.h"
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+constexpr std::mt19937::result_type kSeed = 5489;  // Fixed, so that landmarks are reproducible
+
+/**
+ * Lowers dist to the shortest distances from a source wherever that improves them. Starting
+ * from infinite distances this is a plain Dijkstra search; starting from the distances to a set
+ * of nodes it adds the source to the set and only explores the region the source is nearest to.
+ * @param model The route model.
+ * @param source The index of the source node.
+ * @param dist The distances to update, one per node.
+ * @param parent If not null, receives the parent of every updated node.
+ * @param order If not null, receives the updated nodes in the order they were settled.
+ */
+void Sweep(const RouteModel& model, int source, std::vector<float>& dist, std::vector<int>* parent = nullptr,
+           std::vector<int>* order = nullptr) {
+    IndexedDaryHeap<4> queue{dist.size()};
+    dist[source] = 0.0f;
+    if (parent) (*parent)[source] = -1;
+    queue.Push(source, 0.0f);
+    while (!queue.Empty()) {
+        const int current = queue.Pop();
+        if (order) order->push_back(current);
+        const auto neighbors = model.Neighbors(current);
+        const auto lengths = model.NeighborDistances(current);
+        for (std::size_t i = 0; i < neighbors.size(); ++i) {
+            const float d = dist[current] + lengths[i];
+            if (d < dist[neighbors[i]]) {
+                dist[neighbors[i]] = d;
+                if (parent) (*parent)[neighbors[i]] = current;
+                queue.PushOrDecrease(neighbors[i], d);
+            }
+        }
+    }
+}
+
+// Returns the nodes of the largest connected component of the routing graph that has an edge.
+std::vector<int> LargestComponent(const RouteModel& model) {
+    const auto node_count = model.SNodes().size();
+    std::vector<bool> visited(node_count, false);
+    std::vector<int> largest, component;
+    for (std::size_t start = 0; start < node_count; ++start) {
+        if (visited[start] || model.Neighbors(static_cast<int>(start)).empty()) continue;
+        component.assign(1, static_cast<int>(start));
+        visited[start] = true;
+        for (std::size_t i = 0; i < component.size(); ++i) {
+            for (int neighbor : model.Neighbors(component[i])) {
+                if (!visited[neighbor]) {
+                    visited[neighbor] = true;
+                    component.push_back(neighbor);
+                }
+            }
+        }
+        if (component.size() > largest.size()) {
+            std::swap(largest, component);
+        }
+    }
+    return largest;
+}
+
+// Returns the node of a component with the largest finite distance.
+int FarthestNode(const std::vector<int>& component, const std::vector<float>& dist) {
+    int farthest = component.front();
+    for (int node : component) {
+        if (dist[node] > dist[farthest]) farthest = node;
+    }
+    return farthest;
+}
+
+}  // namespace
+
+/**
+ * Constructor: Chooses the landmarks and computes their distance tables.
+ *
+ * Farthest selection starts at the node farthest from a random node and then repeatedly adds
+ * the node farthest from all landmarks so far; each step only re-explores the region the new
+ * landmark is nearest to. Avoid selection (Goldberg and Werneck) grows a shortest-path tree
+ * from a random root, weighs every node by how much the current landmarks underestimate its
+ * distance from the root, and descends from the root into the heaviest subtree without a
+ * landmark; the leaf it reaches becomes the next landmark.
+ * @param model The route model.
+ * @param count The number of landmarks; fewer are chosen if the graph is smaller.
+ * @param selection The strategy for choosing the landmarks.
+ * @param threads The number of threads computing the tables; 0 uses one per hardware thread.
+ */
+Landmarks::Landmarks(const RouteModel& model, std::size_t count, Selection selection, std::size_t threads) {
+    const auto node_count = model.SNodes().size();
+    const auto component = LargestComponent(model);
+    count = std::min(count, component.size());
+    if (count == 0) return;
+
+    std::mt19937 random{kSeed};
+    std::uniform_int_distribution<std::size_t> pick{0, component.size() - 1};
+    std::vector<std::vector<float>> tables;  // Distances from each landmark, landmark-major
+
+    if (selection == Selection::Farthest) {
+        std::vector<float> nearest(node_count, kInfinity);  // Distance to the nearest landmark
+        Sweep(model, component[pick(random)], nearest);
+        int next = FarthestNode(component, nearest);
+        std::fill(nearest.begin(), nearest.end(), kInfinity);
+        while (m_Nodes.size() < count) {
+            m_Nodes.push_back(next);
+            Sweep(model, next, nearest);
+            next = FarthestNode(component, nearest);
+            if (nearest[next] == 0.0f) break;  // Every node is a landmark
+        }
+
+        tables.resize(m_Nodes.size());
+        ThreadPool pool{threads};
+        pool.ParallelFor(m_Nodes.size(), [&](std::size_t i) {
+            tables[i].assign(node_count, kInfinity);
+            Sweep(model, m_Nodes[i], tables[i]);
+        });
+    } else {
+        const auto bound = [&tables](int a, int b) {
+            float result = 0.0f;
+            for (const auto& table : tables) {
+                result = std::max(result, std::abs(table[a] - table[b]));
+            }
+            return result;
+        };
+
+        std::vector<float> dist(node_count);
+        std::vector<int> parent(node_count);
+        std::vector<int> order;
+        std::vector<float> size(node_count);
+        std::vector<bool> covered(node_count);  // Whether the subtree of a node holds a landmark
+        std::vector<int> heaviest(node_count);  // Child with the heaviest subtree without a landmark
+        while (m_Nodes.size() < count) {
+            const int root = component[pick(random)];
+            std::fill(dist.begin(), dist.end(), kInfinity);
+            order.clear();
+            Sweep(model, root, dist, &parent, &order);
+
+            for (int node : order) {
+                size[node] = 0.0f;
+                covered[node] = false;
+                heaviest[node] = -1;
+            }
+            for (int landmark : m_Nodes) {
+                covered[landmark] = true;
+            }
+            // Children are settled after their parents, so walking backwards completes every subtree first
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                const int node = *it;
+                if (covered[node]) {
+                    size[node] = 0.0f;
+                } else {
+                    size[node] += dist[node] - bound(root, node);
+                }
+                const int p = parent[node];
+                if (p < 0) continue;
+                if (covered[node]) {
+                    covered[p] = true;
+                } else {
+                    size[p] += size[node];
+                    if (heaviest[p] < 0 || size[node] > size[heaviest[p]]) heaviest[p] = node;
+                }
+            }
+
+            int leaf = root;
+            while (heaviest[leaf] >= 0) {
+                leaf = heaviest[leaf];
+            }
+            if (std::find(m_Nodes.begin(), m_Nodes.end(), leaf) != m_Nodes.end()) break;  // Nothing left to cover
+            m_Nodes.push_back(leaf);
+            tables.emplace_back(node_count, kInfinity);
+            Sweep(model, leaf, tables.back());
+        }
+    }
+
+    m_Distances.resize(node_count * Count());
+    for (std::size_t l = 0; l < Count(); ++l) {
+        for (std::size_t v = 0; v < node_count; ++v) {
+            m_Distances[v * Count() + l] = tables[l][v];
+        }
+    }
+}
+
+/**
+ * Returns a lower bound of the shortest distance between two nodes: the largest difference of
+ * their distances to any landmark. All landmarks lie in one connected component, so either
+ * every landmark reaches a node or none does.
+ * @param from_idx The index of one node.
+ * @param to_idx The index of the other node.
+ * @return The bound in the model's normalized units; 0 if no landmark reaches both nodes.
+ */
+float Landmarks::LowerBound(int from_idx, int to_idx) const noexcept {
+    const std::size_t count = Count();
+    if (count == 0) return 0.0f;
+    const float* from = m_Distances.data() + static_cast<std::size_t>(from_idx) * count;
+    const float* to = m_Distances.data() + static_cast<std::size_t>(to_idx) * count;
+    if (from[0] == kInfinity || to[0] == kInfinity) return 0.0f;
+    float bound = 0.0f;
+    for (std::size_t l = 0; l < count; ++l) {
+        bound = std::max(bound, std::abs(from[l] - to[l]));
+    }
+    return bound;
+}
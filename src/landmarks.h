@@ -0,0 +1,78 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <cstddef>
+#include <vector>
+
+class RouteModel;
+
+/**
+ * The Landmarks class provides the lower bounds of the ALT heuristic (A*, landmarks and the
+ * triangle inequality). A few landmark nodes are chosen near the fringe of the road network
+ * and the shortest distance from every landmark to every node is precomputed. For any
+ * landmark L, |d(L, a) - d(L, b)| <= d(a, b), so the largest such difference over all
+ * landmarks is a consistent lower bound that, unlike the straight-line distance, accounts
+ * for rivers, rail lines and other obstacles the roads have to go around.
+ *
+ * Landmarks are chosen in the largest connected component of the routing graph; nodes
+ * outside it only get the bounds of the straight-line distance.
+ */
+class Landmarks {
+public:
+    /**
+     * Strategies for choosing the landmark nodes.
+     */
+    enum class Selection {
+        Farthest,  // Each landmark is the node farthest from the landmarks chosen before
+        Avoid      // Each landmark caps the region where the current landmarks bound worst
+    };
+
+    /**
+     * Constructor: Chooses the landmarks and computes their distance tables. The tables of
+     * farthest landmarks are computed in parallel, one Dijkstra search per landmark; the
+     * avoid strategy needs the tables of the landmarks chosen so far and builds them in turn.
+     * @param model The route model.
+     * @param count The number of landmarks; fewer are chosen if the graph is smaller.
+     * @param selection The strategy for choosing the landmarks.
+     * @param threads The number of threads computing the tables; 0 uses one per hardware thread.
+     */
+    Landmarks(const RouteModel& model, std::size_t count, Selection selection = Selection::Farthest,
+              std::size_t threads = 0);
+
+    /**
+     * Returns the number of landmarks.
+     */
+    std::size_t Count() const noexcept { return m_Nodes.size(); }
+
+    /**
+     * Returns the indices of the landmark nodes.
+     */
+    const std::vector<int>& Nodes() const noexcept { return m_Nodes; }
+
+    /**
+     * Returns the shortest distance between a landmark and a node.
+     * @param landmark The position of the landmark in Nodes().
+     * @param node_idx The index of the node.
+     * @return The distance in the model's normalized units, or infinity if the node is unreachable.
+     */
+    float Distance(std::size_t landmark, int node_idx) const {
+        return m_Distances[static_cast<std::size_t>(node_idx) * Count() + landmark];
+    }
+
+    /**
+     * Returns a lower bound of the shortest distance between two nodes.
+     * @param from_idx The index of one node.
+     * @param to_idx The index of the other node.
+     * @return The bound in the model's normalized units; 0 if no landmark reaches both nodes.
+     */
+    float LowerBound(int from_idx, int to_idx) const noexcept;
+
+private:
+    std::vector<int> m_Nodes;  // Landmark node indices
+
+    // Distance tables, node-major so that the bounds of one node share a cache line:
+    // the distance between landmark l and node v is m_Distances[v * Count() + l].
+    std::vector<float> m_Distances;
+};
+
+#endif
@@ -1,92 +1,286 @@
 #include <io2d.h>
+#include <charconv>
+#include <csignal>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <stdexcept>
 #include <string>
-#include <vector>
+#include "batch_query.h"
+#include "clip_region.h"
+#include "contraction_hierarchy.h"
+#include "mapped_file.h"
 #include "render.h"
 #include "route_model.h"
 #include "route_planner.h"
+#include "route_server.h"
 
 using namespace std::experimental;  // For io2d library
 
-/**
- * Reads binary data from a file and returns it as a vector of std::byte.
- * @param path The path to the file.
- * @return An optional vector of std::byte containing the file data, or std::nullopt if the file cannot be read.
- */
-static std::optional<std::vector<std::byte>> ReadFile(const std::string& path) {
-    std::ifstream is{path, std::ios::binary | std::ios::ate};  // Open file in binary mode and seek to the end
-    if (!is) {
-        std::cerr << "Failed to open file: " << path << std::endl;
-        return std::nullopt;
+namespace {
+
+// Command-line usage, printed without arguments and for malformed ones.
+constexpr char kUsage[] =
+    "Usage: [executable] [-f filename.osm[.gz|.bz2] | filename.osm.pbf | filename.rpmap] [-c filename.rpch] "
+    "[--batch queries.txt | - | --serve socket_path] [-t threads] [--routing-only] "
+    "[--bbox min_lat,min_lon,max_lat,max_lon | --poly region.poly] [--changes changes.osc]";
+
+RouteServer* running_server = nullptr;  // Stopped by SIGINT and SIGTERM, reloaded by SIGHUP in server mode
+
+// Loads the contraction hierarchy of a model from a file.
+std::unique_ptr<ContractionHierarchy> LoadHierarchy(const std::string& hierarchy_file, const RouteModel& model) {
+    auto hierarchy_data = MappedFile::Open(hierarchy_file);
+    if (!hierarchy_data) {
+        throw std::runtime_error("Failed to open file or file is empty: " + hierarchy_file);
     }
+    try {
+        return std::make_unique<ContractionHierarchy>(ContractionHierarchy::Load(hierarchy_data->Bytes(), model));
+    } catch (const std::logic_error& e) {
+        throw std::runtime_error("Failed to load " + hierarchy_file + ": " + e.what());
+    }
+}
 
-    auto size = is.tellg();  // Get file size
-    if (size <= 0) {
-        std::cerr << "File is empty or invalid: " << path << std::endl;
-        return std::nullopt;
+// Loads a clip polygon from a file in the .poly format.
+ClipRegion LoadClipPolygon(const std::string& poly_file) {
+    auto poly_data = MappedFile::Open(poly_file);
+    if (!poly_data) {
+        throw std::runtime_error("Failed to open file or file is empty: " + poly_file);
     }
+    return ClipRegion::ParsePoly({reinterpret_cast<const char*>(poly_data->Bytes().data()), poly_data->Bytes().size()});
+}
 
-    std::vector<std::byte> contents(size);  // Allocate buffer for file contents
-    is.seekg(0);  // Seek back to the beginning of the file
-    is.read(reinterpret_cast<char*>(contents.data()), size);  // Read file data into buffer
+// Applies the changes of an osmChange file to a model.
+void ApplyChanges(RouteModel& model, const std::string& changes_file, RouteModel::Profile profile, const ClipRegion* clip) {
+    auto changes = MappedFile::Open(changes_file);
+    if (!changes) {
+        throw std::runtime_error("Failed to open file or file is empty: " + changes_file);
+    }
+    try {
+        const auto applied = model.ApplyChange(changes->Bytes(), profile, clip);
+        std::cerr << "Applied " << applied << " changes from " << changes_file << std::endl;
+    } catch (const std::logic_error& e) {
+        throw std::runtime_error("Failed to apply " + changes_file + ": " + e.what());
+    }
+}
 
-    if (!is) {
-        std::cerr << "Failed to read file: " << path << std::endl;
-        return std::nullopt;
+// Loads the map for server mode from the OSM data file, parsed on the given number of threads,
+// and the optional hierarchy file, and applies the optional change file; the hierarchy of a
+// changed map is built anew.
+ServedMap LoadServedMap(const std::string& osm_data_file, const std::string& hierarchy_file,
+                        const std::string& changes_file, std::size_t threads, RouteModel::Profile profile,
+                        const ClipRegion* clip) {
+    auto osm_data = MappedFile::Open(osm_data_file);
+    if (!osm_data) {
+        throw std::runtime_error("Failed to open file or file is empty: " + osm_data_file);
     }
+    auto model = std::make_shared<RouteModel>(osm_data->Bytes(), threads, profile, clip);
+    ServedMap map;
+    if (!changes_file.empty()) {
+        ApplyChanges(*model, changes_file, profile, clip);
+        if (!hierarchy_file.empty()) {
+            map.hierarchy = std::make_shared<const ContractionHierarchy>(*model);
+        }
+    } else if (!hierarchy_file.empty()) {
+        map.hierarchy = LoadHierarchy(hierarchy_file, *model);
+    }
+    map.model = std::move(model);
+    return map;
+}
 
-    return std::move(contents);  // Return the file contents
+// Applies the change file to a copy of a served map: the served model is shared by the queries
+// in flight and stays immutable, so it keeps answering them until the copy replaces it.
+ServedMap ChangeServedMap(const ServedMap& served, const std::string& changes_file, RouteModel::Profile profile,
+                          const ClipRegion* clip) {
+    auto model = std::make_shared<RouteModel>(*served.model);
+    ApplyChanges(*model, changes_file, profile, clip);
+    ServedMap map;
+    if (served.hierarchy) {
+        map.hierarchy = std::make_shared<const ContractionHierarchy>(*model);
+    }
+    map.model = std::move(model);
+    return map;
 }
 
+}  // namespace
+
 int main(int argc, const char** argv) {
     std::string osm_data_file = "";  // Path to the OSM data file
+    std::string hierarchy_file = "";  // Path to an optional contraction hierarchy of the map
+    std::string batch_file = "";      // Path to a query file for batch mode, "-" for stdin
+    std::string socket_path = "";     // Path of the socket to serve queries on in server mode
+    std::string changes_file = "";    // Path to an optional osmChange file applied to the map
+    std::size_t threads = 0;          // Threads for loading and for batch and server queries; 0 uses all hardware threads
+    auto profile = RouteModel::Profile::Full;  // What to keep of the OSM data
+    std::optional<ClipRegion> clip;            // Region of the OSM data to keep, if not all of it
 
     // Parse command-line arguments
     if (argc > 1) {
         for (int i = 1; i < argc; ++i) {
             if (std::string_view{argv[i]} == "-f" && ++i < argc) {
                 osm_data_file = argv[i];  // Set OSM data file path from command-line argument
+            } else if (std::string_view{argv[i]} == "-c" && ++i < argc) {
+                hierarchy_file = argv[i];  // Answer the query with a contraction hierarchy
+            } else if (std::string_view{argv[i]} == "--batch" && ++i < argc) {
+                batch_file = argv[i];  // Answer a stream of queries without opening a window
+            } else if (std::string_view{argv[i]} == "--serve" && ++i < argc) {
+                socket_path = argv[i];  // Serve queries over a Unix domain socket until interrupted
+            } else if (std::string_view{argv[i]} == "--changes" && ++i < argc) {
+                changes_file = argv[i];  // Bring the map up to date with an osmChange diff
+            } else if (std::string_view{argv[i]} == "-t" && ++i < argc) {
+                const std::string_view count{argv[i]};
+                const auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), threads);
+                if (error != std::errc{} || end != count.data() + count.size()) {
+                    std::cerr << "Invalid number of threads: " << count << std::endl;
+                    std::cerr << kUsage << std::endl;
+                    return -1;
+                }
+            } else if (std::string_view{argv[i]} == "--routing-only") {
+                profile = RouteModel::Profile::Routing;  // Keep only the roads, e.g. for headless workers
+            } else if ((std::string_view{argv[i]} == "--bbox" || std::string_view{argv[i]} == "--poly") && i + 1 < argc) {
+                try {
+                    // Keep only a box "min_lat,min_lon,max_lat,max_lon" or a polygon of a .poly file
+                    const bool box = std::string_view{argv[i]} == "--bbox";
+                    clip = box ? ClipRegion::ParseBox(argv[i + 1]) : LoadClipPolygon(argv[i + 1]);
+                    ++i;
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << std::endl;
+                    return -1;
+                }
             }
         }
     } else {
         // Display usage instructions if no arguments are provided
         std::cout << "To specify a map file, use the following format: " << std::endl;
-        std::cout << "Usage: [executable] [-f filename.osm]" << std::endl;
+        std::cout << kUsage << std::endl;
         osm_data_file = "../map.osm";  // Default map file
     }
 
-    std::vector<std::byte> osm_data;  // Vector to store OSM data
+    // Map the OSM data file into memory; it is parsed in place without being copied.
+    // In batch and server mode progress goes to stderr, leaving stdout to the results.
+    const bool headless = !batch_file.empty() || !socket_path.empty();
+    std::ostream& log = headless ? std::cerr : std::cout;
+    log << "Reading OpenStreetMap data from the following file: "
+        << osm_data_file << std::endl;
 
-    // Read OSM data from the specified file
-    if (osm_data.empty() && !osm_data_file.empty()) {
-        std::cout << "Reading OpenStreetMap data from the following file: "
-                  << osm_data_file << std::endl;
-        auto data = ReadFile(osm_data_file);
-        if (!data) {
-            std::cerr << "Failed to read OSM data. Exiting." << std::endl;
+    // Serve queries until interrupted, without rendering. SIGHUP reloads the map from the same
+    // files, or with a change file, applies the file again to the current map: replacing the file
+    // with the next diff before the signal keeps the map up to date without reloading it.
+    if (!socket_path.empty()) {
+        try {
+            RouteServer server{LoadServedMap(osm_data_file, hierarchy_file, changes_file, threads, profile, clip ? &*clip : nullptr),
+                               socket_path, threads};
+            server.SetReloader([&] {
+                try {
+                    if (!changes_file.empty()) {
+                        std::cerr << "Applying OpenStreetMap changes from the following file: " << changes_file << std::endl;
+                        return ChangeServedMap(*server.Map(), changes_file, profile, clip ? &*clip : nullptr);
+                    }
+                    std::cerr << "Reloading OpenStreetMap data from the following file: " << osm_data_file << std::endl;
+                    return LoadServedMap(osm_data_file, hierarchy_file, changes_file, threads, profile, clip ? &*clip : nullptr);
+                } catch (const std::exception& e) {
+                    std::cerr << e.what() << std::endl;
+                    std::cerr << "Reload failed; still serving the previous map." << std::endl;
+                    return ServedMap{};
+                }
+            });
+            running_server = &server;
+            std::signal(SIGINT, [](int) { running_server->Stop(); });
+            std::signal(SIGTERM, [](int) { running_server->Stop(); });
+#ifdef SIGHUP
+            std::signal(SIGHUP, [](int) { running_server->Reload(); });
+#endif
+            std::cerr << "Serving route queries on " << socket_path << std::endl;
+            server.Run();
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+#ifdef SIGHUP
+            std::signal(SIGHUP, SIG_DFL);
+#endif
+            running_server = nullptr;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
             return -1;
         }
-        osm_data = std::move(*data);  // Move file data into osm_data
+        return 0;
+    }
+
+    auto osm_data = MappedFile::Open(osm_data_file);
+    if (!osm_data) {
+        std::cerr << "Failed to open file or file is empty: " << osm_data_file << std::endl;
+        std::cerr << "Failed to read OSM data. Exiting." << std::endl;
+        return -1;
     }
 
-    // Get user input for start and end coordinates
-    std::cout << "Enter start and end points (start_x start_y end_x end_y): ";
+    // Open the query file in batch mode, or get user input for start and end coordinates
+    std::ifstream batch_stream;
     float start_x{}, start_y{}, end_x{}, end_y{};
-    std::cin >> start_x >> start_y >> end_x >> end_y;
+    if (!batch_file.empty() && batch_file != "-") {
+        batch_stream.open(batch_file);
+        if (!batch_stream) {
+            std::cerr << "Failed to open query file: " << batch_file << std::endl;
+            return -1;
+        }
+    } else if (!headless) {
+        std::cout << "Enter start and end points (start_x start_y end_x end_y): ";
+        std::cin >> start_x >> start_y >> end_x >> end_y;
+
+        // Validate user input
+        if (std::cin.fail()) {
+            std::cerr << "Invalid input. Please enter numeric values." << std::endl;
+            return -1;
+        }
+    }
 
-    // Validate user input
-    if (std::cin.fail()) {
-        std::cerr << "Invalid input. Please enter numeric values." << std::endl;
+    // Build the RouteModel from OSM data; malformed data or a clip region off the map is reported
+    std::optional<RouteModel> loaded;
+    try {
+        loaded.emplace(osm_data->Bytes(), threads, profile, clip ? &*clip : nullptr);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "Failed to read OSM data. Exiting." << std::endl;
         return -1;
     }
+    RouteModel& model = *loaded;
+
+    // Bring the model up to date with the change file, if one was given
+    if (!changes_file.empty()) {
+        try {
+            ApplyChanges(model, changes_file, profile, clip ? &*clip : nullptr);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+    }
+
+    // Load the contraction hierarchy, if one was given; a changed map needs a new one
+    std::unique_ptr<ContractionHierarchy> hierarchy;
+    if (!hierarchy_file.empty()) {
+        try {
+            hierarchy = changes_file.empty() ? LoadHierarchy(hierarchy_file, model) : std::make_unique<ContractionHierarchy>(model);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+    }
 
-    // Build the RouteModel from OSM data
-    RouteModel model{osm_data};
+    // Answer the queries of the batch and exit without rendering
+    if (!batch_file.empty()) {
+        BatchOptions options;
+        options.threads = threads;
+        options.hierarchy = hierarchy.get();
+        std::istream& queries = batch_file == "-" ? std::cin : batch_stream;
+        const auto answered = RunBatchQueries(model, queries, std::cout, options);
+        std::cerr << "Answered " << answered << " queries." << std::endl;
+        return 0;
+    }
 
     // Create RoutePlanner object and perform A* search
     RoutePlanner route_planner{model, start_x, start_y, end_x, end_y};
+    if (hierarchy) {
+        route_planner.SetSearchMode(RoutePlanner::SearchMode::ContractionHierarchy);
+        route_planner.SetContractionHierarchy(hierarchy.get());
+    }
     route_planner.AStarSearch();
 
     // Display the distance of the calculated route
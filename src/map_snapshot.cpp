@@ -0,0 +1,322 @@
+#include "map_snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+#include "binary_io.h"
+#include "route_model.h"
+
+static_assert(sizeof(int) == sizeof(std::int32_t), "Snapshots store indices as 32-bit integers");
+namespace {
+
+// A node as stored in a snapshot: its coordinates; the index is the position in the array.
+struct StoredNode {
+    double x;
+    double y;
+};
+static_assert(sizeof(StoredNode) == 2 * sizeof(double), "Snapshots store nodes as pairs of doubles");
+
+constexpr char kMagic[8] = {'R', 'P', 'M', 'A', 'P', 'S', 'N', 'P'};
+constexpr std::uint32_t kByteOrderMark = 0x01020304;
+
+// Fixed-size header at the start of every snapshot.
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t model_offset;  // Start of the map feature sections
+    std::uint64_t graph_offset;  // Start of the routing graph sections
+    std::uint64_t size;          // Total size of the snapshot in bytes
+};
+
+using binary_io::Reader;
+using binary_io::Writer;
+
+constexpr char kCorrupt[] = "Map snapshot is truncated or corrupt.";
+
+// Rejects a malformed snapshot.
+[[noreturn]] void Fail() { throw std::logic_error(kCorrupt); }
+
+// Writes a list of index lists as an offset array and a flat array of indices.
+template <typename Range, typename Get>
+void WriteLists(Writer& w, const Range& range, Get&& get) {
+    std::vector<int> offsets{0};
+    std::vector<int> values;
+    for (const auto& item : range) {
+        const auto list = get(item);
+        values.insert(values.end(), list.begin(), list.end());
+        offsets.push_back(static_cast<int>(values.size()));
+    }
+    w.Array(offsets);
+    w.Array(values);
+}
+
+// A list of index lists read back from a snapshot.
+class Lists {
+public:
+    Lists(Span<const int> offsets, Span<const int> values) : m_Offsets(offsets), m_Values(values) {}
+
+    std::size_t size() const noexcept { return m_Offsets.size() - 1; }
+
+    Span<const int> Offsets() const noexcept { return m_Offsets; }
+    Span<const int> Values() const noexcept { return m_Values; }
+
+    Span<const int> operator[](std::size_t i) const {
+        return {m_Values.data() + m_Offsets[i], m_Values.data() + m_Offsets[i + 1]};
+    }
+
+private:
+    Span<const int> m_Offsets;
+    Span<const int> m_Values;
+};
+
+// Reads the lists written by WriteLists, checking the offsets and that every index is below a limit.
+Lists ReadLists(Reader& r, std::size_t index_limit) {
+    const auto offsets = r.Array<int>();
+    const auto values = r.Array<int>();
+    if (offsets.empty() || offsets[0] != 0 || offsets.back() != static_cast<int>(values.size())) {
+        Fail();
+    }
+    for (std::size_t i = 1; i < offsets.size(); ++i) {
+        if (offsets[i - 1] > offsets[i]) Fail();
+    }
+    for (int v : values) {
+        if (v < 0 || static_cast<std::size_t>(v) >= index_limit) Fail();
+    }
+    return {offsets, values};
+}
+
+template <typename MP>
+void WriteMultipolygons(Writer& w, const Model& model, const std::vector<MP>& mps) {
+    WriteLists(w, mps, [&](const MP& mp) { return model.OuterWays(mp); });
+    WriteLists(w, mps, [&](const MP& mp) { return model.InnerWays(mp); });
+}
+
+// Reads the multipolygons written by WriteMultipolygons, appending their ring ways to a buffer.
+template <typename MP>
+void ReadMultipolygons(Reader& r, std::vector<MP>& mps, std::vector<int>& ring_ways, std::size_t way_count) {
+    const auto outer = ReadLists(r, way_count);
+    const auto inner = ReadLists(r, way_count);
+    if (inner.size() != outer.size()) Fail();
+    mps.resize(outer.size());
+    for (std::size_t i = 0; i < mps.size(); ++i) {
+        mps[i].outer = static_cast<int>(ring_ways.size());
+        ring_ways.insert(ring_ways.end(), outer[i].begin(), outer[i].end());
+        mps[i].inner = static_cast<int>(ring_ways.size());
+        ring_ways.insert(ring_ways.end(), inner[i].begin(), inner[i].end());
+        mps[i].end = static_cast<int>(ring_ways.size());
+    }
+}
+
+// Reads and validates the header of a snapshot.
+Header ReadHeader(Span<const std::byte> data) {
+    Header header;
+    if (data.size() < sizeof(header)) Fail();
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) Fail();
+    if (header.byte_order != kByteOrderMark) {
+        throw std::logic_error("Map snapshot was written on a machine with a different byte order.");
+    }
+    if (header.version != MapSnapshot::kVersion) {
+        throw std::logic_error("Unsupported map snapshot version " + std::to_string(header.version) +
+                               "; recompile the map.");
+    }
+    if (header.size != data.size()) Fail();
+    return header;
+}
+
+}  // namespace
+
+/**
+ * Checks whether a buffer starts with the snapshot signature.
+ * @param data The buffer.
+ * @return True if the buffer looks like a snapshot (of any version).
+ */
+bool MapSnapshot::Matches(Span<const std::byte> data) noexcept {
+    return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+/**
+ * Writes a snapshot of a model to a stream.
+ * @param model The model.
+ * @param os The output stream, opened in binary mode.
+ */
+void MapSnapshot::Write(const RouteModel& model, std::ostream& os) {
+    Writer w;
+    Header header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrderMark;
+    w.Reserve(sizeof(header));
+
+    // Map features, as left by the Model constructor (adjusted coordinates, sorted roads)
+    header.model_offset = w.Position();
+    const double bounds[] = {model.m_MinLat, model.m_MaxLat, model.m_MinLon, model.m_MaxLon, model.m_MetricScale};
+    w.Array(bounds, std::size(bounds));
+    std::vector<StoredNode> nodes;
+    nodes.reserve(model.Nodes().size());
+    for (const auto& node : model.Nodes()) {
+        nodes.push_back({node.x, node.y});
+    }
+    w.Array(nodes);
+    WriteLists(w, model.Ways(), [&](const Model::Way& way) { return model.WayNodes(way); });
+
+    std::vector<int> road_ways, road_types;
+    for (const auto& road : model.Roads()) {
+        road_ways.push_back(road.way);
+        road_types.push_back(static_cast<int>(road.type));
+    }
+    w.Array(road_ways);
+    w.Array(road_types);
+
+    std::vector<int> railway_ways;
+    for (const auto& railway : model.Railways()) {
+        railway_ways.push_back(railway.way);
+    }
+    w.Array(railway_ways);
+
+    WriteMultipolygons(w, model, model.Buildings());
+    WriteMultipolygons(w, model, model.Leisures());
+    WriteMultipolygons(w, model, model.Waters());
+    WriteMultipolygons(w, model, model.Landuses());
+    std::vector<int> landuse_types;
+    for (const auto& landuse : model.Landuses()) {
+        landuse_types.push_back(static_cast<int>(landuse.type));
+    }
+    w.Array(landuse_types);
+
+    w.Array(model.NodeIds());
+    w.Array(model.WayIds());
+
+    // Routing graph
+    header.graph_offset = w.Position();
+    w.Array(model.m_AdjOffsets);
+    w.Array(model.m_AdjTargets);
+    w.Array(model.m_AdjLengths);
+
+    header.size = w.Position();
+    w.Patch(0, &header, sizeof(header));
+    if (!os.write(w.Buffer().data(), static_cast<std::streamsize>(w.Buffer().size()))) {
+        throw std::runtime_error("Failed to write the map snapshot.");
+    }
+}
+
+/**
+ * Writes a snapshot of a model to a file.
+ * @param model The model.
+ * @param path The path of the snapshot file.
+ */
+void MapSnapshot::Write(const RouteModel& model, const std::string& path) {
+    std::ofstream os{path, std::ios::binary | std::ios::trunc};
+    if (!os) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+    Write(model, os);
+    os.close();
+    if (!os) {
+        throw std::runtime_error("Failed to write file: " + path);
+    }
+}
+
+/**
+ * Restores the map features of a model from a snapshot.
+ * @param data The snapshot.
+ * @param model The model to fill.
+ */
+void MapSnapshot::ReadModel(Span<const std::byte> data, Model& model) {
+    const Header header = ReadHeader(data);
+    Reader r{data, header.model_offset, kCorrupt};
+
+    const auto bounds = r.Array<double>();
+    if (bounds.size() != 5) Fail();
+    model.m_MinLat = bounds[0];
+    model.m_MaxLat = bounds[1];
+    model.m_MinLon = bounds[2];
+    model.m_MaxLon = bounds[3];
+    model.m_MetricScale = bounds[4];
+
+    const auto nodes = r.Array<StoredNode>();
+    const auto node_count = nodes.size();
+    model.m_Nodes.resize(node_count);
+    for (std::size_t i = 0; i < node_count; ++i) {
+        model.m_Nodes[i] = {nodes[i].x, nodes[i].y, static_cast<int>(i)};
+    }
+
+    const auto ways = ReadLists(r, node_count);
+    const auto way_count = ways.size();
+    const auto way_offsets = ways.Offsets();
+    const auto way_nodes = ways.Values();
+    model.m_WayNodes.assign(way_nodes.begin(), way_nodes.end());
+    model.m_Ways.resize(way_count);
+    for (std::size_t i = 0; i < way_count; ++i) {
+        model.m_Ways[i] = {way_offsets[i], way_offsets[i + 1]};
+    }
+
+    const auto road_ways = r.Array<int>();
+    const auto road_types = r.Array<int>();
+    if (road_types.size() != road_ways.size()) Fail();
+    model.m_Roads.resize(road_ways.size());
+    for (std::size_t i = 0; i < road_ways.size(); ++i) {
+        if (road_ways[i] < 0 || static_cast<std::size_t>(road_ways[i]) >= way_count) Fail();
+        if (road_types[i] < Model::Road::Invalid || road_types[i] > Model::Road::Footway) Fail();
+        model.m_Roads[i].way = road_ways[i];
+        model.m_Roads[i].type = static_cast<Model::Road::Type>(road_types[i]);
+    }
+
+    const auto railway_ways = r.Array<int>();
+    model.m_Railways.resize(railway_ways.size());
+    for (std::size_t i = 0; i < railway_ways.size(); ++i) {
+        if (railway_ways[i] < 0 || static_cast<std::size_t>(railway_ways[i]) >= way_count) Fail();
+        model.m_Railways[i].way = railway_ways[i];
+    }
+
+    ReadMultipolygons(r, model.m_Buildings, model.m_RingWays, way_count);
+    ReadMultipolygons(r, model.m_Leisures, model.m_RingWays, way_count);
+    ReadMultipolygons(r, model.m_Waters, model.m_RingWays, way_count);
+    ReadMultipolygons(r, model.m_Landuses, model.m_RingWays, way_count);
+    const auto landuse_types = r.Array<int>();
+    if (landuse_types.size() != model.m_Landuses.size()) Fail();
+    for (std::size_t i = 0; i < landuse_types.size(); ++i) {
+        if (landuse_types[i] < Model::Landuse::Invalid || landuse_types[i] > Model::Landuse::Residential) {
+            Fail();
+        }
+        model.m_Landuses[i].type = static_cast<Model::Landuse::Type>(landuse_types[i]);
+    }
+
+    const auto node_ids = r.Array<std::int64_t>();
+    const auto way_ids = r.Array<std::int64_t>();
+    if (node_ids.size() != node_count || way_ids.size() != way_count) Fail();
+    model.m_NodeIds.assign(node_ids.begin(), node_ids.end());
+    model.m_WayIds.assign(way_ids.begin(), way_ids.end());
+}
+
+/**
+ * Restores the routing graph of a route model from a snapshot.
+ * @param data The snapshot.
+ * @param model The route model to fill; its nodes must already be restored.
+ */
+void MapSnapshot::ReadGraph(Span<const std::byte> data, RouteModel& model) {
+    const Header header = ReadHeader(data);
+    Reader r{data, header.graph_offset, kCorrupt};
+
+    const auto offsets = r.Array<int>();
+    const auto targets = r.Array<int>();
+    const auto lengths = r.Array<float>();
+    const auto node_count = model.m_Nodes.size();
+    if (offsets.size() != node_count + 1 || offsets[0] != 0 ||
+        offsets.back() != static_cast<int>(targets.size()) || lengths.size() != targets.size()) {
+        Fail();
+    }
+    for (std::size_t i = 0; i < node_count; ++i) {
+        if (offsets[i] > offsets[i + 1]) Fail();
+    }
+    for (int target : targets) {
+        if (target < 0 || static_cast<std::size_t>(target) >= node_count) Fail();
+    }
+
+    model.m_AdjOffsets.assign(offsets.begin(), offsets.end());
+    model.m_AdjTargets.assign(targets.begin(), targets.end());
+    model.m_AdjLengths.assign(lengths.begin(), lengths.end());
+}
@@ -0,0 +1,64 @@
+#ifndef MAP_SNAPSHOT_H
+#define MAP_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include "span.h"
+
+class Model;
+class RouteModel;
+
+/**
+ * The MapSnapshot class reads and writes compiled maps: a versioned binary image of a
+ * RouteModel holding the adjusted node coordinates, the ways, the sorted roads, the
+ * multipolygons, the original OSM IDs and the routing graph as flat arrays. Loading a
+ * snapshot skips the XML parse, the ID resolution, the coordinate adjustment and the
+ * graph build. It is not used in place: the arrays are copied out of the (usually memory-mapped)
+ * snapshot into the model, which owns its data and no longer needs the snapshot.
+ *
+ * A RouteModel constructed from bytes that start with the snapshot signature loads the
+ * snapshot instead of parsing XML, so a snapshot can be used wherever an .osm file is.
+ * Snapshots use the native byte order and are rejected on a machine with another one.
+ */
+class MapSnapshot {
+public:
+    // Format version; bump whenever the layout of the snapshot changes.
+    static constexpr std::uint32_t kVersion = 2;
+
+    /**
+     * Checks whether a buffer starts with the snapshot signature.
+     * @param data The buffer.
+     * @return True if the buffer looks like a snapshot (of any version).
+     */
+    static bool Matches(Span<const std::byte> data) noexcept;
+
+    /**
+     * Writes a snapshot of a model to a stream.
+     * @param model The model.
+     * @param os The output stream, opened in binary mode.
+     * @throws std::runtime_error if writing fails.
+     */
+    static void Write(const RouteModel& model, std::ostream& os);
+
+    /**
+     * Writes a snapshot of a model to a file.
+     * @param model The model.
+     * @param path The path of the snapshot file.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    static void Write(const RouteModel& model, const std::string& path);
+
+private:
+    friend class Model;
+    friend class RouteModel;
+
+    // Restores the map features of a model from a snapshot.
+    static void ReadModel(Span<const std::byte> data, Model& model);
+
+    // Restores the routing graph of a route model from a snapshot.
+    static void ReadGraph(Span<const std::byte> data, RouteModel& model);
+};
+
+#endif
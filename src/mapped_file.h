@@ -0,0 +1,50 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include "span.h"
+
+/**
+ * The MappedFile class maps a file read-only into memory. The contents are paged in
+ * by the OS on demand and are never copied into a user-space buffer, so a model can
+ * be parsed straight from the page cache.
+ */
+class MappedFile {
+public:
+    /**
+     * Maps a file into memory.
+     * @param path The path to the file.
+     * @return The mapping, or std::nullopt if the file cannot be opened or is empty.
+     */
+    static std::optional<MappedFile> Open(const std::string& path);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    /**
+     * Returns a view of the mapped bytes, valid for the lifetime of the mapping.
+     */
+    Span<const std::byte> Bytes() const noexcept { return {static_cast<const std::byte*>(m_Data), m_Size}; }
+
+    std::size_t Size() const noexcept { return m_Size; }
+
+private:
+    MappedFile() = default;
+
+    // Unmaps the file and releases the handles.
+    void Close() noexcept;
+
+    const void* m_Data = nullptr;  // Start of the mapping
+    std::size_t m_Size = 0;        // Size of the mapping in bytes
+#ifdef _WIN32
+    void* m_File = nullptr;        // File handle
+    void* m_Mapping = nullptr;     // File mapping handle
+#endif
+};
+
+#endif
@@ -1,10 +1,19 @@
 #include "model.h"
-#include "pugixml.hpp"
+#include "clip_region.h"
+#include "decompressor.h"
+#include "id_map.h"
+#include "map_snapshot.h"
+#include "osm_pbf_reader.h"
+#include "osm_xml_reader.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <string_view>
 #include <cmath>
 #include <algorithm>
-#include <cassert>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
 
 /**
  * Converts a string representation of a road type to the corresponding enum value.
@@ -45,12 +54,58 @@ static Model::Landuse::Type String2LanduseType(std::string_view type) {
     return Model::Landuse::Invalid;
 }
 
+namespace {
+
+// The line features that the tags of a way make of it.
+struct LineFeatures {
+    Model::Road::Type road = Model::Road::Invalid;  // Type of the road, or Invalid if the way is none
+    bool railway = false;                           // Whether the way is a railway
+};
+
+}  // namespace
+
+/**
+ * Classifies a way as a road and as a railway by its tags.
+ * @param tags The tags of the way.
+ * @return The line features of the way.
+ */
+static LineFeatures ClassifyLines(const std::vector<OsmTag>& tags) {
+    LineFeatures lines;
+    for (const auto& tag : tags) {
+        if (tag.key == "highway") {
+            if (auto road_type = String2RoadType(tag.value); road_type != Model::Road::Invalid) {
+                lines.road = road_type;
+            }
+        } else if (tag.key == "railway") {
+            lines.railway = true;
+        }
+    }
+    return lines;
+}
+
 /**
- * Constructor: Initializes the Model with OSM XML data.
- * @param xml The OSM XML data as a vector of bytes.
+ * Constructor: Initializes the Model with OSM XML data, plain or compressed with gzip or bzip2,
+ * with OSM PBF data, or with a compiled map snapshot.
+ * @param xml A read-only view of the OSM data or the snapshot, e.g. a MappedFile. It is not copied.
+ * @param threads The number of threads parsing the XML data; 0 uses one per hardware thread.
+ * @param profile What to keep of OSM data; a snapshot must already hold no more than that.
+ * @param clip The region of OSM data to keep, or nullptr for all of it; must be nullptr for snapshots.
+ * @throws std::invalid_argument if a snapshot is to be clipped, or holds more than the routing
+ * profile keeps when that profile is asked for.
  */
-Model::Model(const std::vector<std::byte>& xml) {
-    LoadData(xml);  // Load and parse the XML data
+Model::Model(Span<const std::byte> xml, std::size_t threads, Profile profile, const ClipRegion* clip) {
+    if (MapSnapshot::Matches(xml)) {
+        if (clip) {
+            throw std::invalid_argument("A map snapshot cannot be clipped when loaded; clip the map when compiling it.");
+        }
+        MapSnapshot::ReadModel(xml, *this);  // Already adjusted and sorted when compiled
+        if (profile == Profile::Routing && !HoldsRoadsOnly()) {
+            throw std::invalid_argument("The map snapshot holds more than the roads; compile it with the routing profile.");
+        }
+        return;
+    }
+
+    LoadData(xml, threads, profile, clip);  // Load and parse the XML data
     AdjustCoordinates();  // Adjust node coordinates to fit the map bounds
 
     // Sort roads by type for easier rendering
@@ -60,258 +115,1003 @@ Model::Model(const std::vector<std::byte>& xml) {
 }
 
 /**
- * Loads and parses OSM XML data into the model.
- * @param xml The OSM XML data as a vector of bytes.
+ * The Loader class collects the elements of one piece of an OSM file into a partial
+ * model: nodes, ways with their node references still as OSM IDs, and the features
+ * classified from way tags, all indexed locally to the piece. Multipolygon relations
+ * are kept aside. Assemble() then concatenates the pieces in file order, resolves the
+ * references and the relations, and yields exactly what a single pass over the whole
+ * file would. A file parsed on one thread is a single piece. With the routing profile,
+ * only the roads are kept, and then only the nodes they refer to. With a clip region,
+ * nodes outside it are dropped as they are parsed, roads and railways are split where
+ * they leave the region, and other ways keep only their nodes inside.
  */
-void Model::LoadData(const std::vector<std::byte>& xml) {
-    using namespace pugi;
-
-    xml_document doc;
-    if (!doc.load_buffer(xml.data(), xml.size())) {
-        throw std::logic_error("Failed to parse the XML file.");
-    }
-
-    // Extract map bounds from the XML
-    if (auto bounds = doc.select_nodes("/osm/bounds"); !bounds.empty()) {
-        auto node = bounds.first().node();
-        m_MinLat = std::stod(node.attribute("minlat").as_string());
-        m_MaxLat = std::stod(node.attribute("maxlat").as_string());
-        m_MinLon = std::stod(node.attribute("minlon").as_string());
-        m_MaxLon = std::stod(node.attribute("maxlon").as_string());
-    } else {
-        throw std::logic_error("Map bounds are not defined in the XML file.");
+class Model::Loader : public OsmHandler {
+public:
+    explicit Loader(Profile profile = Profile::Full, const ClipRegion* clip = nullptr)
+        : m_Profile(profile), m_Clip(clip) {}
+
+    /**
+     * Stores the map bounds of the first <bounds> element.
+     */
+    void Bounds(double min_lat, double min_lon, double max_lat, double max_lon) override {
+        if (m_HasBounds) return;
+        m_HasBounds = true;
+        m_Part.m_MinLat = min_lat;
+        m_Part.m_MaxLat = max_lat;
+        m_Part.m_MinLon = min_lon;
+        m_Part.m_MaxLon = max_lon;
     }
 
-    // Parse nodes
-    std::unordered_map<std::string, int> node_id_to_num;
-    for (const auto& node : doc.select_nodes("/osm/node")) {
-        node_id_to_num[node.node().attribute("id").as_string()] = static_cast<int>(m_Nodes.size());
-        m_Nodes.emplace_back();
-        m_Nodes.back().y = std::stod(node.node().attribute("lat").as_string());
-        m_Nodes.back().x = std::stod(node.node().attribute("lon").as_string());
-    }
-
-    // Parse ways
-    std::unordered_map<std::string, int> way_id_to_num;
-    for (const auto& way : doc.select_nodes("/osm/way")) {
-        auto node = way.node();
-        const auto way_num = static_cast<int>(m_Ways.size());
-        way_id_to_num[node.attribute("id").as_string()] = way_num;
-        m_Ways.emplace_back();
-        auto& new_way = m_Ways.back();
-
-        for (auto child : node.children()) {
-            auto name = std::string_view{child.name()};
-            if (name == "nd") {
-                auto ref = child.attribute("ref").as_string();
-                if (auto it = node_id_to_num.find(ref); it != node_id_to_num.end()) {
-                    new_way.nodes.emplace_back(it->second);
-                }
-            } else if (name == "tag") {
-                auto category = std::string_view{child.attribute("k").as_string()};
-                auto type = std::string_view{child.attribute("v").as_string()};
-                if (category == "highway") {
-                    if (auto road_type = String2RoadType(type); road_type != Road::Invalid) {
-                        m_Roads.emplace_back();
-                        m_Roads.back().way = way_num;
-                        m_Roads.back().type = road_type;
-                    }
-                } else if (category == "railway") {
-                    m_Railways.emplace_back();
-                    m_Railways.back().way = way_num;
-                } else if (category == "building") {
-                    m_Buildings.emplace_back();
-                    m_Buildings.back().outer = {way_num};
-                } else if (category == "leisure" ||
-                           (category == "natural" && (type == "wood" || type == "tree_row" || type == "scrub" || type == "grassland")) ||
-                           (category == "landcover" && type == "grass")) {
-                    m_Leisures.emplace_back();
-                    m_Leisures.back().outer = {way_num};
-                } else if (category == "natural" && type == "water") {
-                    m_Waters.emplace_back();
-                    m_Waters.back().outer = {way_num};
-                } else if (category == "landuse") {
-                    if (auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid) {
-                        m_Landuses.emplace_back();
-                        m_Landuses.back().outer = {way_num};
-                        m_Landuses.back().type = landuse_type;
-                    }
+    /**
+     * Stores a node with its raw coordinates, unless it lies outside the clip region.
+     */
+    void Node(OsmId id, double lat, double lon) override {
+        if (m_Clip && !m_Clip->Contains(lat, lon)) return;
+        m_Part.m_NodeIds.push_back(id);
+        auto& node = m_Part.m_Nodes.emplace_back();
+        node.y = lat;
+        node.x = lon;
+    }
+
+    /**
+     * Stores a way and classifies it by its tags. The routing profile skips ways that are not roads.
+     */
+    void Way(OsmId id, const std::vector<OsmId>& refs, const std::vector<OsmTag>& tags) override {
+        const auto lines = ClassifyLines(tags);
+        if (m_Profile == Profile::Routing && lines.road == Road::Invalid) {
+            return;
+        }
+
+        auto& m = m_Part;
+        const auto way_num = static_cast<int>(m.m_Ways.size());
+        m.m_WayIds.push_back(id);
+        m.m_Ways.emplace_back();  // Node references are resolved by Assemble()
+        m_Refs.insert(m_Refs.end(), refs.begin(), refs.end());
+        m_RefEnds.push_back(m_Refs.size());
+        m_NodesSeen.push_back(m.m_Nodes.size());
+
+        if (lines.road != Road::Invalid) {
+            m.m_Roads.push_back({way_num, lines.road});
+        }
+        if (m_Profile == Profile::Routing) {
+            m_IsLine.push_back(true);
+            return;  // Roads only
+        }
+        if (lines.railway) {
+            m.m_Railways.push_back({way_num});
+        }
+        m.AddWayAreas(way_num, tags);
+        m_IsLine.push_back(lines.road != Road::Invalid || lines.railway);  // Split where it leaves the clip region
+    }
+
+    /**
+     * Records a multipolygon relation that describes a building, water or land use area.
+     * Relations are resolved in Assemble(), once every way is known.
+     */
+    void Relation(OsmId /*id*/, const std::vector<OsmMember>& members, const std::vector<OsmTag>& tags) override {
+        if (m_Profile == Profile::Routing) return;  // Areas are not kept
+
+        // The first tag that classifies the relation decides what it becomes
+        PendingRelation relation;
+        for (const auto& tag : tags) {
+            if (tag.key == "building") {
+                relation.kind = PendingRelation::Building;
+                break;
+            } else if (tag.key == "natural" && tag.value == "water") {
+                relation.kind = PendingRelation::Water;
+                break;
+            } else if (tag.key == "landuse") {
+                relation.landuse_type = String2LanduseType(tag.value);
+                if (relation.landuse_type != Landuse::Invalid) {
+                    relation.kind = PendingRelation::Landuse;
                 }
+                break;
             }
         }
+        if (relation.kind == PendingRelation::None) return;
+
+        for (const auto& member : members) {
+            if (member.type == "way") {
+                relation.ways.emplace_back(member.ref, member.role == "outer");
+            }
+        }
+        m_Relations.emplace_back(std::move(relation));
     }
 
-    // Parse relations (multipolygons)
-    for (const auto& relation : doc.select_nodes("/osm/relation")) {
-        auto node = relation.node();
-        std::vector<int> outer, inner;
-        auto commit = [&](Multipolygon& mp) {
-            mp.outer = std::move(outer);
-            mp.inner = std::move(inner);
-        };
-        for (auto child : node.children()) {
-            auto name = std::string_view{child.name()};
-            if (name == "member") {
-                if (std::string_view{child.attribute("type").as_string()} == "way") {
-                    if (!way_id_to_num.count(child.attribute("ref").as_string())) continue;
-                    auto way_num = way_id_to_num[child.attribute("ref").as_string()];
-                    if (std::string_view{child.attribute("role").as_string()} == "outer") {
-                        outer.emplace_back(way_num);
-                    } else {
-                        inner.emplace_back(way_num);
-                    }
+    /**
+     * Builds the model from the pieces of a file, given in file order.
+     * @param parts The loaders of the pieces; their contents are consumed.
+     * @param model The model to fill.
+     * @param pool Workers for resolving the way node references, or nullptr.
+     * @throws std::logic_error if the file has no map bounds.
+     * @throws std::invalid_argument if the clip region misses the map bounds, or if the routing
+     * profile keeps no road.
+     */
+    static void Assemble(std::vector<Loader>& parts, Model& model, ThreadPool* pool);
+
+private:
+    /**
+     * Resolves the node references of the ways of the piece into node indices.
+     * @param node_id_to_num The indices of all nodes of the file by OSM ID.
+     * @param node_base The index of the first node of the piece.
+     */
+    void ResolveWays(const IdMap& node_id_to_num, std::size_t node_base);
+
+    /**
+     * Resolves the node references of the ways of the piece for a clip region, splitting
+     * lines at references to dropped nodes and dropping ways left without nodes.
+     * @param node_id_to_num The indices of all nodes of the file by OSM ID.
+     * @param node_base The index of the first node of the piece.
+     */
+    void ResolveClippedWays(const IdMap& node_id_to_num, std::size_t node_base);
+
+    // A multipolygon relation waiting for all ways to be loaded.
+    struct PendingRelation {
+        enum Kind { None, Building, Water, Landuse } kind = None;
+        Landuse::Type landuse_type = Landuse::Invalid;
+        std::vector<std::pair<OsmId, bool>> ways;  // Member way IDs and whether they are outer
+    };
+
+    Profile m_Profile;               // What to keep of the elements
+    const ClipRegion* m_Clip;        // Region of the nodes to keep, or nullptr for all
+    Model m_Part;                    // Elements of the piece, with locally numbered ways
+    bool m_HasBounds = false;
+    std::vector<OsmId> m_Refs;                  // Node references of all ways of the piece
+    std::vector<std::size_t> m_RefEnds;         // End of the references of each way in m_Refs
+    std::vector<std::size_t> m_NodesSeen;       // Nodes of the piece preceding each way
+    std::vector<bool> m_IsLine;                 // Whether each way is a road or a railway
+    std::vector<PendingRelation> m_Relations;
+};
+
+/**
+ * Builds the model from the pieces of a file, given in file order.
+ * @param parts The loaders of the pieces; their contents are consumed.
+ * @param model The model to fill.
+ * @param pool Workers for resolving the way node references, or nullptr.
+ */
+void Model::Loader::Assemble(std::vector<Loader>& parts, Model& model, ThreadPool* pool) {
+    auto& m = model;
+    const auto for_each_part = [&](auto&& body) {
+        if (pool) {
+            pool->ParallelFor(parts.size(), body);
+        } else {
+            for (std::size_t k = 0; k < parts.size(); ++k) body(k);
+        }
+    };
+
+    // The first <bounds> element of the file wins; a clip region narrows them or stands in for them
+    const ClipRegion* clip = parts.front().m_Clip;
+    auto with_bounds = std::find_if(parts.begin(), parts.end(), [](const Loader& part) { return part.m_HasBounds; });
+    if (with_bounds == parts.end() && !clip) {
+        throw std::logic_error("Map bounds are not defined in the XML file.");
+    }
+    if (with_bounds != parts.end()) {
+        m.m_MinLat = with_bounds->m_Part.m_MinLat;
+        m.m_MaxLat = with_bounds->m_Part.m_MaxLat;
+        m.m_MinLon = with_bounds->m_Part.m_MinLon;
+        m.m_MaxLon = with_bounds->m_Part.m_MaxLon;
+    }
+    if (clip) {
+        const bool narrow = with_bounds != parts.end();
+        m.m_MinLat = narrow ? std::max(m.m_MinLat, clip->MinLat()) : clip->MinLat();
+        m.m_MaxLat = narrow ? std::min(m.m_MaxLat, clip->MaxLat()) : clip->MaxLat();
+        m.m_MinLon = narrow ? std::max(m.m_MinLon, clip->MinLon()) : clip->MinLon();
+        m.m_MaxLon = narrow ? std::min(m.m_MaxLon, clip->MaxLon()) : clip->MaxLon();
+        if (!(m.m_MinLat < m.m_MaxLat) || !(m.m_MinLon < m.m_MaxLon)) {
+            throw std::invalid_argument("Clip region does not overlap the map bounds.");
+        }
+    }
+
+    // Concatenate the nodes; the node index is the position in the file
+    std::vector<std::size_t> node_base{0};
+    for (const auto& part : parts) {
+        node_base.push_back(node_base.back() + part.m_Part.m_Nodes.size());
+    }
+    m.m_Nodes = std::move(parts.front().m_Part.m_Nodes);
+    m.m_NodeIds = std::move(parts.front().m_Part.m_NodeIds);
+    m.m_Nodes.reserve(node_base.back());
+    m.m_NodeIds.reserve(node_base.back());
+    for (std::size_t k = 1; k < parts.size(); ++k) {
+        auto& part = parts[k].m_Part;
+        m.m_Nodes.insert(m.m_Nodes.end(), part.m_Nodes.begin(), part.m_Nodes.end());
+        m.m_NodeIds.insert(m.m_NodeIds.end(), part.m_NodeIds.begin(), part.m_NodeIds.end());
+        part.m_Nodes = {};
+        part.m_NodeIds = {};
+    }
+    for (std::size_t i = 0; i < m.m_Nodes.size(); ++i) {
+        m.m_Nodes[i].index = static_cast<int>(i);
+    }
+
+    IdMap node_id_to_num{m.m_NodeIds.size()};  // OSM node ID -> index in m_Nodes
+    for (std::size_t i = 0; i < m.m_NodeIds.size(); ++i) {
+        node_id_to_num.Insert(m.m_NodeIds[i], static_cast<int>(i));
+    }
+
+    // Resolve the way node references against the nodes that precede each way in the file
+    for_each_part([&](std::size_t k) {
+        if (clip) {
+            parts[k].ResolveClippedWays(node_id_to_num, node_base[k]);
+        } else {
+            parts[k].ResolveWays(node_id_to_num, node_base[k]);
+        }
+    });
+    node_id_to_num = IdMap{};  // Released before the ways are gathered
+
+    // Concatenate the ways and the features, renumbering their ways and node lists
+    std::vector<std::size_t> way_base{0};
+    for (const auto& part : parts) {
+        way_base.push_back(way_base.back() + part.m_Part.m_Ways.size());
+    }
+    const auto append = [](auto& to, auto& from, int offset, auto&& renumber) {
+        for (auto& item : from) {
+            renumber(item, offset);
+            to.emplace_back(std::move(item));
+        }
+        from = {};
+    };
+    const auto renumber_nodes = [](Model::Way& way, int offset) {
+        way.begin += offset;
+        way.end += offset;
+    };
+    const auto renumber_way = [](auto& item, int offset) { item.way += offset; };
+    const auto renumber_rings = [](auto& item, int offset) {
+        item.outer += offset;
+        item.inner += offset;
+        item.end += offset;
+    };
+    m.m_Ways.reserve(way_base.back());
+    for (std::size_t k = 0; k < parts.size(); ++k) {
+        auto& part = parts[k].m_Part;
+        const auto offset = static_cast<int>(way_base[k]);
+        const auto node_offset = static_cast<int>(m.m_WayNodes.size());
+        const auto ring_offset = static_cast<int>(m.m_RingWays.size());
+        append(m.m_Ways, part.m_Ways, node_offset, renumber_nodes);
+        m.m_WayNodes.insert(m.m_WayNodes.end(), part.m_WayNodes.begin(), part.m_WayNodes.end());
+        part.m_WayNodes = {};
+        for (const int way_num : part.m_RingWays) {
+            m.m_RingWays.push_back(way_num + offset);
+        }
+        part.m_RingWays = {};
+        m.m_WayIds.insert(m.m_WayIds.end(), part.m_WayIds.begin(), part.m_WayIds.end());
+        append(m.m_Roads, part.m_Roads, offset, renumber_way);
+        append(m.m_Railways, part.m_Railways, offset, renumber_way);
+        append(m.m_Buildings, part.m_Buildings, ring_offset, renumber_rings);
+        append(m.m_Leisures, part.m_Leisures, ring_offset, renumber_rings);
+        append(m.m_Waters, part.m_Waters, ring_offset, renumber_rings);
+        append(m.m_Landuses, part.m_Landuses, ring_offset, renumber_rings);
+    }
+    if (parts.front().m_Profile == Profile::Routing) {
+        m.DropUnreferencedNodes();  // Only the nodes of the roads are needed
+        if (m.m_Nodes.empty()) {
+            throw std::invalid_argument("The map holds no roads to keep with the routing profile.");
+        }
+    }
+
+    // Resolve the multipolygon relations against all ways
+    IdMap way_id_to_num{m.m_WayIds.size()};  // OSM way ID -> index in m_Ways
+    for (std::size_t i = 0; i < m.m_WayIds.size(); ++i) {
+        way_id_to_num.Insert(m.m_WayIds[i], static_cast<int>(i));
+    }
+    for (auto& part : parts) {
+        for (auto& relation : part.m_Relations) {
+            std::vector<int> outer, inner;
+            for (const auto& [ref, is_outer] : relation.ways) {
+                if (const int way_num = way_id_to_num.Find(ref); way_num != IdMap::kNotFound) {
+                    (is_outer ? outer : inner).emplace_back(way_num);
                 }
-            } else if (name == "tag") {
-                auto category = std::string_view{child.attribute("k").as_string()};
-                auto type = std::string_view{child.attribute("v").as_string()};
-                if (category == "building") {
-                    commit(m_Buildings.emplace_back());
+            }
+            auto commit = [&](Multipolygon& mp) {
+                mp = m.AddMultipolygon({outer.data(), outer.size()}, {inner.data(), inner.size()});
+            };
+            switch (relation.kind) {
+                case PendingRelation::Building:
+                    commit(m.m_Buildings.emplace_back());
                     break;
-                } else if (category == "natural" && type == "water") {
-                    commit(m_Waters.emplace_back());
-                    BuildRings(m_Waters.back());
+                case PendingRelation::Water:
+                    m.BuildRings(outer);
+                    m.BuildRings(inner);
+                    commit(m.m_Waters.emplace_back());
                     break;
-                } else if (category == "landuse") {
-                    if (auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid) {
-                        commit(m_Landuses.emplace_back());
-                        m_Landuses.back().type = landuse_type;
-                        BuildRings(m_Landuses.back());
-                    }
+                case PendingRelation::Landuse:
+                    m.BuildRings(outer);
+                    m.BuildRings(inner);
+                    commit(m.m_Landuses.emplace_back());
+                    m.m_Landuses.back().type = relation.landuse_type;
+                    break;
+                case PendingRelation::None:
                     break;
-                }
             }
         }
+        part.m_Relations = {};
     }
 }
 
 /**
- * Adjusts node coordinates to fit within the map bounds and scales them to metric units.
+ * Resolves the node references of the ways of the piece into node indices, keeping only
+ * references to nodes that precede the way in the file.
+ * @param node_id_to_num The indices of all nodes of the file by OSM ID.
+ * @param node_base The index of the first node of the piece.
  */
-void Model::AdjustCoordinates() {
+void Model::Loader::ResolveWays(const IdMap& node_id_to_num, std::size_t node_base) {
+    auto& nodes = m_Part.m_WayNodes;
+    nodes.reserve(m_Refs.size());
+    std::size_t ref = 0;
+    for (std::size_t w = 0; w < m_RefEnds.size(); ++w) {
+        const auto seen = node_base + m_NodesSeen[w];
+        auto& way = m_Part.m_Ways[w];
+        way.begin = static_cast<int>(nodes.size());
+        for (; ref < m_RefEnds[w]; ++ref) {
+            const int node_num = node_id_to_num.Find(m_Refs[ref]);
+            if (node_num != IdMap::kNotFound && static_cast<std::size_t>(node_num) < seen) {
+                nodes.emplace_back(node_num);
+            }
+        }
+        way.end = static_cast<int>(nodes.size());
+    }
+    m_Refs = {};
+}
+
+/**
+ * Resolves the node references of the ways of the piece for a clip region. A reference to a
+ * node that was dropped ends a run of nodes: a road or railway becomes one way per run of at
+ * least two nodes, all with the OSM ID of the way, while other ways, mostly areas, keep the
+ * nodes of all their runs. Ways left without nodes are dropped, and the features follow their
+ * ways: a line feature to every run, an area only while its way has nodes.
+ * @param node_id_to_num The indices of all nodes of the file by OSM ID.
+ * @param node_base The index of the first node of the piece.
+ */
+void Model::Loader::ResolveClippedWays(const IdMap& node_id_to_num, std::size_t node_base) {
+    auto& m = m_Part;
+    auto& nodes = m.m_WayNodes;
+    nodes.reserve(m_Refs.size());
+    std::vector<Model::Way> ways;
+    std::vector<std::int64_t> way_ids;
+    std::vector<int> first_run{0};  // Index of the first new way of each way, plus a final sentinel
+    std::size_t ref = 0;
+    for (std::size_t w = 0; w < m_RefEnds.size(); ++w) {
+        const auto seen = node_base + m_NodesSeen[w];
+        const std::size_t min_nodes = m_IsLine[w] ? 2 : 1;
+        auto begin = nodes.size();
+        const auto end_run = [&] {
+            if (nodes.size() - begin >= min_nodes) {
+                ways.push_back({static_cast<int>(begin), static_cast<int>(nodes.size())});
+                way_ids.push_back(m.m_WayIds[w]);
+            } else {
+                nodes.resize(begin);
+            }
+            begin = nodes.size();
+        };
+        for (; ref < m_RefEnds[w]; ++ref) {
+            const int node_num = node_id_to_num.Find(m_Refs[ref]);
+            if (node_num != IdMap::kNotFound && static_cast<std::size_t>(node_num) < seen) {
+                nodes.emplace_back(node_num);
+            } else if (m_IsLine[w]) {
+                end_run();
+            }
+        }
+        end_run();
+        first_run.push_back(static_cast<int>(ways.size()));
+    }
+    m_Refs = {};
+    m.m_Ways = std::move(ways);
+    m.m_WayIds = std::move(way_ids);
+
+    const auto split_lines = [&](auto& lines) {
+        std::remove_reference_t<decltype(lines)> kept;
+        for (const auto& line : lines) {
+            for (int run = first_run[line.way]; run < first_run[line.way + 1]; ++run) {
+                kept.push_back(line);
+                kept.back().way = run;
+            }
+        }
+        lines = std::move(kept);
+    };
+    split_lines(m.m_Roads);
+    split_lines(m.m_Railways);
+
+    // Every area of the piece has a single outer way, its first ring way
+    std::vector<int> ring_ways;
+    std::swap(ring_ways, m.m_RingWays);
+    const auto keep_areas = [&](auto& areas) {
+        std::remove_reference_t<decltype(areas)> kept;
+        for (auto& area : areas) {
+            const int way = ring_ways[area.outer];
+            if (first_run[way] == first_run[way + 1]) continue;  // Entirely outside
+            static_cast<Multipolygon&>(area) = m.AddMultipolygon({&first_run[way], 1}, {});
+            kept.push_back(area);
+        }
+        areas = std::move(kept);
+    };
+    keep_areas(m.m_Buildings);
+    keep_areas(m.m_Leisures);
+    keep_areas(m.m_Waters);
+    keep_areas(m.m_Landuses);
+}
+
+/**
+ * Loads and parses OSM XML data into the model. Large documents are split into pieces
+ * that are parsed on several threads; the result is the same as a single-threaded pass.
+ * Compressed documents are parsed in one pass while a second thread decompresses them.
+ * PBF files are split at blob boundaries and decoded on several threads in the same way.
+ * @param xml A read-only view of the OSM XML or PBF data.
+ * @param threads The number of threads to use; 0 uses one per hardware thread.
+ * @param profile What to keep of the data.
+ * @param clip The region of the data to keep, or nullptr for all of it.
+ */
+void Model::LoadData(Span<const std::byte> xml, std::size_t threads, Profile profile, const ClipRegion* clip) {
+    if (OsmPbfReader::Matches(xml)) {
+        LoadPbf(xml, threads, profile, clip);
+        return;
+    }
+    if (Decompressor::Detect(xml) != Decompressor::Format::None) {
+        std::vector<Loader> parts(1, Loader{profile, clip});
+        OsmXmlReader reader{parts.front()};
+        Decompressor::Stream(xml, [&](const char* data, std::size_t size) { reader.Feed(data, size); });
+        reader.Finish();
+        Loader::Assemble(parts, *this, nullptr);
+        return;
+    }
+
+    const std::string_view text{reinterpret_cast<const char*>(xml.data()), xml.size()};
+    if (threads == 0) {
+        threads = ThreadPool::HardwareThreads();
+    }
+
+    const auto pieces = threads > 1 ? OsmXmlReader::Split(text, threads) : std::vector<std::string_view>{text};
+    std::vector<Loader> parts(pieces.size(), Loader{profile, clip});
+    if (pieces.size() == 1) {
+        OsmXmlReader::Parse(text, parts.front());
+        Loader::Assemble(parts, *this, nullptr);
+        return;
+    }
+
+    ThreadPool pool{std::min(threads, pieces.size())};
+    try {
+        pool.ParallelFor(pieces.size(), [&](std::size_t i) {
+            OsmXmlReader::ParsePiece(pieces[i], i == 0, i + 1 == pieces.size(), parts[i]);
+        });
+    } catch (const std::exception&) {
+        // A piece was cut inside a comment or is malformed: redo the whole file in one pass,
+        // which either succeeds or reports the error as the single-threaded loader would
+        parts.assign(1, Loader{profile, clip});
+        OsmXmlReader::Parse(text, parts.front());
+        Loader::Assemble(parts, *this, nullptr);
+        return;
+    }
+    Loader::Assemble(parts, *this, &pool);
+}
+
+/**
+ * Loads OSM PBF data into the model. The blobs of the file are independent, so pieces of
+ * whole blobs are decoded on several threads; the result is the same as a single pass.
+ * @param pbf A read-only view of the PBF data.
+ * @param threads The number of threads to use; 0 uses one per hardware thread.
+ * @param profile What to keep of the data.
+ * @param clip The region of the data to keep, or nullptr for all of it.
+ */
+void Model::LoadPbf(Span<const std::byte> pbf, std::size_t threads, Profile profile, const ClipRegion* clip) {
+    if (threads == 0) {
+        threads = ThreadPool::HardwareThreads();
+    }
+
+    const auto pieces = OsmPbfReader::Split(pbf, threads);
+    std::vector<Loader> parts(std::max<std::size_t>(pieces.size(), 1), Loader{profile, clip});
+    if (pieces.size() <= 1) {
+        OsmPbfReader::Parse(pbf, parts.front());
+        Loader::Assemble(parts, *this, nullptr);
+        return;
+    }
+
+    ThreadPool pool{std::min(threads, pieces.size())};
+    pool.ParallelFor(pieces.size(), [&](std::size_t i) { OsmPbfReader::Parse(pieces[i], parts[i]); });
+    Loader::Assemble(parts, *this, &pool);
+}
+
+/**
+ * Projects a latitude onto the Mercator y axis.
+ * @param lat The latitude in degrees.
+ * @return The y coordinate in meters.
+ */
+static double LatToY(double lat) {
     constexpr double pi = 3.14159265358979323846264338327950288;
     constexpr double deg_to_rad = 2. * pi / 360.;
     constexpr double earth_radius = 6378137.;
+    return std::log(std::tan(lat * deg_to_rad / 2 + pi / 4)) / 2 * earth_radius;
+}
 
-    auto lat2ym = [&](double lat) { return std::log(std::tan(lat * deg_to_rad / 2 + pi / 4)) / 2 * earth_radius; };
-    auto lon2xm = [&](double lon) { return lon * deg_to_rad / 2 * earth_radius; };
+/**
+ * Projects a longitude onto the Mercator x axis.
+ * @param lon The longitude in degrees.
+ * @return The x coordinate in meters.
+ */
+static double LonToX(double lon) {
+    constexpr double pi = 3.14159265358979323846264338327950288;
+    constexpr double deg_to_rad = 2. * pi / 360.;
+    constexpr double earth_radius = 6378137.;
+    return lon * deg_to_rad / 2 * earth_radius;
+}
 
-    const auto dx = lon2xm(m_MaxLon) - lon2xm(m_MinLon);
-    const auto dy = lat2ym(m_MaxLat) - lat2ym(m_MinLat);
-    const auto min_y = lat2ym(m_MinLat);
-    const auto min_x = lon2xm(m_MinLon);
+/**
+ * Adjusts node coordinates to fit within the map bounds and scales them to metric units.
+ */
+void Model::AdjustCoordinates() {
+    const auto dx = LonToX(m_MaxLon) - LonToX(m_MinLon);
+    const auto dy = LatToY(m_MaxLat) - LatToY(m_MinLat);
+    const auto min_y = LatToY(m_MinLat);
+    const auto min_x = LonToX(m_MinLon);
     m_MetricScale = std::min(dx, dy);
 
     for (auto& node : m_Nodes) {
-        node.x = (lon2xm(node.x) - min_x) / m_MetricScale;
-        node.y = (lat2ym(node.y) - min_y) / m_MetricScale;
+        node.x = (LonToX(node.x) - min_x) / m_MetricScale;
+        node.y = (LatToY(node.y) - min_y) / m_MetricScale;
     }
 }
 
 /**
- * Recursively builds a ring from open ways.
- * @param open_ways The list of open ways to process.
- * @param ways The array of all ways in the model.
- * @param used A vector indicating which ways have been used.
- * @param nodes The current list of nodes in the ring.
- * @return True if a complete ring is formed, otherwise false.
+ * Checks whether the model holds no more than the routing profile keeps: no railways or areas,
+ * and no nodes that no way refers to.
+ * @return True if the model holds only roads and their nodes.
  */
-static bool TrackRec(const std::vector<int>& open_ways, const Model::Way* ways, std::vector<bool>& used, std::vector<int>& nodes) {
-    if (nodes.empty()) {
-        for (int i = 0; i < open_ways.size(); ++i) {
-            if (!used[i]) {
-                used[i] = true;
-                const auto& way_nodes = ways[open_ways[i]].nodes;
-                nodes = way_nodes;
-                if (TrackRec(open_ways, ways, used, nodes)) {
-                    return true;
-                }
-                nodes.clear();
-                used[i] = false;
-            }
-        }
+bool Model::HoldsRoadsOnly() const {
+    if (!m_Railways.empty() || !m_Buildings.empty() || !m_Leisures.empty() || !m_Waters.empty() ||
+        !m_Landuses.empty()) {
         return false;
-    } else {
-        const auto head = nodes.front();
-        const auto tail = nodes.back();
-        if (head == tail && nodes.size() > 1) {
-            return true;
-        }
-        for (int i = 0; i < open_ways.size(); ++i) {
-            if (!used[i]) {
-                const auto& way_nodes = ways[open_ways[i]].nodes;
-                const auto way_head = way_nodes.front();
-                const auto way_tail = way_nodes.back();
-                if (way_head == tail || way_tail == tail) {
-                    used[i] = true;
-                    const auto len = nodes.size();
-                    if (way_head == tail) {
-                        nodes.insert(nodes.end(), way_nodes.begin(), way_nodes.end());
-                    } else {
-                        nodes.insert(nodes.end(), way_nodes.rbegin(), way_nodes.rend());
-                    }
-                    if (TrackRec(open_ways, ways, used, nodes)) {
-                        return true;
-                    }
-                    nodes.resize(len);
-                    used[i] = false;
-                }
-            }
+    }
+    std::vector<bool> referenced(m_Nodes.size(), false);
+    for (const auto& way : m_Ways) {
+        for (const int node : WayNodes(way)) {
+            referenced[node] = true;
         }
-        return false;
     }
+    return std::find(referenced.begin(), referenced.end(), false) == referenced.end();
 }
 
 /**
- * Builds a ring from open ways.
- * @param open_ways The list of open ways to process.
- * @param ways The array of all ways in the model.
- * @return A vector of node IDs forming the ring.
+ * Drops the nodes that no way refers to and renumbers the others, keeping their order, so
+ * that the node indices stay dense.
  */
-static std::vector<int> Track(std::vector<int>& open_ways, const Model::Way* ways) {
-    assert(!open_ways.empty());
-    std::vector<bool> used(open_ways.size(), false);
-    std::vector<int> nodes;
-    if (TrackRec(open_ways, ways, used, nodes)) {
-        for (int i = 0; i < open_ways.size(); ++i) {
-            if (used[i]) {
-                open_ways[i] = -1;
+void Model::DropUnreferencedNodes() {
+    std::vector<int> new_index(m_Nodes.size(), -1);
+    for (const int node : m_WayNodes) {
+        new_index[node] = 0;
+    }
+    int count = 0;
+    for (std::size_t i = 0; i < m_Nodes.size(); ++i) {
+        if (new_index[i] < 0) continue;
+        new_index[i] = count;
+        m_Nodes[count] = m_Nodes[i];
+        m_Nodes[count].index = count;
+        m_NodeIds[count] = m_NodeIds[i];
+        ++count;
+    }
+    m_Nodes.resize(count);
+    m_Nodes.shrink_to_fit();
+    m_NodeIds.resize(count);
+    m_NodeIds.shrink_to_fit();
+    for (int& node : m_WayNodes) {
+        node = new_index[node];
+    }
+}
+
+/**
+ * Appends a multipolygon with the given ring ways to the buffer of ring ways.
+ * @param outer The IDs of the ways forming the outer rings.
+ * @param inner The IDs of the ways forming the inner rings.
+ * @return The multipolygon, referring to its ways in the buffer.
+ */
+Model::Multipolygon Model::AddMultipolygon(Span<const int> outer, Span<const int> inner) {
+    Multipolygon mp;
+    mp.outer = static_cast<int>(m_RingWays.size());
+    m_RingWays.insert(m_RingWays.end(), outer.begin(), outer.end());
+    mp.inner = static_cast<int>(m_RingWays.size());
+    m_RingWays.insert(m_RingWays.end(), inner.begin(), inner.end());
+    mp.end = static_cast<int>(m_RingWays.size());
+    return mp;
+}
+
+/**
+ * Adds the areas that the tags of a way describe, each with the way as its only outer ring.
+ * @param way_num The ID of the way.
+ * @param tags The tags of the way.
+ */
+void Model::AddWayAreas(int way_num, const std::vector<OsmTag>& tags) {
+    const auto add_area = [&](auto& areas) -> auto& {
+        auto& area = areas.emplace_back();
+        static_cast<Multipolygon&>(area) = AddMultipolygon({&way_num, 1}, {});
+        return area;
+    };
+    for (const auto& tag : tags) {
+        const auto category = tag.key;
+        const auto type = tag.value;
+        if (category == "building") {
+            add_area(m_Buildings);
+        } else if (category == "leisure" ||
+                   (category == "natural" && (type == "wood" || type == "tree_row" || type == "scrub" || type == "grassland")) ||
+                   (category == "landcover" && type == "grass")) {
+            add_area(m_Leisures);
+        } else if (category == "natural" && type == "water") {
+            add_area(m_Waters);
+        } else if (category == "landuse") {
+            if (auto landuse_type = String2LanduseType(type); landuse_type != Landuse::Invalid) {
+                add_area(m_Landuses).type = landuse_type;
             }
         }
     }
-    return nodes;
 }
 
 /**
- * Builds outer and inner rings for a multipolygon.
- * @param mp The multipolygon to process.
+ * Joins the open ways of a list into closed rings, stored as new ways. The ends of the open
+ * ways are indexed by node, so a ring grows in constant time per way: starting from the first
+ * unused way, it takes at its end the first unused way that starts or ends there, until it
+ * returns to its first node. Ways that cannot be closed into a ring are dropped.
+ * @param way_nums The IDs of the ways; replaced by the IDs of the closed ways and rings.
  */
-void Model::BuildRings(Multipolygon& mp) {
-    auto is_closed = [](const Model::Way& way) {
-        return way.nodes.size() > 1 && way.nodes.front() == way.nodes.back();
+void Model::BuildRings(std::vector<int>& way_nums) {
+    auto is_closed = [this](const Model::Way& way) {
+        const auto nodes = WayNodes(way);
+        return nodes.size() > 1 && nodes.front() == nodes.back();
     };
 
-    auto process = [&](std::vector<int>& ways_nums) {
-        auto ways = m_Ways.data();
-        std::vector<int> closed, open;
+    std::vector<int> closed, open;
+    for (auto& way_num : way_nums) {
+        if (WayNodes(m_Ways[way_num]).empty()) continue;  // Has no nodes to join
+        (is_closed(m_Ways[way_num]) ? closed : open).emplace_back(way_num);
+    }
+
+    // Index the ends of the open ways: end 2 * i is the first node of open[i] and end 2 * i + 1
+    // the last one. The ends at a node form a list in the order of the ways, first end first.
+    IdMap first_end{2 * open.size()};  // Node -> first end at the node, or kNotFound
+    std::vector<int> next_end(2 * open.size());
+    for (int end = static_cast<int>(next_end.size()) - 1; end >= 0; --end) {
+        const auto nodes = WayNodes(m_Ways[open[end / 2]]);
+        const int node = end % 2 == 0 ? nodes.front() : nodes.back();
+        next_end[end] = first_end.Find(node);
+        first_end.Insert(node, end);
+    }
+
+    std::vector<bool> used(open.size(), false);
+    std::vector<int> ring;
+    for (std::size_t start = 0; start < open.size(); ++start) {
+        if (used[start]) continue;
+        used[start] = true;
+        const auto first = WayNodes(m_Ways[open[start]]);
+        ring.assign(first.begin(), first.end());
+
+        while (ring.size() < 2 || ring.front() != ring.back()) {
+            // Take the first unused way at the end of the ring, skipping used ends for good
+            int end = first_end.Find(ring.back());
+            while (end != IdMap::kNotFound && used[end / 2]) {
+                end = next_end[end];
+            }
+            first_end.Insert(ring.back(), end);
+            if (end == IdMap::kNotFound) break;  // Cannot be closed
 
-        for (auto& way_num : ways_nums) {
-            (is_closed(ways[way_num]) ? closed : open).emplace_back(way_num);
+            used[end / 2] = true;
+            const auto nodes = WayNodes(m_Ways[open[end / 2]]);
+            if (end % 2 == 0) {
+                ring.insert(ring.end(), nodes.begin(), nodes.end());
+            } else {
+                ring.insert(ring.end(), std::make_reverse_iterator(nodes.end()), std::make_reverse_iterator(nodes.begin()));
+            }
         }
+        if (ring.size() < 2 || ring.front() != ring.back()) continue;
 
-        while (!open.empty()) {
-            auto new_nodes = Track(open, ways);
-            if (new_nodes.empty()) {
-                break;
+        closed.emplace_back(static_cast<int>(m_Ways.size()));
+        Model::Way new_way;
+        new_way.begin = static_cast<int>(m_WayNodes.size());
+        m_WayNodes.insert(m_WayNodes.end(), ring.begin(), ring.end());
+        new_way.end = static_cast<int>(m_WayNodes.size());
+        m_Ways.emplace_back(new_way);
+        m_WayIds.push_back(0);  // Assembled ring, not an OSM way
+    }
+    std::swap(way_nums, closed);
+}
+
+/**
+ * Rewrites the buffer of way node lists in way order, without the lists that no way refers
+ * to any more since their ways were changed.
+ */
+void Model::CompactWayNodes() {
+    std::size_t size = 0;
+    for (const auto& way : m_Ways) {
+        size += way.end - way.begin;
+    }
+    std::vector<int> nodes;
+    nodes.reserve(size);
+    for (auto& way : m_Ways) {
+        const auto begin = static_cast<int>(nodes.size());
+        nodes.insert(nodes.end(), m_WayNodes.begin() + way.begin, m_WayNodes.begin() + way.end);
+        way = {begin, static_cast<int>(nodes.size())};
+    }
+    m_WayNodes = std::move(nodes);
+}
+
+/**
+ * The ChangeApplier class applies the elements of an osmChange document to a loaded model,
+ * in document order. Created and modified nodes are projected with the bounds of the model and
+ * stored in place or appended; deleted nodes lose their OSM ID. A created or modified way gets
+ * its node list appended to the way node buffer and keeps its index, so the features referring
+ * to it follow; a deleted way is left without nodes and without OSM ID. Under the profile and
+ * clip region of the model, ways are kept and split as they would be on load; nodes that move
+ * out of the region stay with their ways.
+ *
+ * What a change needs the whole file for is left to the next full load: the areas of modified
+ * ways and of relations, and rings assembled from several ways of a multipolygon relation.
+ */
+class Model::ChangeApplier : public OsmHandler {
+public:
+    ChangeApplier(Model& model, Profile profile, const ClipRegion* clip)
+        : m_Model(model), m_Profile(profile), m_Clip(clip),
+          m_MinX(LonToX(model.m_MinLon)), m_MinY(LatToY(model.m_MinLat)),
+          m_NodeNums(model.m_NodeIds.size()), m_FirstSlot(model.m_WayIds.size()),
+          m_NextSlot(model.m_Ways.size(), IdMap::kNotFound) {
+        const auto& m = m_Model;
+        for (std::size_t i = 0; i < m.m_NodeIds.size(); ++i) {
+            if (m.m_NodeIds[i] != 0) m_NodeNums.Insert(m.m_NodeIds[i], static_cast<int>(i));
+        }
+        // The ways split from one OSM way form a list, in order, starting at its first way
+        for (int slot = static_cast<int>(m.m_WayIds.size()) - 1; slot >= 0; --slot) {
+            const auto id = m.m_WayIds[slot];
+            if (id == 0) continue;  // Deleted, or assembled from relation rings
+            m_NextSlot[slot] = m_FirstSlot.Find(id);
+            m_FirstSlot.Insert(id, slot);
+        }
+    }
+
+    void Bounds(double, double, double, double) override {}
+
+    // Whether the model holds the node, or any way split from the OSM way, before the change.
+    bool HoldsNode(OsmId id) const noexcept { return m_NodeNums.Find(id) != IdMap::kNotFound; }
+    bool HoldsWay(OsmId id) const noexcept { return m_FirstSlot.Find(id) != IdMap::kNotFound; }
+
+    /**
+     * Starts a section of the document.
+     */
+    void Section(OsmAction action) override { m_Action = action; }
+
+    /**
+     * Creates, moves or deletes a node. Created nodes outside the clip region are skipped.
+     */
+    void Node(OsmId id, double lat, double lon) override {
+        auto& m = m_Model;
+        const int num = m_NodeNums.Find(id);
+        if (m_Action == OsmAction::Delete) {
+            if (num == IdMap::kNotFound) return;
+            m.m_NodeIds[num] = 0;
+            m_NodeNums.Insert(id, IdMap::kNotFound);
+            ++m_Changes;
+            return;
+        }
+        if (num == IdMap::kNotFound && m_Clip && !m_Clip->Contains(lat, lon)) return;
+
+        Model::Node node;
+        node.x = (LonToX(lon) - m_MinX) / m.m_MetricScale;
+        node.y = (LatToY(lat) - m_MinY) / m.m_MetricScale;
+        if (num != IdMap::kNotFound) {
+            node.index = num;
+            m.m_Nodes[num] = node;
+        } else {
+            node.index = static_cast<int>(m.m_Nodes.size());
+            m.m_Nodes.push_back(node);
+            m.m_NodeIds.push_back(id);
+            m_NodeNums.Insert(id, node.index);
+        }
+        ++m_Changes;
+    }
+
+    /**
+     * Creates, modifies or deletes a way. References to nodes the model does not hold are
+     * skipped, or end a run of nodes with a clip region, as on load.
+     */
+    void Way(OsmId id, const std::vector<OsmId>& refs, const std::vector<OsmTag>& tags) override {
+        auto& m = m_Model;
+        auto lines = ClassifyLines(tags);
+        if (m_Profile == Profile::Routing) {
+            lines.railway = false;  // Roads only
+        }
+        const bool keep = m_Action != OsmAction::Delete && (m_Profile == Profile::Full || lines.road != Road::Invalid);
+        const int first = m_FirstSlot.Find(id);
+        if (!keep && first == IdMap::kNotFound) return;
+        ++m_Changes;
+
+        // Append the runs of nodes of the way to the buffer; without a clip region there is one
+        m_Runs.clear();
+        if (keep) {
+            const bool is_line = lines.road != Road::Invalid || lines.railway;
+            const std::size_t min_nodes = !m_Clip ? 0 : is_line ? 2 : 1;
+            auto& nodes = m.m_WayNodes;
+            auto begin = nodes.size();
+            const auto end_run = [&] {
+                if (nodes.size() - begin >= min_nodes) {
+                    m_Runs.push_back({static_cast<int>(begin), static_cast<int>(nodes.size())});
+                } else {
+                    nodes.resize(begin);
+                }
+                begin = nodes.size();
+            };
+            for (const auto ref : refs) {
+                if (const int num = m_NodeNums.Find(ref); num != IdMap::kNotFound) {
+                    nodes.push_back(num);
+                } else if (m_Clip && is_line) {
+                    end_run();
+                }
+            }
+            end_run();
+        }
+
+        // Give the runs the ways of the OSM way, in order, adding ways as needed
+        int slot = first, previous = IdMap::kNotFound;
+        for (const auto& run : m_Runs) {
+            if (slot == IdMap::kNotFound) {
+                slot = static_cast<int>(m.m_Ways.size());
+                m.m_Ways.emplace_back();
+                m.m_WayIds.push_back(id);
+                m_NextSlot.push_back(IdMap::kNotFound);
+                if (previous == IdMap::kNotFound) {
+                    m_FirstSlot.Insert(id, slot);
+                } else {
+                    m_NextSlot[previous] = slot;
+                }
+            }
+            Release(slot);
+            m.m_Ways[slot] = run;
+            m_Lines[slot] = lines;
+            previous = slot;
+            slot = m_NextSlot[slot];
+        }
+        for (; slot != IdMap::kNotFound; slot = m_NextSlot[slot]) {
+            Release(slot);  // Left over from a longer split
+            m_Lines[slot] = {};
+        }
+
+        if (m_Runs.empty()) {
+            // Deleted, or no longer kept: the ways lose their OSM ID for good
+            for (slot = first; slot != IdMap::kNotFound; slot = m_NextSlot[slot]) {
+                m.m_WayIds[slot] = 0;
             }
-            open.erase(std::remove_if(open.begin(), open.end(), [](auto v) { return v < 0; }), open.end());
-            closed.emplace_back(static_cast<int>(m_Ways.size()));
-            Model::Way new_way;
-            new_way.nodes = std::move(new_nodes);
-            m_Ways.emplace_back(new_way);
+            m_FirstSlot.Insert(id, IdMap::kNotFound);
+        } else if (first == IdMap::kNotFound && m_Profile == Profile::Full) {
+            m.AddWayAreas(m_FirstSlot.Find(id), tags);  // New to the model
+        }
+    }
+
+    void Relation(OsmId, const std::vector<OsmMember>&, const std::vector<OsmTag>&) override {}
+
+    /**
+     * Brings the features in line with the changed ways and tidies the buffers.
+     * @return The number of elements that changed the model.
+     */
+    std::size_t Finish() {
+        auto& m = m_Model;
+        if (!m_Lines.empty()) {
+            // Replace the roads and railways of the changed ways, keeping the roads sorted by type
+            const auto changed = [&](const auto& line) { return m_Lines.count(line.way) > 0; };
+            m.m_Roads.erase(std::remove_if(m.m_Roads.begin(), m.m_Roads.end(), changed), m.m_Roads.end());
+            m.m_Railways.erase(std::remove_if(m.m_Railways.begin(), m.m_Railways.end(), changed), m.m_Railways.end());
+            for (const auto& [way, lines] : m_Lines) {
+                if (lines.road != Road::Invalid) m.m_Roads.push_back({way, lines.road});
+                if (lines.railway) m.m_Railways.push_back({way});
+            }
+            std::stable_sort(m.m_Roads.begin(), m.m_Roads.end(), [](const auto& first, const auto& second) {
+                return static_cast<int>(first.type) < static_cast<int>(second.type);
+            });
+        }
+
+        if (m_Emptied) {
+            // Drop the areas whose ways were all left without nodes
+            const auto empty = [&](const Multipolygon& mp) {
+                return mp.outer != mp.end && std::all_of(m.m_RingWays.begin() + mp.outer, m.m_RingWays.begin() + mp.end,
+                                   [&](int way) { return m.m_Ways[way].begin == m.m_Ways[way].end; });
+            };
+            const auto drop_empty = [&](auto& areas) { areas.erase(std::remove_if(areas.begin(), areas.end(), empty), areas.end()); };
+            drop_empty(m.m_Buildings);
+            drop_empty(m.m_Leisures);
+            drop_empty(m.m_Waters);
+            drop_empty(m.m_Landuses);
+        }
+
+        if (m_Stale > 0 && (m_Profile == Profile::Routing || 2 * m_Stale > m.m_WayNodes.size())) {
+            m.CompactWayNodes();
+        }
+        if (m_Profile == Profile::Routing) {
+            m.DropUnreferencedNodes();  // Only the nodes of the roads are needed
+        }
+        return m_Changes;
+    }
+
+private:
+    // Empties a way, counting its node list as stale.
+    void Release(int slot) {
+        auto& way = m_Model.m_Ways[slot];
+        m_Stale += way.end - way.begin;
+        m_Emptied = m_Emptied || way.end > way.begin;
+        way = {};
+    }
+
+    Model& m_Model;
+    Profile m_Profile;               // What the model keeps of the elements
+    const ClipRegion* m_Clip;        // Region of the nodes the model keeps, or nullptr for all
+    double m_MinX, m_MinY;           // Projected lower bounds of the map
+    OsmAction m_Action = OsmAction::Modify;  // Change of the current section
+    IdMap m_NodeNums;                // OSM node ID -> index in m_Nodes
+    IdMap m_FirstSlot;               // OSM way ID -> index of its first way in m_Ways
+    std::vector<int> m_NextSlot;     // Next way split from the same OSM way, per way
+    std::vector<Model::Way> m_Runs;  // Node lists of the current way
+    std::map<int, LineFeatures> m_Lines;  // Road and railway of each changed way
+    std::size_t m_Stale = 0;         // Entries of the way node buffer no way refers to
+    bool m_Emptied = false;          // Whether a way lost its nodes
+    std::size_t m_Changes = 0;       // Elements that changed the model
+};
+
+/**
+ * Applies an osmChange document to the model. The document is parsed twice: once to check it,
+ * so that a malformed document leaves the model as it was, then to apply it.
+ *
+ * Under the routing profile, the model lacks the nodes that only other features referred to on
+ * load, and a change lists only the nodes it changes. A road that refers to a node neither holds,
+ * e.g. a road under construction opened to traffic, would lose that node, so such a change is
+ * rejected. With a clip region, the roads the model already holds may refer to nodes outside of
+ * it, so only new roads are checked.
+ * @param osc The osmChange document, plain or compressed with gzip or bzip2.
+ * @param profile What the model keeps of OSM data, as when it was loaded.
+ * @param clip The region the model was clipped to when loaded, or nullptr.
+ * @return The number of elements that changed the model.
+ */
+std::size_t Model::ApplyChange(Span<const std::byte> osc, Profile profile, const ClipRegion* clip) {
+    const auto parse = [&](OsmHandler& handler) {
+        if (Decompressor::Detect(osc) != Decompressor::Format::None) {
+            OsmXmlReader reader{handler};
+            Decompressor::Stream(osc, [&](const char* data, std::size_t size) { reader.Feed(data, size); });
+            reader.Finish();
+        } else {
+            OsmXmlReader::Parse({reinterpret_cast<const char*>(osc.data()), osc.size()}, handler);
         }
-        std::swap(ways_nums, closed);
     };
 
-    process(mp.outer);
-    process(mp.inner);
-}
\ No newline at end of file
+    ChangeApplier applier{*this, profile, clip};
+
+    // Elements outside a section come from a plain OSM file; under the routing profile, kept roads
+    // must refer to nodes the model holds or the change lists before them
+    struct Checker : OsmHandler {
+        Checker(const ChangeApplier& applier, bool check_refs, bool clipped)
+            : applier(applier), check_refs(check_refs), clipped(clipped) {}
+        void Bounds(double, double, double, double) override {}
+        void Section(OsmAction section) override {
+            in_section = true;
+            action = section;
+        }
+        void Node(OsmId id, double, double) override {
+            plain = plain || !in_section;
+            if (check_refs) listed.Insert(id, 0);
+        }
+        void Way(OsmId id, const std::vector<OsmId>& refs, const std::vector<OsmTag>& tags) override {
+            plain = plain || !in_section;
+            if (!check_refs || missing || action == OsmAction::Delete || ClassifyLines(tags).road == Road::Invalid ||
+                (clipped && applier.HoldsWay(id))) {
+                return;
+            }
+            missing = std::any_of(refs.begin(), refs.end(), [&](OsmId ref) {
+                return !applier.HoldsNode(ref) && listed.Find(ref) == IdMap::kNotFound;
+            });
+        }
+        void Relation(OsmId, const std::vector<OsmMember>&, const std::vector<OsmTag>&) override { plain = plain || !in_section; }
+        const ChangeApplier& applier;
+        const bool check_refs;
+        const bool clipped;
+        IdMap listed;  // Nodes of the change so far
+        OsmAction action = OsmAction::Modify;
+        bool in_section = false;
+        bool plain = false;
+        bool missing = false;
+    } checker{applier, profile == Profile::Routing, clip != nullptr};
+    parse(checker);
+    if (checker.plain) {
+        throw std::logic_error("The change file is not an osmChange document.");
+    }
+    if (checker.missing) {
+        throw std::logic_error("The change adds roads on nodes the routing-only map does not hold; reload the map.");
+    }
+
+    parse(applier);
+    return applier.Finish();
+}
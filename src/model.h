@@ -1,9 +1,15 @@
 #pragma once
 
+#include <cmath>
 #include <vector>
 #include <unordered_map>
 #include <string>
 #include <cstddef>
+#include <cstdint>
+#include "span.h"
+
+class ClipRegion;
+struct OsmTag;
 
 /**
  * Represents the Model class, which holds map data (nodes, ways, roads, etc.)
@@ -11,15 +17,27 @@
  */
 class Model {
 public:
-    // Represents a node (point) on the map with x and y coordinates.
+    // Represents a node (point) on the map with x and y coordinates. The nodes of the map are
+    // stored once, in Nodes(); routing refers to them by index and keeps its state elsewhere.
     struct Node {
         double x = 0.0;  // X-coordinate (longitude)
         double y = 0.0;  // Y-coordinate (latitude)
+        int index = -1;  // Position in Nodes(), or -1 for points that are not map nodes
+
+        // Returns the position of the node in Nodes().
+        int Index() const noexcept { return index; }
+
+        // Calculates the Euclidean distance to another node.
+        float distance(const Node& other) const {
+            return std::sqrt(std::pow((x - other.x), 2) + std::pow((y - other.y), 2));
+        }
     };
 
-    // Represents a way, which is an ordered list of node IDs.
+    // Represents a way, which is an ordered list of node IDs. The lists of all ways are stored
+    // back to back in one buffer; WayNodes() returns the list of a way.
     struct Way {
-        std::vector<int> nodes;  // List of node IDs forming the way
+        int begin = 0;  // Start of the node IDs of the way in the buffer
+        int end = 0;    // End of the node IDs of the way in the buffer
     };
 
     // Represents a road, which is associated with a way and has a type.
@@ -45,10 +63,13 @@ public:
         int way;  // ID of the associated way
     };
 
-    // Represents a multipolygon, which consists of outer and inner rings.
+    // Represents a multipolygon, which consists of outer and inner rings. The IDs of the ways
+    // forming the rings are stored in one buffer shared by all multipolygons, outer rings first;
+    // OuterWays() and InnerWays() return them.
     struct Multipolygon {
-        std::vector<int> outer;  // List of node IDs forming the outer ring
-        std::vector<int> inner;  // List of node IDs forming the inner ring
+        int outer = 0;  // Start of the outer ring ways in the buffer
+        int inner = 0;  // Start of the inner ring ways in the buffer
+        int end = 0;    // End of the ring ways in the buffer
     };
 
     // Represents a building, which is a type of multipolygon.
@@ -75,8 +96,35 @@ public:
         Type type;  // Type of the land use area
     };
 
-    // Constructor: Initializes the Model with OSM XML data.
-    Model(const std::vector<std::byte>& xml);
+    // Selects what is kept when loading OSM data.
+    enum class Profile {
+        Full,    // Every feature of the map, for rendering and routing
+        Routing  // Only the roads and their nodes, for headless routing
+    };
+
+    // Constructor: Initializes the Model with OSM XML data, parsed in place from a read-only view
+    // on the given number of threads (0: one per hardware thread), with gzip or bzip2 compressed
+    // OSM XML data, streamed through the parser, with OSM PBF data, decoded on the given number
+    // of threads, or with a compiled map snapshot. The profile and the clip region, outside of
+    // which nodes are dropped, apply to OSM data; a snapshot holds what was kept when it was compiled,
+    // so it cannot be clipped, and the routing profile only accepts a snapshot compiled with it.
+    // Throws std::invalid_argument if the routing profile keeps no road of OSM data.
+    Model(Span<const std::byte> xml, std::size_t threads = 0, Profile profile = Profile::Full,
+          const ClipRegion* clip = nullptr);
+
+    // Constructor: Initializes the Model with OSM XML data held in a buffer.
+    Model(const std::vector<std::byte>& xml) : Model(Span<const std::byte>{xml.data(), xml.size()}) {}
+
+    // Applies an osmChange document, plain or compressed with gzip or bzip2, to the model. Nodes
+    // and ways are created, modified and deleted in place; a changed way gets a new node list at
+    // the end of the way node buffer, which is compacted once half of it is stale. Roads and
+    // railways follow the tags of changed ways, and new ways get their areas. The profile and the
+    // clip region should be those the model was loaded with. Returns the number of elements that
+    // changed the model. Throws std::logic_error, leaving the model unchanged, if the document is
+    // malformed or not an osmChange document, or under the routing profile, if it makes a road of
+    // nodes the model dropped on load. RouteModel::ApplyChange() also updates the graph.
+    std::size_t ApplyChange(Span<const std::byte> osc, Profile profile = Profile::Full,
+                            const ClipRegion* clip = nullptr);
 
     // Returns the metric scale factor for the map.
     auto MetricScale() const noexcept { return m_MetricScale; }
@@ -91,25 +139,77 @@ public:
     auto& Landuses() const noexcept { return m_Landuses; }
     auto& Railways() const noexcept { return m_Railways; }
 
+    // Returns the node IDs forming a way.
+    Span<const int> WayNodes(const Way& way) const noexcept {
+        return {m_WayNodes.data() + way.begin, m_WayNodes.data() + way.end};
+    }
+
+    // Returns the IDs of the ways forming the outer and the inner rings of a multipolygon.
+    Span<const int> OuterWays(const Multipolygon& mp) const noexcept {
+        return {m_RingWays.data() + mp.outer, m_RingWays.data() + mp.inner};
+    }
+    Span<const int> InnerWays(const Multipolygon& mp) const noexcept {
+        return {m_RingWays.data() + mp.inner, m_RingWays.data() + mp.end};
+    }
+
+    // Original OSM IDs, parallel to Nodes() and Ways(), for mapping results back to OSM.
+    // Ways assembled from multipolygon rings have no OSM counterpart and get ID 0.
+    auto& NodeIds() const noexcept { return m_NodeIds; }
+    auto& WayIds() const noexcept { return m_WayIds; }
+
 private:
+    // Creates an empty model, used to collect the pieces of a file while loading.
+    Model() = default;
+
+    // Reads and writes compiled snapshots of the model.
+    friend class MapSnapshot;
+
+    // Receives the parsed OSM elements and stores them in the model.
+    class Loader;
+
+    // Receives the elements of an osmChange document and applies them to the model.
+    class ChangeApplier;
+
     // Adjusts the coordinates of nodes to fit within the map bounds.
     void AdjustCoordinates();
 
-    // Builds rings (outer and inner) for multipolygons.
-    void BuildRings(Multipolygon& mp);
+    // Checks whether the model holds only roads and the nodes they refer to.
+    bool HoldsRoadsOnly() const;
+
+    // Drops the nodes that no way refers to and renumbers the others, keeping their order.
+    void DropUnreferencedNodes();
+
+    // Rewrites the buffer of way node lists without the lists that no way refers to any more.
+    void CompactWayNodes();
+
+    // Adds the areas that the tags of a way describe, each with the way as its only outer ring.
+    void AddWayAreas(int way_num, const std::vector<OsmTag>& tags);
+
+    // Appends a multipolygon with the given ring ways to the buffer of ring ways.
+    Multipolygon AddMultipolygon(Span<const int> outer, Span<const int> inner);
+
+    // Joins open ways into closed rings, replacing the list of ways by the closed ones.
+    void BuildRings(std::vector<int>& way_nums);
+
+    // Loads and parses OSM XML or PBF data into the model, on several threads for large inputs.
+    void LoadData(Span<const std::byte> xml, std::size_t threads, Profile profile, const ClipRegion* clip);
 
-    // Loads and parses OSM XML data into the model.
-    void LoadData(const std::vector<std::byte>& xml);
+    // Loads OSM PBF data into the model, decoding its blobs on several threads.
+    void LoadPbf(Span<const std::byte> pbf, std::size_t threads, Profile profile, const ClipRegion* clip);
 
     // Data structures to store map features
     std::vector<Node> m_Nodes;       // List of nodes
     std::vector<Way> m_Ways;         // List of ways
+    std::vector<int> m_WayNodes;     // Node IDs of all ways, way after way
+    std::vector<int> m_RingWays;     // Ring way IDs of all multipolygons, multipolygon after multipolygon
     std::vector<Road> m_Roads;       // List of roads
     std::vector<Railway> m_Railways; // List of railways
     std::vector<Building> m_Buildings; // List of buildings
     std::vector<Leisure> m_Leisures; // List of leisure areas
     std::vector<Water> m_Waters;     // List of water bodies
     std::vector<Landuse> m_Landuses; // List of land use areas
+    std::vector<std::int64_t> m_NodeIds; // OSM ID of each node
+    std::vector<std::int64_t> m_WayIds;  // OSM ID of each way
 
     // Map bounds and scale
     double m_MinLat = 0.0;      // Minimum latitude
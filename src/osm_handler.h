@@ -0,0 +1,58 @@
+#ifndef OSM_HANDLER_H
+#define OSM_HANDLER_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// An OSM element ID. IDs are 64-bit and may be negative in files edited offline.
+using OsmId = std::int64_t;
+
+/**
+ * A key/value tag of an OSM element.
+ */
+struct OsmTag {
+    std::string_view key;
+    std::string_view value;
+};
+
+/**
+ * A member of an OSM relation.
+ */
+struct OsmMember {
+    std::string_view type;  // "node", "way" or "relation"
+    OsmId ref;              // ID of the referenced element
+    std::string_view role;  // Role of the member, e.g. "outer"
+};
+
+// The change that a section of an osmChange document applies to its elements.
+enum class OsmAction { Create, Modify, Delete };
+
+/**
+ * The OsmHandler interface receives the elements of an OSM file, one complete element
+ * at a time and in file order. Readers call it while streaming through their input, so
+ * no document is ever materialised; the string views passed in are only valid for the
+ * duration of the call.
+ */
+class OsmHandler {
+public:
+    virtual ~OsmHandler() = default;
+
+    // Called for the <bounds> element.
+    virtual void Bounds(double min_lat, double min_lon, double max_lat, double max_lon) = 0;
+
+    // Called for every <node> element.
+    virtual void Node(OsmId id, double lat, double lon) = 0;
+
+    // Called for every <way> element with its node references and tags.
+    virtual void Way(OsmId id, const std::vector<OsmId>& refs, const std::vector<OsmTag>& tags) = 0;
+
+    // Called for every <relation> element with its members and tags.
+    virtual void Relation(OsmId id, const std::vector<OsmMember>& members, const std::vector<OsmTag>& tags) = 0;
+
+    // Called at the start of every <create>, <modify> and <delete> section of an osmChange
+    // document, before the elements of the section. Plain OSM files have no sections.
+    virtual void Section(OsmAction /*action*/) {}
+};
+
+#endif
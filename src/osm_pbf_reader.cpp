@@ -0,0 +1,437 @@
+#include "osm_pbf_reader.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+namespace {
+
+constexpr char kCorrupt[] = "PBF data is corrupt or truncated.";
+
+// Limits of the format: blob headers are at most 64 KiB and blobs at most 32 MiB.
+constexpr std::size_t kMaxHeaderSize = 64 * 1024;
+constexpr std::size_t kMaxBlobSize = 32 * 1024 * 1024;
+
+// Rejects malformed PBF data.
+[[noreturn]] void Fail() { throw std::logic_error(kCorrupt); }
+
+// Reads a base-128 varint.
+std::uint64_t ReadVarint(const char*& p, const char* end) {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64 && p != end; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*p++);
+        value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    Fail();
+}
+
+// Decodes a zigzag-encoded signed varint.
+std::int64_t ZigZag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+/**
+ * Reads the fields of a protocol buffer message one after the other. After Next(), the value
+ * of the field must be read with the accessor of its wire type, or skipped.
+ */
+class ProtoReader {
+public:
+    explicit ProtoReader(std::string_view message) : m_P(message.data()), m_End(message.data() + message.size()) {}
+
+    // Moves to the next field; returns false at the end of the message.
+    bool Next() {
+        if (m_P == m_End) return false;
+        const auto key = ReadVarint(m_P, m_End);
+        m_Field = static_cast<std::uint32_t>(key >> 3);
+        m_WireType = static_cast<int>(key & 7);
+        return true;
+    }
+
+    std::uint32_t Field() const noexcept { return m_Field; }
+
+    std::uint64_t Varint() {
+        if (m_WireType != 0) Fail();
+        return ReadVarint(m_P, m_End);
+    }
+
+    std::int64_t SignedVarint() { return ZigZag(Varint()); }
+
+    // Returns a length-delimited value: a string, a nested message or a packed array.
+    std::string_view Bytes() {
+        if (m_WireType != 2) Fail();
+        const auto size = ReadVarint(m_P, m_End);
+        if (size > static_cast<std::uint64_t>(m_End - m_P)) Fail();
+        const std::string_view bytes{m_P, static_cast<std::size_t>(size)};
+        m_P += size;
+        return bytes;
+    }
+
+    void Skip() {
+        switch (m_WireType) {
+            case 0: ReadVarint(m_P, m_End); break;
+            case 1: Advance(8); break;
+            case 2: Bytes(); break;
+            case 5: Advance(4); break;
+            default: Fail();
+        }
+    }
+
+private:
+    void Advance(std::size_t size) {
+        if (size > static_cast<std::size_t>(m_End - m_P)) Fail();
+        m_P += size;
+    }
+
+    const char* m_P;
+    const char* m_End;
+    std::uint32_t m_Field = 0;
+    int m_WireType = 0;
+};
+
+// Reads the values of a packed repeated varint field.
+class PackedVarints {
+public:
+    PackedVarints() = default;
+    explicit PackedVarints(std::string_view data) : m_P(data.data()), m_End(data.data() + data.size()) {}
+
+    bool Empty() const noexcept { return m_P == m_End; }
+    std::uint64_t Next() { return ReadVarint(m_P, m_End); }
+
+private:
+    const char* m_P = nullptr;
+    const char* m_End = nullptr;
+};
+
+// A blob of a PBF file: its type and its raw or zlib-compressed data.
+struct Blob {
+    std::string_view type;
+    std::string_view data;
+};
+
+/**
+ * Reads the blob starting at an offset of a file.
+ * @param pbf The file.
+ * @param offset The offset of the blob; advanced past it.
+ * @return The blob, its data still encoded.
+ */
+Blob ReadBlob(Span<const std::byte> pbf, std::size_t& offset) {
+    const auto begin = reinterpret_cast<const char*>(pbf.data());
+    if (pbf.size() - offset < 4) Fail();
+    const auto size_bytes = reinterpret_cast<const unsigned char*>(begin + offset);
+    const std::size_t header_size = (std::size_t{size_bytes[0]} << 24) | (std::size_t{size_bytes[1]} << 16) |
+                                    (std::size_t{size_bytes[2]} << 8) | std::size_t{size_bytes[3]};
+    offset += 4;
+    if (header_size > kMaxHeaderSize || header_size > pbf.size() - offset) Fail();
+
+    Blob blob;
+    std::uint64_t data_size = 0;
+    bool has_size = false;
+    ProtoReader header{{begin + offset, header_size}};
+    while (header.Next()) {
+        switch (header.Field()) {
+            case 1: blob.type = header.Bytes(); break;
+            case 3: data_size = header.Varint(); has_size = true; break;
+            default: header.Skip();
+        }
+    }
+    offset += header_size;
+    if (!has_size || data_size > kMaxBlobSize || data_size > pbf.size() - offset) Fail();
+    blob.data = {begin + offset, static_cast<std::size_t>(data_size)};
+    offset += data_size;
+    return blob;
+}
+
+/**
+ * Decodes the blocks of a PBF file and reports their elements. The buffers are reused from
+ * block to block.
+ */
+class BlockParser {
+public:
+    explicit BlockParser(OsmHandler& handler) : m_Handler(handler) {}
+
+    // Decodes a blob and parses the block it holds; blobs of unknown types are skipped.
+    void Parse(const Blob& blob) {
+        if (blob.type == "OSMHeader") {
+            ParseHeader(Unpack(blob.data));
+        } else if (blob.type == "OSMData") {
+            ParseBlock(Unpack(blob.data));
+        }
+    }
+
+private:
+    // Returns the contents of a blob message, decompressing them if needed.
+    std::string_view Unpack(std::string_view blob) {
+        std::string_view raw, zlib_data;
+        std::uint64_t raw_size = 0;
+        ProtoReader reader{blob};
+        while (reader.Next()) {
+            switch (reader.Field()) {
+                case 1: raw = reader.Bytes(); break;
+                case 2: raw_size = reader.Varint(); break;
+                case 3: zlib_data = reader.Bytes(); break;
+                case 4: case 5: case 6: case 7:
+                    throw std::logic_error("PBF blobs compressed other than with zlib are not supported.");
+                default: reader.Skip();
+            }
+        }
+        if (zlib_data.empty()) return raw;
+
+        if (raw_size > kMaxBlobSize) Fail();
+        m_Buffer.resize(raw_size);
+        auto size = static_cast<uLongf>(raw_size);
+        if (uncompress(reinterpret_cast<Bytef*>(m_Buffer.data()), &size, reinterpret_cast<const Bytef*>(zlib_data.data()),
+                       static_cast<uLong>(zlib_data.size())) != Z_OK || size != raw_size) {
+            Fail();
+        }
+        return m_Buffer;
+    }
+
+    // Reports the bounding box of the header block and checks its required features.
+    void ParseHeader(std::string_view block) {
+        ProtoReader reader{block};
+        while (reader.Next()) {
+            if (reader.Field() == 1) {
+                std::int64_t left = 0, right = 0, top = 0, bottom = 0;
+                ProtoReader bbox{reader.Bytes()};
+                while (bbox.Next()) {
+                    switch (bbox.Field()) {
+                        case 1: left = bbox.SignedVarint(); break;
+                        case 2: right = bbox.SignedVarint(); break;
+                        case 3: top = bbox.SignedVarint(); break;
+                        case 4: bottom = bbox.SignedVarint(); break;
+                        default: bbox.Skip();
+                    }
+                }
+                m_Handler.Bounds(Degrees(bottom), Degrees(left), Degrees(top), Degrees(right));
+            } else if (reader.Field() == 4) {
+                const auto feature = reader.Bytes();
+                if (feature != "OsmSchema-V0.6" && feature != "DenseNodes") {
+                    throw std::logic_error("PBF feature not supported: " + std::string{feature});
+                }
+            } else {
+                reader.Skip();
+            }
+        }
+    }
+
+    // Parses a primitive block. The string table and the coordinate encoding may follow the
+    // groups in the block, so the groups are parsed once the whole block has been read.
+    void ParseBlock(std::string_view block) {
+        m_Strings.clear();
+        m_Groups.clear();
+        m_Granularity = 100;
+        m_LatOffset = 0;
+        m_LonOffset = 0;
+        ProtoReader reader{block};
+        while (reader.Next()) {
+            switch (reader.Field()) {
+                case 1: {
+                    ProtoReader table{reader.Bytes()};
+                    while (table.Next()) {
+                        if (table.Field() == 1) {
+                            m_Strings.push_back(table.Bytes());
+                        } else {
+                            table.Skip();
+                        }
+                    }
+                    break;
+                }
+                case 2: m_Groups.push_back(reader.Bytes()); break;
+                case 17: m_Granularity = static_cast<std::int64_t>(reader.Varint()); break;
+                case 19: m_LatOffset = static_cast<std::int64_t>(reader.Varint()); break;
+                case 20: m_LonOffset = static_cast<std::int64_t>(reader.Varint()); break;
+                default: reader.Skip();
+            }
+        }
+
+        for (const auto group : m_Groups) {
+            ProtoReader elements{group};
+            while (elements.Next()) {
+                switch (elements.Field()) {
+                    case 1: ParseNode(elements.Bytes()); break;
+                    case 2: ParseDenseNodes(elements.Bytes()); break;
+                    case 3: ParseWay(elements.Bytes()); break;
+                    case 4: ParseRelation(elements.Bytes()); break;
+                    default: elements.Skip();
+                }
+            }
+        }
+    }
+
+    void ParseNode(std::string_view message) {
+        OsmId id = 0;
+        std::int64_t lat = 0, lon = 0;
+        ProtoReader reader{message};
+        while (reader.Next()) {
+            switch (reader.Field()) {
+                case 1: id = reader.SignedVarint(); break;
+                case 8: lat = reader.SignedVarint(); break;
+                case 9: lon = reader.SignedVarint(); break;
+                default: reader.Skip();
+            }
+        }
+        m_Handler.Node(id, Latitude(lat), Longitude(lon));
+    }
+
+    // Dense nodes store the IDs and coordinates of many nodes as delta-coded packed arrays.
+    void ParseDenseNodes(std::string_view message) {
+        PackedVarints ids, lats, lons;
+        ProtoReader reader{message};
+        while (reader.Next()) {
+            switch (reader.Field()) {
+                case 1: ids = PackedVarints{reader.Bytes()}; break;
+                case 8: lats = PackedVarints{reader.Bytes()}; break;
+                case 9: lons = PackedVarints{reader.Bytes()}; break;
+                default: reader.Skip();
+            }
+        }
+        OsmId id = 0;
+        std::int64_t lat = 0, lon = 0;
+        while (!ids.Empty()) {
+            if (lats.Empty() || lons.Empty()) Fail();
+            id += ZigZag(ids.Next());
+            lat += ZigZag(lats.Next());
+            lon += ZigZag(lons.Next());
+            m_Handler.Node(id, Latitude(lat), Longitude(lon));
+        }
+    }
+
+    void ParseWay(std::string_view message) {
+        OsmId id = 0;
+        PackedVarints keys, values, refs;
+        ProtoReader reader{message};
+        while (reader.Next()) {
+            switch (reader.Field()) {
+                case 1: id = static_cast<OsmId>(reader.Varint()); break;
+                case 2: keys = PackedVarints{reader.Bytes()}; break;
+                case 3: values = PackedVarints{reader.Bytes()}; break;
+                case 8: refs = PackedVarints{reader.Bytes()}; break;
+                default: reader.Skip();
+            }
+        }
+        m_Refs.clear();
+        for (OsmId ref = 0; !refs.Empty();) {
+            ref += ZigZag(refs.Next());
+            m_Refs.push_back(ref);
+        }
+        ReadTags(keys, values);
+        m_Handler.Way(id, m_Refs, m_Tags);
+    }
+
+    void ParseRelation(std::string_view message) {
+        OsmId id = 0;
+        PackedVarints keys, values, roles, refs, types;
+        ProtoReader reader{message};
+        while (reader.Next()) {
+            switch (reader.Field()) {
+                case 1: id = static_cast<OsmId>(reader.Varint()); break;
+                case 2: keys = PackedVarints{reader.Bytes()}; break;
+                case 3: values = PackedVarints{reader.Bytes()}; break;
+                case 8: roles = PackedVarints{reader.Bytes()}; break;
+                case 9: refs = PackedVarints{reader.Bytes()}; break;
+                case 10: types = PackedVarints{reader.Bytes()}; break;
+                default: reader.Skip();
+            }
+        }
+        static constexpr std::string_view kTypes[] = {"node", "way", "relation"};
+        m_Members.clear();
+        for (OsmId ref = 0; !refs.Empty();) {
+            if (roles.Empty() || types.Empty()) Fail();
+            ref += ZigZag(refs.Next());
+            const auto role = String(roles.Next());
+            const auto type = types.Next();
+            if (type >= std::size(kTypes)) Fail();
+            m_Members.push_back({kTypes[type], ref, role});
+        }
+        ReadTags(keys, values);
+        m_Handler.Relation(id, m_Members, m_Tags);
+    }
+
+    // Reads tags given as parallel arrays of string table indices.
+    void ReadTags(PackedVarints& keys, PackedVarints& values) {
+        m_Tags.clear();
+        while (!keys.Empty()) {
+            if (values.Empty()) Fail();
+            const auto key = String(keys.Next());
+            m_Tags.push_back({key, String(values.Next())});
+        }
+    }
+
+    std::string_view String(std::uint64_t index) const {
+        if (index >= m_Strings.size()) Fail();
+        return m_Strings[index];
+    }
+
+    // Converts coordinates in nanodegrees to degrees. Dividing the exact integer rounds
+    // correctly, so the result equals the parsed decimal of the same coordinate in XML.
+    static double Degrees(std::int64_t nanodegrees) { return static_cast<double>(nanodegrees) / 1e9; }
+    double Latitude(std::int64_t lat) const { return Degrees(m_LatOffset + m_Granularity * lat); }
+    double Longitude(std::int64_t lon) const { return Degrees(m_LonOffset + m_Granularity * lon); }
+
+    OsmHandler& m_Handler;
+    std::string m_Buffer;                     // Contents of the current compressed blob
+    std::vector<std::string_view> m_Strings;  // String table of the current block
+    std::vector<std::string_view> m_Groups;   // Primitive groups of the current block
+    std::int64_t m_Granularity = 100;         // Coordinate unit of the current block, in nanodegrees
+    std::int64_t m_LatOffset = 0;
+    std::int64_t m_LonOffset = 0;
+
+    // Scratch buffers reused across elements
+    std::vector<OsmId> m_Refs;
+    std::vector<OsmTag> m_Tags;
+    std::vector<OsmMember> m_Members;
+};
+
+}  // namespace
+
+/**
+ * Checks whether a buffer starts like a PBF file, with an OSMHeader blob.
+ * @param data The buffer.
+ * @return True if the buffer looks like a PBF file.
+ */
+bool OsmPbfReader::Matches(Span<const std::byte> data) noexcept {
+    try {
+        std::size_t offset = 0;
+        return ReadBlob(data, offset).type == "OSMHeader";
+    } catch (const std::logic_error&) {
+        return false;
+    }
+}
+
+/**
+ * Splits a PBF file held in memory into pieces of whole blobs, of about equal size.
+ * @param pbf The file.
+ * @param pieces The desired number of pieces; fewer are returned for small files.
+ * @param min_piece_size The minimum size of a piece in bytes.
+ * @return Views of the pieces.
+ */
+std::vector<Span<const std::byte>> OsmPbfReader::Split(Span<const std::byte> pbf, std::size_t pieces,
+                                                       std::size_t min_piece_size) {
+    const std::size_t target = std::max(pbf.size() / std::max<std::size_t>(pieces, 1), min_piece_size);
+    std::vector<Span<const std::byte>> result;
+    std::size_t begin = 0, offset = 0;
+    while (offset < pbf.size()) {
+        ReadBlob(pbf, offset);
+        if (offset - begin >= target || offset == pbf.size()) {
+            result.emplace_back(pbf.data() + begin, offset - begin);
+            begin = offset;
+        }
+    }
+    return result;
+}
+
+/**
+ * Parses a PBF file, or a piece of one returned by Split().
+ * @param pbf The file or piece.
+ * @param handler The receiver of the parsed elements.
+ */
+void OsmPbfReader::Parse(Span<const std::byte> pbf, OsmHandler& handler) {
+    BlockParser parser{handler};
+    for (std::size_t offset = 0; offset < pbf.size();) {
+        parser.Parse(ReadBlob(pbf, offset));
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef OSM_PBF_READER_H
+#define OSM_PBF_READER_H
+
+#include <cstddef>
+#include <vector>
+#include "osm_handler.h"
+#include "span.h"
+
+/**
+ * The OsmPbfReader class reads the OSM PBF format (.osm.pbf), the protocol buffer encoding
+ * in which OSM extracts are usually distributed. It reports the same elements to an OsmHandler
+ * as OsmXmlReader does for the equivalent XML, in file order.
+ *
+ * A PBF file is a sequence of blobs, each compressed on its own with zlib (or stored raw) and
+ * holding a block of a few thousand elements. Split() divides a file at blob boundaries, so
+ * the pieces can be decoded on several threads. Nodes may be stored plainly or as dense
+ * nodes. Element metadata and node tags are skipped, as the handler does not take them.
+ */
+class OsmPbfReader {
+public:
+    /**
+     * Checks whether a buffer starts like a PBF file, with an OSMHeader blob.
+     * @param data The buffer.
+     * @return True if the buffer looks like a PBF file.
+     */
+    static bool Matches(Span<const std::byte> data) noexcept;
+
+    /**
+     * Splits a PBF file held in memory into pieces of whole blobs that can be parsed
+     * independently, e.g. on several threads. The pieces cover the file in order.
+     * @param pbf The file.
+     * @param pieces The desired number of pieces; fewer are returned for small files.
+     * @param min_piece_size The minimum size of a piece in bytes.
+     * @return Views of the pieces.
+     * @throws std::logic_error if the blob structure of the file is corrupt.
+     */
+    static std::vector<Span<const std::byte>> Split(Span<const std::byte> pbf, std::size_t pieces,
+                                                    std::size_t min_piece_size = 1 << 20);
+
+    /**
+     * Parses a PBF file, or a piece of one returned by Split().
+     * @param pbf The file or piece.
+     * @param handler The receiver of the parsed elements.
+     * @throws std::logic_error if the data is corrupt or uses a feature that is not supported.
+     */
+    static void Parse(Span<const std::byte> pbf, OsmHandler& handler);
+};
+
+#endif
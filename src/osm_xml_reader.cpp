@@ -0,0 +1,503 @@
+#include "osm_xml_reader.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+[[noreturn]] void ParseError() {
+    throw std::logic_error("Failed to parse the XML file.");
+}
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool IsNameChar(char c) {
+    return !IsSpace(c) && c != '/' && c != '>' && c != '<' && c != '=' && c != '"' && c != '\'';
+}
+
+// Returns the position of needle in [p, end), or nullptr.
+const char* Find(const char* p, const char* end, std::string_view needle) {
+    while (p < end) {
+        p = static_cast<const char*>(std::memchr(p, needle.front(), end - p));
+        if (!p || static_cast<std::size_t>(end - p) < needle.size()) return nullptr;
+        if (std::string_view{p, needle.size()} == needle) return p;
+        ++p;
+    }
+    return nullptr;
+}
+
+// Returns true if [p, end) could still turn out to start with prefix once more input arrives.
+bool MayStartWith(const char* p, const char* end, std::string_view prefix) {
+    const auto n = std::min<std::size_t>(end - p, prefix.size());
+    return std::string_view{p, n} == prefix.substr(0, n);
+}
+
+void AppendUtf8(std::string& out, std::uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+/**
+ * Converts a coordinate attribute to a double with the same rules as std::stod:
+ * leading whitespace is skipped and trailing characters are ignored.
+ */
+double ParseDouble(std::string_view text) {
+    std::size_t i = 0;
+    while (i < text.size() && IsSpace(text[i])) ++i;
+    if (i < text.size() && text[i] == '+') ++i;
+    double value = 0.0;
+    auto [ptr, ec] = std::from_chars(text.data() + i, text.data() + text.size(), value);
+    if (ec != std::errc{}) {
+        throw std::invalid_argument("Invalid coordinate in the XML file.");
+    }
+    return value;
+}
+
+/**
+ * Converts an ID attribute to an integer. IDs are compared as numbers, so leading
+ * zeros and a leading '+' are accepted.
+ */
+OsmId ParseId(std::string_view text) {
+    std::size_t i = 0;
+    if (i < text.size() && text[i] == '+') ++i;
+    OsmId value = 0;
+    auto [ptr, ec] = std::from_chars(text.data() + i, text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) {
+        throw std::invalid_argument("Invalid ID in the XML file.");
+    }
+    return value;
+}
+
+}  // namespace
+
+/**
+ * Parses a complete OSM XML document held in memory.
+ * @param xml The document.
+ * @param handler The receiver of the parsed elements.
+ */
+void OsmXmlReader::Parse(std::string_view xml, OsmHandler& handler) {
+    OsmXmlReader reader{handler};
+    reader.Feed(xml.data(), xml.size());
+    reader.Finish();
+}
+
+/**
+ * Splits a document held in memory into pieces that can be parsed independently.
+ * @param xml The document.
+ * @param pieces The desired number of pieces.
+ * @param min_piece_size The minimum size of a piece in bytes, so that each piece is worth
+ * handing to another thread.
+ * @return Views of the pieces.
+ */
+std::vector<std::string_view> OsmXmlReader::Split(std::string_view xml, std::size_t pieces, std::size_t min_piece_size) {
+    pieces = std::max<std::size_t>(1, std::min(pieces, xml.size() / std::max<std::size_t>(min_piece_size, 1)));
+
+    // A piece may start at "<node", "<way" or "<relation" preceded by a newline and indentation.
+    // These elements only occur directly under <osm>; starting at a line keeps the cut points
+    // out of attribute values, which cannot contain '<' anyway.
+    const auto is_cut = [&](std::size_t lt) {
+        std::size_t b = lt;
+        while (b > 0 && (xml[b - 1] == ' ' || xml[b - 1] == '\t')) --b;
+        if (b == 0 || xml[b - 1] != '\n') return false;
+        const auto rest = xml.substr(lt + 1);
+        for (std::string_view name : {"node", "way", "relation"}) {
+            if (rest.size() > name.size() && rest.substr(0, name.size()) == name && IsSpace(rest[name.size()])) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<std::string_view> result;
+    std::size_t start = 0;
+    for (std::size_t i = 1; i < pieces; ++i) {
+        std::size_t cut = std::max(start + 1, xml.size() / pieces * i);
+        while (cut < xml.size() && !(xml[cut] == '<' && is_cut(cut))) {
+            const auto lt = xml.find('<', cut + 1);
+            cut = lt == std::string_view::npos ? xml.size() : lt;
+        }
+        if (cut >= xml.size()) break;
+        result.push_back(xml.substr(start, cut - start));
+        start = cut;
+    }
+    result.push_back(xml.substr(start));
+    return result;
+}
+
+/**
+ * Parses one piece of a document split with Split().
+ * @param piece The piece.
+ * @param first Whether the piece is the first of the document.
+ * @param last Whether the piece is the last of the document.
+ * @param handler The receiver of the parsed elements.
+ */
+void OsmXmlReader::ParsePiece(std::string_view piece, bool first, bool last, OsmHandler& handler) {
+    OsmXmlReader reader{handler};
+    if (!first) {
+        // Continue inside the <osm> root opened by the first piece
+        reader.m_SeenRoot = true;
+        reader.m_InOsmRoot = true;
+        reader.m_Depth = 1;
+    }
+    reader.Feed(piece.data(), piece.size());
+    if (last) {
+        reader.Finish();
+    } else if (!reader.m_Carry.empty() || reader.m_Depth != 1 || !reader.m_InOsmRoot) {
+        ParseError();
+    }
+}
+
+/**
+ * Parses the next chunk of the input.
+ * @param data The chunk.
+ * @param size The size of the chunk in bytes.
+ */
+void OsmXmlReader::Feed(const char* data, std::size_t size) {
+    if (m_Carry.empty()) {
+        // Parse in place and only keep the incomplete tail
+        const char* rest = ParseUnits(data, data + size);
+        m_Carry.assign(rest, data + size);
+    } else {
+        m_Carry.append(data, size);
+        const char* rest = ParseUnits(m_Carry.data(), m_Carry.data() + m_Carry.size());
+        m_Carry.erase(0, rest - m_Carry.data());
+    }
+}
+
+/**
+ * Signals the end of the input.
+ */
+void OsmXmlReader::Finish() {
+    if (!m_Carry.empty() || m_Depth != 0 || !m_SeenRoot) {
+        ParseError();
+    }
+}
+
+/**
+ * Parses as many complete top-level units as possible.
+ * @return The first byte that could not be parsed yet.
+ */
+const char* OsmXmlReader::ParseUnits(const char* p, const char* end) {
+    while (true) {
+        // Character data between elements carries no information for the model
+        const char* lt = static_cast<const char*>(std::memchr(p, '<', end - p));
+        if (!lt) return end;
+
+        // Elements directly under <osm> or under a section of <osmChange> are parsed as a whole
+        if (((m_Depth == 1 && m_InOsmRoot) || (m_Depth == 2 && m_InSection)) && end - lt > 1 && lt[1] != '/' && lt[1] != '!' && lt[1] != '?') {
+            const char* next = ParseElement(lt, end);
+            if (!next) return lt;
+            p = next;
+            continue;
+        }
+
+        Markup kind;
+        std::string_view name;
+        const char* next = ReadMarkup(lt, end, kind, name);
+        if (!next) return lt;
+        switch (kind) {
+            case Markup::StartTag:
+                if (m_Depth == 0) {
+                    if (m_SeenRoot) ParseError();
+                    m_SeenRoot = true;
+                    m_InOsmRoot = name == "osm";
+                    m_InChangeRoot = name == "osmChange";
+                } else if (m_Depth == 1 && m_InChangeRoot) {
+                    m_InSection = true;
+                    if (name == "create") m_Action = OsmAction::Create;
+                    else if (name == "modify") m_Action = OsmAction::Modify;
+                    else if (name == "delete") m_Action = OsmAction::Delete;
+                    else m_InSection = false;  // Not a section; its contents are skipped
+                    if (m_InSection) m_Handler.Section(m_Action);
+                }
+                ++m_Depth;
+                break;
+            case Markup::EmptyTag:
+                if (m_Depth == 0) {
+                    if (m_SeenRoot) ParseError();
+                    m_SeenRoot = true;
+                }
+                break;
+            case Markup::EndTag:
+                if (m_Depth == 0) ParseError();
+                if (--m_Depth == 1) m_InSection = false;
+                break;
+            case Markup::Skip:
+                break;
+        }
+        p = next;
+    }
+}
+
+/**
+ * Parses a node, way, relation or bounds element and reports it to the handler.
+ * Other elements are skipped.
+ * @return The byte after the element, or nullptr if the element is incomplete.
+ */
+const char* OsmXmlReader::ParseElement(const char* p, const char* end) {
+    enum class Type { Bounds, Node, Way, Relation, Other };
+
+    Markup kind;
+    std::string_view element_name;
+    const char* q = ReadMarkup(p, end, kind, element_name);
+    if (!q) return nullptr;
+
+    Type type = Type::Other;
+    if (element_name == "node") type = Type::Node;
+    else if (element_name == "way") type = Type::Way;
+    else if (element_name == "relation") type = Type::Relation;
+    else if (element_name == "bounds") type = Type::Bounds;
+
+    // Capture the attributes of the element before its children overwrite m_Attributes
+    m_Decoded.clear();
+    m_Refs.clear();
+    m_Tags.clear();
+    m_Members.clear();
+    OsmId id = 0;
+    std::string_view lat, lon, max_lat, max_lon;
+    if (type == Type::Bounds) {
+        lat = Attr("minlat");
+        lon = Attr("minlon");
+        max_lat = Attr("maxlat");
+        max_lon = Attr("maxlon");
+    } else if (type != Type::Other) {
+        id = ParseId(Attr("id"));
+        if (type == Type::Node) {
+            lat = Attr("lat");
+            lon = Attr("lon");
+        }
+    }
+
+    // Collect the children: nd and tag for ways, member and tag for relations
+    if (kind == Markup::StartTag) {
+        int depth = 1;
+        while (depth > 0) {
+            const char* lt = static_cast<const char*>(std::memchr(q, '<', end - q));
+            if (!lt) return nullptr;
+            std::string_view name;
+            q = ReadMarkup(lt, end, kind, name);
+            if (!q) return nullptr;
+
+            if (kind == Markup::EndTag) {
+                if (--depth == 0 && name != element_name) ParseError();
+                continue;
+            }
+            if (kind == Markup::Skip) continue;
+            if (depth == 1) {
+                if (name == "tag" && (type == Type::Way || type == Type::Relation)) {
+                    m_Tags.push_back({Attr("k"), Attr("v")});
+                } else if (name == "nd" && type == Type::Way) {
+                    m_Refs.push_back(ParseId(Attr("ref")));
+                } else if (name == "member" && type == Type::Relation) {
+                    m_Members.push_back({Attr("type"), ParseId(Attr("ref")), Attr("role")});
+                }
+            }
+            if (kind == Markup::StartTag) ++depth;
+        }
+    }
+
+    switch (type) {
+        case Type::Bounds:
+            m_Handler.Bounds(ParseDouble(lat), ParseDouble(lon), ParseDouble(max_lat), ParseDouble(max_lon));
+            break;
+        case Type::Node:
+            if (m_InSection && m_Action == OsmAction::Delete && lat.empty() && lon.empty()) {
+                m_Handler.Node(id, 0.0, 0.0);  // Deleted nodes may come without coordinates
+                break;
+            }
+            m_Handler.Node(id, ParseDouble(lat), ParseDouble(lon));
+            break;
+        case Type::Way:
+            m_Handler.Way(id, m_Refs, m_Tags);
+            break;
+        case Type::Relation:
+            m_Handler.Relation(id, m_Members, m_Tags);
+            break;
+        case Type::Other:
+            break;
+    }
+    return q;
+}
+
+/**
+ * Reads one piece of markup starting at '<'. For start tags the attributes are
+ * stored in m_Attributes.
+ * @return The byte after the markup, or nullptr if the markup is incomplete.
+ */
+const char* OsmXmlReader::ReadMarkup(const char* p, const char* end, Markup& kind, std::string_view& name) {
+    const char* q = p + 1;
+    if (q >= end) return nullptr;
+
+    // Processing instructions, comments, CDATA sections and DOCTYPE declarations
+    if (*q == '?') {
+        const char* close = Find(q, end, "?>");
+        kind = Markup::Skip;
+        return close ? close + 2 : nullptr;
+    }
+    if (*q == '!') {
+        const char* close = nullptr;
+        if (MayStartWith(q, end, "!--")) {
+            if (end - q < 3) return nullptr;
+            close = Find(q + 3, end, "-->");
+            if (close) close += 3;
+        } else if (MayStartWith(q, end, "![CDATA[")) {
+            if (end - q < 8) return nullptr;
+            close = Find(q + 8, end, "]]>");
+            if (close) close += 3;
+        } else {
+            int brackets = 0;
+            for (const char* c = q; c < end; ++c) {
+                if (*c == '[') ++brackets;
+                else if (*c == ']') --brackets;
+                else if (*c == '>' && brackets == 0) { close = c + 1; break; }
+            }
+        }
+        kind = Markup::Skip;
+        return close;
+    }
+
+    // End tag
+    if (*q == '/') {
+        const char* start = ++q;
+        while (q < end && IsNameChar(*q)) ++q;
+        while (q < end && IsSpace(*q)) ++q;
+        if (q >= end) return nullptr;
+        if (*q != '>') ParseError();
+        name = std::string_view{start, static_cast<std::size_t>(q - start)};
+        while (!name.empty() && IsSpace(name.back())) name.remove_suffix(1);
+        kind = Markup::EndTag;
+        return q + 1;
+    }
+
+    // Start or empty-element tag with its attributes
+    const char* start = q;
+    while (q < end && IsNameChar(*q)) ++q;
+    if (q >= end) return nullptr;
+    if (q == start) ParseError();
+    name = std::string_view{start, static_cast<std::size_t>(q - start)};
+    m_Attributes.clear();
+    while (true) {
+        while (q < end && IsSpace(*q)) ++q;
+        if (q >= end) return nullptr;
+        if (*q == '/') {
+            if (q + 1 >= end) return nullptr;
+            if (q[1] != '>') ParseError();
+            kind = Markup::EmptyTag;
+            return q + 2;
+        }
+        if (*q == '>') {
+            kind = Markup::StartTag;
+            return q + 1;
+        }
+
+        const char* attr_start = q;
+        while (q < end && IsNameChar(*q)) ++q;
+        if (q >= end) return nullptr;
+        if (q == attr_start) ParseError();
+        std::string_view attr_name{attr_start, static_cast<std::size_t>(q - attr_start)};
+        while (q < end && IsSpace(*q)) ++q;
+        if (q >= end) return nullptr;
+        if (*q != '=') ParseError();
+        ++q;
+        while (q < end && IsSpace(*q)) ++q;
+        if (q >= end) return nullptr;
+        const char quote = *q;
+        if (quote != '"' && quote != '\'') ParseError();
+
+        const char* value_start = ++q;
+        bool needs_decoding = false;
+        for (; q < end && *q != quote; ++q) {
+            if (*q == '&' || *q == '\t' || *q == '\n' || *q == '\r') needs_decoding = true;
+        }
+        if (q >= end) return nullptr;
+        m_Attributes.push_back({attr_name, std::string_view{value_start, static_cast<std::size_t>(q - value_start)}, needs_decoding});
+        ++q;
+    }
+}
+
+/**
+ * Returns the decoded value of an attribute of the last start tag.
+ * @param name The attribute name.
+ * @return The value, or an empty view if the tag has no such attribute.
+ */
+std::string_view OsmXmlReader::Attr(std::string_view name) {
+    for (const auto& attribute : m_Attributes) {
+        if (attribute.name == name) {
+            return attribute.needs_decoding ? Decode(attribute) : attribute.value;
+        }
+    }
+    return {};
+}
+
+/**
+ * Expands character and entity references and turns whitespace characters into
+ * spaces, as XML attribute-value normalization requires.
+ * @return A view of the decoded value, valid until the next element is parsed.
+ */
+std::string_view OsmXmlReader::Decode(const Attribute& attribute) {
+    const auto raw = attribute.value;
+    auto& out = m_Decoded.emplace_back();
+    out.reserve(raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        const char c = raw[i];
+        if (c == '\t' || c == '\n') {
+            out += ' ';
+            continue;
+        }
+        if (c == '\r') {
+            out += ' ';
+            if (i + 1 < raw.size() && raw[i + 1] == '\n') ++i;
+            continue;
+        }
+        if (c != '&') {
+            out += c;
+            continue;
+        }
+
+        const auto semicolon = raw.find(';', i);
+        if (semicolon == std::string_view::npos) {
+            out += c;
+            continue;
+        }
+        const auto entity = raw.substr(i + 1, semicolon - i - 1);
+        if (entity == "amp") out += '&';
+        else if (entity == "lt") out += '<';
+        else if (entity == "gt") out += '>';
+        else if (entity == "quot") out += '"';
+        else if (entity == "apos") out += '\'';
+        else if (entity.size() > 1 && entity[0] == '#') {
+            const bool hex = entity[1] == 'x';
+            std::uint32_t cp = 0;
+            auto digits = entity.substr(hex ? 2 : 1);
+            auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), cp, hex ? 16 : 10);
+            if (ec != std::errc{} || ptr != digits.data() + digits.size()) {
+                out += c;
+                continue;
+            }
+            AppendUtf8(out, cp);
+        } else {
+            // Unknown entities are kept verbatim
+            out += c;
+            continue;
+        }
+        i = semicolon;
+    }
+    return out;
+}
@@ -0,0 +1,118 @@
+#ifndef OSM_XML_READER_H
+#define OSM_XML_READER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "osm_handler.h"
+
+/**
+ * The OsmXmlReader class is a single-pass streaming tokenizer for OSM XML.
+ * It recognises the elements directly under the <osm> root (bounds, node, way,
+ * relation) and reports each one to an OsmHandler as soon as it is complete,
+ * without building a document tree. osmChange documents are read the same way:
+ * the elements of their <create>, <modify> and <delete> sections are reported
+ * after the section itself. Deleted nodes need not carry coordinates; they are
+ * reported at 0, 0.
+ *
+ * Input can be fed in arbitrary chunks. Attribute values are views into the input,
+ * so a buffer passed to Feed() in one piece is parsed in place; only an element split
+ * across two chunks is carried over into an internal buffer.
+ */
+class OsmXmlReader {
+public:
+    /**
+     * Constructor: Creates a reader that reports elements to a handler.
+     * @param handler The receiver of the parsed elements.
+     */
+    explicit OsmXmlReader(OsmHandler& handler) : m_Handler(handler) {}
+
+    /**
+     * Parses the next chunk of the input.
+     * @param data The chunk.
+     * @param size The size of the chunk in bytes.
+     * @throws std::logic_error if the input is not well-formed.
+     */
+    void Feed(const char* data, std::size_t size);
+
+    /**
+     * Signals the end of the input.
+     * @throws std::logic_error if the input ended inside an element.
+     */
+    void Finish();
+
+    /**
+     * Parses a complete OSM XML document held in memory.
+     * @param xml The document.
+     * @param handler The receiver of the parsed elements.
+     */
+    static void Parse(std::string_view xml, OsmHandler& handler);
+
+    /**
+     * Splits a document held in memory into pieces that can be parsed independently,
+     * e.g. on several threads. Every piece but the first starts at a <node>, <way> or
+     * <relation> element that begins a line; the pieces cover the document in order.
+     * @param xml The document.
+     * @param pieces The desired number of pieces; fewer are returned for small documents.
+     * @param min_piece_size The minimum size of a piece in bytes.
+     * @return Views of the pieces.
+     */
+    static std::vector<std::string_view> Split(std::string_view xml, std::size_t pieces,
+                                               std::size_t min_piece_size = 1 << 20);
+
+    /**
+     * Parses one piece of a document split with Split().
+     * @param piece The piece.
+     * @param first Whether the piece is the first of the document.
+     * @param last Whether the piece is the last of the document.
+     * @param handler The receiver of the parsed elements.
+     * @throws std::logic_error if the piece is not well-formed or does not end between
+     * two elements of the <osm> root.
+     */
+    static void ParsePiece(std::string_view piece, bool first, bool last, OsmHandler& handler);
+
+private:
+    enum class Markup { StartTag, EmptyTag, EndTag, Skip };
+
+    // An attribute of the last start tag read, with its raw (undecoded) value.
+    struct Attribute {
+        std::string_view name;
+        std::string_view value;
+        bool needs_decoding;
+    };
+
+    // Parses as many complete top-level units as possible; returns the first unparsed byte.
+    const char* ParseUnits(const char* p, const char* end);
+
+    // Parses a node, way, relation or bounds element starting at p; nullptr if incomplete.
+    const char* ParseElement(const char* p, const char* end);
+
+    // Reads one piece of markup starting at '<'; nullptr if incomplete.
+    const char* ReadMarkup(const char* p, const char* end, Markup& kind, std::string_view& name);
+
+    // Returns the decoded value of an attribute of the last start tag, or an empty view.
+    std::string_view Attr(std::string_view name);
+
+    std::string_view Decode(const Attribute& attribute);
+
+    OsmHandler& m_Handler;
+
+    int m_Depth = 0;             // Element depth at the current position
+    bool m_SeenRoot = false;     // Whether the root element has started
+    bool m_InOsmRoot = false;    // Whether the root element is <osm>
+    bool m_InChangeRoot = false; // Whether the root element is <osmChange>
+    bool m_InSection = false;    // Whether inside a section of an <osmChange> root
+    OsmAction m_Action = OsmAction::Create;  // Change of the current section
+    std::string m_Carry;         // Unparsed tail of the previous chunk
+
+    // Scratch buffers reused across elements
+    std::vector<Attribute> m_Attributes;
+    std::deque<std::string> m_Decoded;
+    std::vector<OsmId> m_Refs;
+    std::vector<OsmTag> m_Tags;
+    std::vector<OsmMember> m_Members;
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef PRIORITY_QUEUE_H
+#define PRIORITY_QUEUE_H
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Indexed min-priority queues used as the open list of the route searches.
+ *
+ * Items are dense integer ids in [0, capacity) (node indices of the RouteModel),
+ * so every id can sit in the queue at most once and its position is tracked in a
+ * flat array. Both queues share the same interface and can be swapped freely:
+ *   Push(id, key), DecreaseKey(id, key), PushOrDecrease(id, key),
+ *   Pop(), TopId(), TopKey(), Contains(id), Empty(), Size(), Clear(), Resize(n).
+ */
+
+/**
+ * Indexed d-ary min-heap with decrease-key.
+ * A 4-ary heap keeps the tree shallow and the children of a slot in one cache line.
+ */
+template <unsigned Arity = 4>
+class IndexedDaryHeap {
+    static_assert(Arity >= 2, "A heap needs at least two children per slot");
+
+public:
+    IndexedDaryHeap() = default;
+
+    /**
+     * Constructor: Prepares the heap for ids in [0, capacity).
+     * @param capacity The number of distinct ids the heap can hold.
+     */
+    explicit IndexedDaryHeap(std::size_t capacity) { Resize(capacity); }
+
+    /**
+     * Resizes the id range of the heap. Clears the heap.
+     * @param capacity The number of distinct ids the heap can hold.
+     */
+    void Resize(std::size_t capacity) {
+        m_Heap.clear();
+        m_Position.assign(capacity, npos);
+    }
+
+    bool Empty() const noexcept { return m_Heap.empty(); }
+    std::size_t Size() const noexcept { return m_Heap.size(); }
+    std::size_t Capacity() const noexcept { return m_Position.size(); }
+    bool Contains(int id) const noexcept { return m_Position[id] != npos; }
+
+    int TopId() const { assert(!Empty()); return m_Heap.front().id; }
+    float TopKey() const { assert(!Empty()); return m_Heap.front().key; }
+
+    /**
+     * Returns the key of an id currently in the heap.
+     */
+    float Key(int id) const { assert(Contains(id)); return m_Heap[m_Position[id]].key; }
+
+    /**
+     * Inserts an id that is not yet in the heap.
+     */
+    void Push(int id, float key) {
+        assert(!Contains(id));
+        m_Position[id] = m_Heap.size();
+        m_Heap.push_back({key, id});
+        SiftUp(m_Heap.size() - 1);
+    }
+
+    /**
+     * Lowers the key of an id already in the heap.
+     */
+    void DecreaseKey(int id, float key) {
+        assert(Contains(id) && key <= Key(id));
+        auto pos = m_Position[id];
+        m_Heap[pos].key = key;
+        SiftUp(pos);
+    }
+
+    /**
+     * Inserts the id, or lowers its key if it is already queued with a larger one.
+     * @return True if the heap changed.
+     */
+    bool PushOrDecrease(int id, float key) {
+        if (!Contains(id)) {
+            Push(id, key);
+            return true;
+        }
+        if (key < Key(id)) {
+            DecreaseKey(id, key);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Removes the id with the smallest key and returns it.
+     */
+    int Pop() {
+        assert(!Empty());
+        const int top = m_Heap.front().id;
+        m_Position[top] = npos;
+        const Entry last = m_Heap.back();
+        m_Heap.pop_back();
+        if (!m_Heap.empty()) {
+            m_Heap.front() = last;
+            m_Position[last.id] = 0;
+            SiftDown(0);
+        }
+        return top;
+    }
+
+    /**
+     * Empties the heap in O(size), leaving the id range untouched.
+     */
+    void Clear() {
+        for (const auto& entry : m_Heap) {
+            m_Position[entry.id] = npos;
+        }
+        m_Heap.clear();
+    }
+
+private:
+    struct Entry {
+        float key;
+        int id;
+    };
+
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    void SiftUp(std::size_t pos) {
+        const Entry entry = m_Heap[pos];
+        while (pos > 0) {
+            const auto parent = (pos - 1) / Arity;
+            if (!(entry.key < m_Heap[parent].key)) break;
+            Place(pos, m_Heap[parent]);
+            pos = parent;
+        }
+        Place(pos, entry);
+    }
+
+    void SiftDown(std::size_t pos) {
+        const Entry entry = m_Heap[pos];
+        const auto size = m_Heap.size();
+        while (true) {
+            const auto first = pos * Arity + 1;
+            if (first >= size) break;
+            const auto last = first + Arity < size ? first + Arity : size;
+            auto best = first;
+            for (auto child = first + 1; child < last; ++child) {
+                if (m_Heap[child].key < m_Heap[best].key) best = child;
+            }
+            if (!(m_Heap[best].key < entry.key)) break;
+            Place(pos, m_Heap[best]);
+            pos = best;
+        }
+        Place(pos, entry);
+    }
+
+    void Place(std::size_t pos, const Entry& entry) {
+        m_Heap[pos] = entry;
+        m_Position[entry.id] = pos;
+    }
+
+    std::vector<Entry> m_Heap;             // Implicit d-ary tree of (key, id)
+    std::vector<std::size_t> m_Position;   // Slot of every id in m_Heap, npos if absent
+};
+
+/**
+ * Indexed pairing heap with decrease-key.
+ * O(1) insert and decrease-key, amortised O(log n) pop; nodes live in a flat pool indexed by id.
+ */
+class PairingHeap {
+public:
+    PairingHeap() = default;
+
+    /**
+     * Constructor: Prepares the heap for ids in [0, capacity).
+     * @param capacity The number of distinct ids the heap can hold.
+     */
+    explicit PairingHeap(std::size_t capacity) { Resize(capacity); }
+
+    /**
+     * Resizes the id range of the heap. Clears the heap.
+     * @param capacity The number of distinct ids the heap can hold.
+     */
+    void Resize(std::size_t capacity) {
+        m_Nodes.assign(capacity, Node{});
+        m_Queued.clear();
+        m_Root = none;
+        m_Size = 0;
+    }
+
+    bool Empty() const noexcept { return m_Root == none; }
+    std::size_t Size() const noexcept { return m_Size; }
+    std::size_t Capacity() const noexcept { return m_Nodes.size(); }
+    bool Contains(int id) const noexcept { return m_Nodes[id].in_heap; }
+
+    int TopId() const { assert(!Empty()); return m_Root; }
+    float TopKey() const { assert(!Empty()); return m_Nodes[m_Root].key; }
+
+    /**
+     * Returns the key of an id currently in the heap.
+     */
+    float Key(int id) const { assert(Contains(id)); return m_Nodes[id].key; }
+
+    /**
+     * Inserts an id that is not yet in the heap.
+     */
+    void Push(int id, float key) {
+        assert(!Contains(id));
+        auto& node = m_Nodes[id];
+        node = Node{};
+        node.key = key;
+        node.in_heap = true;
+        m_Queued.push_back(id);
+        m_Root = Meld(m_Root, id);
+        ++m_Size;
+    }
+
+    /**
+     * Lowers the key of an id already in the heap.
+     */
+    void DecreaseKey(int id, float key) {
+        assert(Contains(id) && key <= Key(id));
+        m_Nodes[id].key = key;
+        if (id == m_Root) return;
+        Detach(id);
+        m_Root = Meld(m_Root, id);
+    }
+
+    /**
+     * Inserts the id, or lowers its key if it is already queued with a larger one.
+     * @return True if the heap changed.
+     */
+    bool PushOrDecrease(int id, float key) {
+        if (!Contains(id)) {
+            Push(id, key);
+            return true;
+        }
+        if (key < Key(id)) {
+            DecreaseKey(id, key);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Removes the id with the smallest key and returns it.
+     */
+    int Pop() {
+        assert(!Empty());
+        const int top = m_Root;
+        m_Root = MergePairs(m_Nodes[top].child);
+        if (m_Root != none) m_Nodes[m_Root].prev = none;
+        m_Nodes[top].in_heap = false;
+        --m_Size;
+        return top;
+    }
+
+    /**
+     * Empties the heap in O(ids pushed since the last clear).
+     */
+    void Clear() {
+        for (int id : m_Queued) {
+            m_Nodes[id].in_heap = false;
+        }
+        m_Queued.clear();
+        m_Root = none;
+        m_Size = 0;
+    }
+
+private:
+    static constexpr int none = -1;
+
+    struct Node {
+        float key = 0.f;
+        int child = none;    // Leftmost child
+        int sibling = none;  // Next sibling to the right
+        int prev = none;     // Left sibling, or parent for a leftmost child
+        bool in_heap = false;
+    };
+
+    // Links two trees and returns the new root.
+    int Meld(int a, int b) {
+        if (a == none) return b;
+        if (b == none) return a;
+        if (m_Nodes[b].key < m_Nodes[a].key) std::swap(a, b);
+        auto& parent = m_Nodes[a];
+        auto& child = m_Nodes[b];
+        child.sibling = parent.child;
+        if (parent.child != none) m_Nodes[parent.child].prev = b;
+        child.prev = a;
+        parent.child = b;
+        parent.sibling = none;
+        return a;
+    }
+
+    // Cuts the subtree rooted at id out of its parent's child list.
+    void Detach(int id) {
+        auto& node = m_Nodes[id];
+        auto& prev = m_Nodes[node.prev];
+        if (prev.child == id) {
+            prev.child = node.sibling;
+        } else {
+            prev.sibling = node.sibling;
+        }
+        if (node.sibling != none) m_Nodes[node.sibling].prev = node.prev;
+        node.prev = none;
+        node.sibling = none;
+    }
+
+    // Standard two-pass pairing of a sibling list.
+    int MergePairs(int first) {
+        if (first == none) return none;
+        m_Pairs.clear();
+        while (first != none) {
+            int a = first;
+            int b = m_Nodes[a].sibling;
+            first = b != none ? m_Nodes[b].sibling : none;
+            m_Nodes[a].sibling = none;
+            m_Nodes[a].prev = none;
+            if (b != none) {
+                m_Nodes[b].sibling = none;
+                m_Nodes[b].prev = none;
+            }
+            m_Pairs.push_back(Meld(a, b));
+        }
+        int root = m_Pairs.back();
+        for (auto i = m_Pairs.size() - 1; i-- > 0;) {
+            root = Meld(m_Pairs[i], root);
+        }
+        return root;
+    }
+
+    std::vector<Node> m_Nodes;  // Node pool indexed by id
+    std::vector<int> m_Queued;  // Ids pushed since the last clear
+    std::vector<int> m_Pairs;   // Scratch buffer for MergePairs
+    int m_Root = none;
+    std::size_t m_Size = 0;
+};
+
+#endif
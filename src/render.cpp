@@ -224,14 +224,15 @@ io2d::interpreted_path Render::PathLine() const {
  * @return The path as an io2d::interpreted_path.
  */
 io2d::interpreted_path Render::PathFromWay(const Model::Way& way) const {
-    if (way.nodes.empty()) return {};
+    const auto way_nodes = m_Model.WayNodes(way);
+    if (way_nodes.empty()) return {};
 
     const auto nodes = m_Model.Nodes().data();
 
     auto pb = io2d::path_builder{};
     pb.matrix(m_Matrix);
-    pb.new_figure(ToPoint2D(nodes[way.nodes.front()]));
-    for (auto it = ++way.nodes.begin(); it != std::end(way.nodes); ++it) {
+    pb.new_figure(ToPoint2D(nodes[way_nodes.front()]));
+    for (auto it = way_nodes.begin() + 1; it != way_nodes.end(); ++it) {
         pb.line(ToPoint2D(nodes[*it]));
     }
     return io2d::interpreted_path{pb};
@@ -250,18 +251,19 @@ io2d::interpreted_path Render::PathFromMP(const Model::Multipolygon& mp) const {
     pb.matrix(m_Matrix);
 
     auto commit = [&](const Model::Way& way) {
-        if (way.nodes.empty()) return;
-        pb.new_figure(ToPoint2D(nodes[way.nodes.front()]));
-        for (auto it = ++way.nodes.begin(); it != std::end(way.nodes); ++it) {
+        const auto way_nodes = m_Model.WayNodes(way);
+        if (way_nodes.empty()) return;
+        pb.new_figure(ToPoint2D(nodes[way_nodes.front()]));
+        for (auto it = way_nodes.begin() + 1; it != way_nodes.end(); ++it) {
             pb.line(ToPoint2D(nodes[*it]));
         }
         pb.close_figure();
     };
 
-    for (auto way_num : mp.outer) {
+    for (auto way_num : m_Model.OuterWays(mp)) {
         commit(ways[way_num]);
     }
-    for (auto way_num : mp.inner) {
+    for (auto way_num : m_Model.InnerWays(mp)) {
         commit(ways[way_num]);
     }
 
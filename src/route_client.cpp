@@ -0,0 +1,82 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Sends route queries to a running route server and prints the results.
+ *
+ * Usage: route_client socket_path [queries.txt]
+ *
+ * The queries are read from the file, or from stdin if no file is given, in the line format of
+ * the batch mode ("start_x start_y end_x end_y"). They are pipelined over a single connection;
+ * the results are printed in the order of the queries.
+ */
+int main(int argc, const char** argv) {
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: route_client socket_path [queries.txt]" << std::endl;
+        return -1;
+    }
+
+    std::ifstream file;
+    if (argc == 3) {
+        file.open(argv[2]);
+        if (!file) {
+            std::cerr << "Failed to open query file: " << argv[2] << std::endl;
+            return -1;
+        }
+    }
+    std::istream& queries = argc == 3 ? file : std::cin;
+
+    // Connect to the server
+    sockaddr_un address{};
+    const std::string socket_path = argv[1];
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << socket_path << std::endl;
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    const int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0 || connect(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Failed to connect to " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+
+    // Send the queries from a second thread, so that neither side blocks on a full socket buffer
+    std::thread sender{[&] {
+        std::string line;
+        while (std::getline(queries, line)) {
+            line += '\n';
+            for (std::size_t sent = 0; sent < line.size();) {
+                const auto written = send(server, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+                if (written < 0) {
+                    if (errno == EINTR) continue;
+                    shutdown(server, SHUT_WR);
+                    return;
+                }
+                sent += written;
+            }
+        }
+        shutdown(server, SHUT_WR);  // The server answers the remaining queries and closes the connection
+    }};
+
+    // Print the results until the server closes the connection
+    char buffer[1 << 16];
+    for (;;) {
+        const auto received = recv(server, buffer, sizeof(buffer), 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) break;
+        std::cout.write(buffer, received);
+    }
+    std::cout.flush();
+
+    sender.join();
+    close(server);
+    return 0;
+}
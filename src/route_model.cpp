@@ -1,102 +1,143 @@
 #include "route_model.h"
+#include "map_snapshot.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
-RouteModel::RouteModel(const std::vector<std::byte>& xml) : Model(xml) {
-    // Create RouteModel nodes from the base Model nodes
-    int counter = 0;  // Counter for assigning node indices
-    for (const Model::Node& node : this->Nodes()) {
-        m_Nodes.emplace_back(Node(counter, this, node));  // Create and add Node
-        counter++;  // Increment counter
+RouteModel::RouteModel(Span<const std::byte> xml, std::size_t threads, Profile profile, const ClipRegion* clip)
+    : Model(xml, threads, profile, clip) {
+    if (MapSnapshot::Matches(xml)) {
+        MapSnapshot::ReadGraph(xml, *this);  // Restore the compiled routing graph
+    } else {
+        BuildAdjacencyGraph();  // Create the routing graph
     }
-    CreateNodeToRoadHashmap();  // Create the node-to-road hashmap
+    BuildSpatialIndex();  // Index the routable nodes for snapping
+    if (clip && m_SpatialIndex.Empty()) {
+        throw std::invalid_argument("Clip region holds no routable road of the map.");
+    }
+}
+
+/**
+ * Applies an osmChange document to the model and rebuilds the routing graph and the spatial index.
+ * @param osc The osmChange document, plain or compressed with gzip or bzip2.
+ * @param profile What the model keeps of OSM data, as when it was loaded.
+ * @param clip The region the model was clipped to when loaded, or nullptr.
+ * @return The number of elements that changed the model.
+ */
+std::size_t RouteModel::ApplyChange(Span<const std::byte> osc, Profile profile, const ClipRegion* clip) {
+    const auto changes = Model::ApplyChange(osc, profile, clip);
+    BuildAdjacencyGraph();
+    BuildSpatialIndex();
+    return changes;
 }
 
 /**
- * Creates a hashmap that maps node indices to the roads they belong to.
+ * Builds the compressed-sparse-row adjacency graph from consecutive nodes of the roads.
+ * Every pair of consecutive way nodes yields an edge in both directions; edges shared by
+ * several roads are stored once. The edges are placed by source node with a counting sort,
+ * then every row is sorted by target node, so the cost stays linear in the number of edges.
  */
-void RouteModel::CreateNodeToRoadHashmap() {
-    for (const Model::Road& road : Roads()) {
-        // Skip footways (pedestrian paths) as they are not relevant for route planning
-        if (road.type != Model::Road::Type::Footway) {
-            for (int node_idx : Ways()[road.way].nodes) {
-                // Initialize the node-to-road mapping if it doesn't exist
-                if (node_to_road.find(node_idx) == node_to_road.end()) {
-                    node_to_road[node_idx] = std::vector<const Model::Road*>();
+void RouteModel::BuildAdjacencyGraph() {
+    const auto& nodes = Nodes();
+    const auto node_count = nodes.size();
+    const auto for_each_edge = [&](auto&& body) {
+        for (const Model::Road& road : Roads()) {
+            // Skip footways (pedestrian paths) as they are not relevant for route planning
+            if (road.type == Model::Road::Type::Footway) {
+                continue;
+            }
+            const auto way_nodes = WayNodes(Ways()[road.way]);
+            for (std::size_t i = 1; i < way_nodes.size(); ++i) {
+                const int from = way_nodes[i - 1];
+                const int to = way_nodes[i];
+                if (from != to) {
+                    body(from, to);
+                    body(to, from);
                 }
-                // Add the road to the node's list of roads
-                node_to_road[node_idx].push_back(&road);
             }
         }
+    };
+
+    // Group the edges by source node
+    std::vector<int> offsets(node_count + 1, 0);
+    for_each_edge([&](int from, int) { ++offsets[from + 1]; });
+    for (std::size_t i = 0; i < node_count; ++i) {
+        offsets[i + 1] += offsets[i];
     }
-}
+    std::vector<int> targets(offsets.back());
+    auto next = offsets;
+    for_each_edge([&](int from, int to) { targets[next[from]++] = to; });
+    next = {};
 
-/**
- * Finds a neighboring node from a list of node indices.
- * @param node_indices The list of node indices to search.
- * @return A pointer to the closest neighboring node, or nullptr if none is found.
- */
-RouteModel::Node* RouteModel::Node::FindNeighbor(const std::vector<int>& node_indices) {
-    Node* closest_node = nullptr;  // Pointer to the closest node
-    Node node;  // Temporary node for distance calculations
+    // Sort the edges of every node by target and drop duplicates, closing the gaps they leave
+    m_AdjOffsets.assign(node_count + 1, 0);
+    int end = 0;
+    for (std::size_t i = 0; i < node_count; ++i) {
+        const auto first = targets.begin() + offsets[i];
+        const auto last = targets.begin() + offsets[i + 1];
+        std::sort(first, last);
+        const auto unique_last = std::unique(first, last);
+        if (offsets[i] != end) {
+            std::copy(first, unique_last, targets.begin() + end);
+        }
+        end += static_cast<int>(unique_last - first);
+        m_AdjOffsets[i + 1] = end;
+    }
+    targets.resize(end);
+    m_AdjTargets = std::move(targets);
 
-    for (int node_index : node_indices) {
-        node = parent_model->SNodes()[node_index];  // Get the node from the parent model
-        // Check if the node is not the current node and has not been visited
-        if (this->distance(node) != 0 && !node.visited) {
-            // Update the closest node if this node is closer
-            if (closest_node == nullptr || this->distance(node) < this->distance(*closest_node)) {
-                closest_node = &parent_model->SNodes()[node_index];
-            }
+    m_AdjLengths.resize(m_AdjTargets.size());
+    for (std::size_t i = 0; i < node_count; ++i) {
+        for (int edge = m_AdjOffsets[i]; edge < m_AdjOffsets[i + 1]; ++edge) {
+            m_AdjLengths[edge] = nodes[i].distance(nodes[m_AdjTargets[edge]]);
         }
     }
-    return closest_node;
 }
 
 /**
- * Finds and populates the list of neighboring nodes.
+ * Builds the spatial index over the routable nodes (nodes with at least one edge).
  */
-void RouteModel::Node::FindNeighbors() {
-    // Iterate over all roads connected to this node
-    for (const auto& road : parent_model->node_to_road[this->index]) {
-        // Find the closest neighbor from the nodes of the current road
-        RouteModel::Node* new_neighbor = this->FindNeighbor(parent_model->Ways()[road->way].nodes);
-        if (new_neighbor) {
-            // Add the neighbor to the list of neighbors
-            this->neighbors.emplace_back(new_neighbor);
+void RouteModel::BuildSpatialIndex() {
+    std::vector<SpatialIndex::Point> points;
+    for (const Node& node : Nodes()) {
+        const int idx = node.Index();
+        if (m_AdjOffsets[idx + 1] > m_AdjOffsets[idx]) {
+            points.push_back({node.x, node.y, idx});
         }
     }
+    m_SpatialIndex = SpatialIndex(std::move(points));
 }
 
 /**
- * Finds the closest node to the given coordinates.
+ * Finds the routable node closest to the given coordinates.
  * @param x The x-coordinate.
  * @param y The y-coordinate.
- * @return A reference to the closest node.
+ * @return The index of the closest node, or kNoNode if no node has an edge.
  */
-RouteModel::Node& RouteModel::FindClosestNode(float x, float y) {
-    Node input;  // Temporary node for the input coordinates
-    input.x = x;
-    input.y = y;
-
-    float min_dist = std::numeric_limits<float>::max();  // Initialize minimum distance to a large value
-    float dist;  // Distance between the input node and the current node
-    int closest_idx = 0;  // Index of the closest node
+int RouteModel::FindClosestNode(float x, float y) const {
+    const int closest_idx = m_SpatialIndex.Nearest(x, y);  // Negative if the index is empty
+    return closest_idx < 0 ? kNoNode : closest_idx;
+}
 
-    // Iterate over all roads (excluding footways)
-    for (const Model::Road& road : Roads()) {
-        if (road.type != Model::Road::Type::Footway) {
-            // Iterate over all nodes in the current road
-            for (int node_idx : Ways()[road.way].nodes) {
-                dist = input.distance(SNodes()[node_idx]);  // Calculate the distance
-                // Update the closest node if this node is closer
-                if (dist < min_dist) {
-                    closest_idx = node_idx;
-                    min_dist = dist;
-                }
-            }
-        }
-    }
+/**
+ * Finds the k routable nodes closest to the given coordinates.
+ * @param x The x-coordinate.
+ * @param y The y-coordinate.
+ * @param k The number of nodes to return.
+ * @return The indices of up to k nodes, nearest first.
+ */
+std::vector<int> RouteModel::FindClosestNodes(float x, float y, std::size_t k) const {
+    return m_SpatialIndex.KNearest(x, y, k);
+}
 
-    // Return the closest node
-    return SNodes()[closest_idx];
-}
\ No newline at end of file
+/**
+ * Finds all routable nodes within a radius of the given coordinates.
+ * @param x The x-coordinate.
+ * @param y The y-coordinate.
+ * @param radius The search radius, in the model's normalized units.
+ * @return The indices of the nodes, nearest first.
+ */
+std::vector<int> RouteModel::FindNodesWithinRadius(float x, float y, float radius) const {
+    return m_SpatialIndex.WithinRadius(x, y, radius);
+}
@@ -4,96 +4,127 @@
 #include <cmath>
 #include <iostream>
 #include <limits>
-#include <unordered_map>
 #include <vector>
 #include <cstddef>  // For std::byte
 
 #include "model.h"
+#include "spatial_index.h"
+#include "span.h"
 
 /**
  * The RouteModel class extends the Model class to support route planning.
+ * Once constructed it is immutable: per-query search state lives in a SearchContext,
+ * so one RouteModel can be shared by any number of concurrent searches.
  */
 class RouteModel : public Model {
 public:
+    // Nodes of the routing graph are the nodes of the map; Index() identifies them in the graph.
+    using Node = Model::Node;
+
+    // Returned by FindClosestNode() when the model has no routable node.
+    static constexpr int kNoNode = -1;
+
     /**
-     * The Node class represents a node in the route planning graph.
+     * Constructor: Initializes the RouteModel with OSM XML data, parsed in place, or with a
+     * compiled map snapshot (see MapSnapshot).
+     * @param xml A read-only view of the OSM XML data or the snapshot, e.g. a MappedFile. It is not copied.
+     * @param threads The number of threads parsing the XML data; 0 uses one per hardware thread.
+     * @param profile What to keep of OSM data; Profile::Routing keeps only the roads and their nodes.
+     * @param clip The region of OSM data to keep, or nullptr for all of it.
+     * @throws std::invalid_argument if the clip region leaves no routable node.
      */
-    class Node : public Model::Node {
-    public:
-        Node* parent = nullptr;  // Pointer to the parent node in the search tree
-        float h_value = std::numeric_limits<float>::max();  // Heuristic value (estimated cost to goal)
-        float g_value = 0.0;  // Cost from the start node to this node
-        bool visited = false;  // Whether the node has been visited during the search
-        std::vector<Node*> neighbors;  // List of neighboring nodes
-
-        /**
-         * Finds and populates the list of neighboring nodes.
-         */
-        void FindNeighbors();
-
-        /**
-         * Calculates the Euclidean distance to another node.
-         * @param other The other node.
-         * @return The distance between this node and the other node.
-         */
-        float distance(const Node& other) const {
-            return std::sqrt(std::pow((x - other.x), 2) + std::pow((y - other.y), 2));
-        }
-
-        // Default constructor
-        Node() = default;
-
-        /**
-         * Constructor: Initializes a Node with an index, parent model, and base Model::Node.
-         * @param idx The index of the node.
-         * @param search_model The parent RouteModel.
-         * @param node The base Model::Node.
-         */
-        Node(int idx, RouteModel* search_model, const Model::Node& node)
-            : Model::Node(node), parent_model(search_model), index(idx) {}
-
-    private:
-        int index;  // Index of the node in the parent model's node list
-        RouteModel* parent_model = nullptr;  // Pointer to the parent RouteModel
-
-        /**
-         * Finds a neighboring node from a list of node indices.
-         * @param node_indices The list of node indices to search.
-         * @return A pointer to the neighboring node, or nullptr if not found.
-         */
-        Node* FindNeighbor(const std::vector<int>& node_indices);
-    };
+    RouteModel(Span<const std::byte> xml, std::size_t threads = 0, Profile profile = Profile::Full,
+               const ClipRegion* clip = nullptr);
 
     /**
-     * Constructor: Initializes the RouteModel with OSM XML data.
+     * Constructor: Initializes the RouteModel with OSM XML data held in a buffer.
      * @param xml The OSM XML data as a vector of bytes.
      */
-    RouteModel(const std::vector<std::byte>& xml);
+    RouteModel(const std::vector<std::byte>& xml) : RouteModel(Span<const std::byte>{xml.data(), xml.size()}) {}
+
+    /**
+     * Applies an osmChange document to the model in place (see Model::ApplyChange()), then
+     * rebuilds the whole routing graph and spatial index, in time linear in the size of the map.
+     * @param osc The osmChange document, plain or compressed with gzip or bzip2.
+     * @param profile What the model keeps of OSM data, as when it was loaded.
+     * @param clip The region the model was clipped to when loaded, or nullptr.
+     * @return The number of elements that changed the model.
+     * @throws std::logic_error, leaving the model unchanged, if the document is malformed.
+     */
+    std::size_t ApplyChange(Span<const std::byte> osc, Profile profile = Profile::Full,
+                            const ClipRegion* clip = nullptr);
+
+    /**
+     * Finds the routable node closest to the given coordinates.
+     * @param x The x-coordinate.
+     * @param y The y-coordinate.
+     * @return The index of the closest node, or kNoNode if no node has an edge.
+     */
+    int FindClosestNode(float x, float y) const;
+
+    /**
+     * Finds the k routable nodes closest to the given coordinates.
+     * @param x The x-coordinate.
+     * @param y The y-coordinate.
+     * @param k The number of nodes to return.
+     * @return The indices of up to k nodes, nearest first.
+     */
+    std::vector<int> FindClosestNodes(float x, float y, std::size_t k) const;
 
     /**
-     * Finds the closest node to the given coordinates.
+     * Finds all routable nodes within a radius of the given coordinates.
      * @param x The x-coordinate.
      * @param y The y-coordinate.
-     * @return A reference to the closest node.
+     * @param radius The search radius, in the model's normalized units.
+     * @return The indices of the nodes, nearest first.
      */
-    Node& FindClosestNode(float x, float y);
+    std::vector<int> FindNodesWithinRadius(float x, float y, float radius) const;
 
     /**
-     * Returns the list of nodes in the model.
+     * Returns the list of nodes in the model, the same list as Nodes().
      * @return A reference to the list of nodes.
      */
-    std::vector<Node>& SNodes() { return m_Nodes; }
+    const std::vector<Node>& SNodes() const noexcept { return Nodes(); }
 
-    std::vector<Node> path;  // The calculated path from start to goal
+    /**
+     * Returns the indices of the nodes adjacent to a node in the routing graph.
+     * @param node_idx The index of the node.
+     * @return A view of the neighbor indices, parallel to NeighborDistances().
+     */
+    Span<const int> Neighbors(int node_idx) const {
+        return {m_AdjTargets.data() + m_AdjOffsets[node_idx], m_AdjTargets.data() + m_AdjOffsets[node_idx + 1]};
+    }
+
+    /**
+     * Returns the lengths of the edges leaving a node in the routing graph.
+     * @param node_idx The index of the node.
+     * @return A view of the edge lengths, parallel to Neighbors().
+     */
+    Span<const float> NeighborDistances(int node_idx) const {
+        return {m_AdjLengths.data() + m_AdjOffsets[node_idx], m_AdjLengths.data() + m_AdjOffsets[node_idx + 1]};
+    }
+
+    std::vector<Node> path;  // The path to render, filled by RoutePlanners bound to a mutable model
 
 private:
+    friend class MapSnapshot;
+
+    /**
+     * Builds the compressed-sparse-row adjacency graph from consecutive nodes of the roads.
+     */
+    void BuildAdjacencyGraph();
+
     /**
-     * Creates a hashmap that maps node indices to the roads they belong to.
+     * Builds the spatial index over the routable nodes (nodes with at least one edge).
      */
-    void CreateNodeToRoadHashmap();
+    void BuildSpatialIndex();
+
+    // Routing graph in CSR form: the edges of node i are [m_AdjOffsets[i], m_AdjOffsets[i + 1])
+    std::vector<int> m_AdjOffsets;    // Edge range start per node, plus a final sentinel
+    std::vector<int> m_AdjTargets;    // Target node index per edge
+    std::vector<float> m_AdjLengths;  // Edge length per edge, in the model's normalized units
 
-    std::unordered_map<int, std::vector<const Model::Road*>> node_to_road;  // Hashmap for node-to-road mapping
-    std::vector<Node> m_Nodes;  // List of nodes in the model
+    SpatialIndex m_SpatialIndex;  // Grid over the routable nodes for snapping coordinates
 };
 
 #endif
\ No newline at end of file
@@ -1,16 +1,51 @@
 #include "route_planner.h"
 #include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "isochrone.h"
 
 /**
  * Constructor: Initializes the RoutePlanner with start and end coordinates.
+ * The planner owns its search context and stores the found path in model.path.
  * @param model The RouteModel containing map data.
  * @param start_x The x-coordinate of the start point.
  * @param start_y The y-coordinate of the start point.
  * @param end_x The x-coordinate of the end point.
  * @param end_y The y-coordinate of the end point.
+ * @param queue_type The priority queue engine backing the open list.
  */
-RoutePlanner::RoutePlanner(RouteModel& model, float start_x, float start_y, float end_x, float end_y)
-    : m_Model(model) {
+RoutePlanner::RoutePlanner(RouteModel& model, float start_x, float start_y, float end_x, float end_y,
+                           QueueType queue_type)
+    : m_OwnedContext(std::make_unique<SearchContext>(model.SNodes().size(), queue_type)),
+      m_Context(*m_OwnedContext),
+      m_Model(model),
+      m_PathSink(&model) {
+    FindEndpoints(start_x, start_y, end_x, end_y);
+}
+
+/**
+ * Constructor: Initializes a RoutePlanner on a shared, read-only RouteModel.
+ * @param model The shared RouteModel containing map data.
+ * @param context The per-thread search state; must outlive the planner.
+ * @param start_x The x-coordinate of the start point.
+ * @param start_y The y-coordinate of the start point.
+ * @param end_x The x-coordinate of the end point.
+ * @param end_y The y-coordinate of the end point.
+ */
+RoutePlanner::RoutePlanner(const RouteModel& model, SearchContext& context,
+                           float start_x, float start_y, float end_x, float end_y)
+    : m_Context(context), m_Model(model) {
+    FindEndpoints(start_x, start_y, end_x, end_y);
+}
+
+/**
+ * Snaps the start and end coordinates to the closest nodes and prepares the context.
+ * @param start_x The x-coordinate of the start point.
+ * @param start_y The y-coordinate of the start point.
+ * @param end_x The x-coordinate of the end point.
+ * @param end_y The y-coordinate of the end point.
+ */
+void RoutePlanner::FindEndpoints(float start_x, float start_y, float end_x, float end_y) {
     // Convert inputs to percentage (assuming coordinates are in the range 0-100)
     start_x *= 0.01f;
     start_y *= 0.01f;
@@ -18,8 +53,25 @@ RoutePlanner::RoutePlanner(RouteModel& model, float start_x, float start_y, floa
     end_y *= 0.01f;
 
     // Find the closest nodes to the start and end coordinates
-    this->start_node = &m_Model.FindClosestNode(start_x, start_y);
-    this->end_node = &m_Model.FindClosestNode(end_x, end_y);
+    const int start_idx = m_Model.FindClosestNode(start_x, start_y);
+    const int end_idx = m_Model.FindClosestNode(end_x, end_y);
+    if (start_idx == RouteModel::kNoNode || end_idx == RouteModel::kNoNode) {
+        return;  // No routable node: searches find nothing
+    }
+    this->start_node = &m_Model.SNodes()[start_idx];
+    this->end_node = &m_Model.SNodes()[end_idx];
+
+    ResetSearch();
+}
+
+/**
+ * Starts a new query in the search context, with only the start node labelled and queued.
+ */
+void RoutePlanner::ResetSearch() {
+    const int start_idx = this->start_node->Index();
+    m_Context.Prepare(m_Model.SNodes().size());
+    m_Context.SetLabel(start_idx, 0.0f, SearchContext::kNoParent);
+    std::visit([&](auto& queue) { queue.Push(start_idx, CalculateHValue(this->start_node)); }, m_Context.Queue());
 }
 
 /**
@@ -27,39 +79,67 @@ RoutePlanner::RoutePlanner(RouteModel& model, float start_x, float start_y, floa
  * @param node The node for which to calculate the heuristic.
  * @return The heuristic value.
  */
-float RoutePlanner::CalculateHValue(const RouteModel::Node* node) {
-    return node->distance(*this->end_node);  // Euclidean distance to the end node
+float RoutePlanner::CalculateHValue(const RouteModel::Node* node) const {
+    return LowerBound(*node, *this->end_node);
+}
+
+/**
+ * Returns a lower bound of the distance between two nodes: the Euclidean distance, or the
+ * landmark bound if landmarks are set and it is larger. Both bounds are consistent, so their
+ * maximum is too.
+ * @param from One node.
+ * @param to The other node.
+ * @return The bound, in the model's normalized units.
+ */
+float RoutePlanner::LowerBound(const RouteModel::Node& from, const RouteModel::Node& to) const {
+    const float euclidean = from.distance(to);
+    if (!m_Landmarks) {
+        return euclidean;
+    }
+    return std::max(euclidean, m_Landmarks->LowerBound(from.Index(), to.Index()));
 }
 
 /**
  * Adds neighboring nodes to the open list for exploration.
  * @param current_node The current node being explored.
  */
-void RoutePlanner::AddNeighbors(RouteModel::Node* current_node) {
-    current_node->FindNeighbors();  // Populate the neighbors vector
-    for (auto neighbor : current_node->neighbors) {
-        neighbor->parent = current_node;  // Set the parent of the neighbor
-        neighbor->g_value = current_node->g_value + neighbor->distance(*current_node);  // Update g-value
-        neighbor->h_value = CalculateHValue(neighbor);  // Calculate h-value
-        neighbor->visited = true;  // Mark the neighbor as visited
-        this->open_list.emplace_back(neighbor);  // Add the neighbor to the open list
-    }
+void RoutePlanner::AddNeighbors(const RouteModel::Node* current_node) {
+    const auto& nodes = m_Model.SNodes();
+    const int current_idx = current_node->Index();
+    const float current_g = m_Context.G(current_idx);
+    const auto neighbor_indices = m_Model.Neighbors(current_idx);
+    const auto edge_lengths = m_Model.NeighborDistances(current_idx);
+
+    std::visit([&](auto& queue) {
+        // Walk the contiguous edge range of the current node
+        for (std::size_t i = 0; i < neighbor_indices.size(); ++i) {
+            const int neighbor_idx = neighbor_indices[i];
+            const bool reached = m_Context.Reached(neighbor_idx);
+            // Skip nodes that are already expanded
+            if (reached && !queue.Contains(neighbor_idx)) {
+                continue;
+            }
+            const float g_value = current_g + edge_lengths[i];
+            // Skip queued nodes that are already reached through a path that is at least as short
+            if (reached && g_value >= m_Context.G(neighbor_idx)) {
+                continue;
+            }
+            m_Context.SetLabel(neighbor_idx, g_value, current_idx);
+
+            // Queue the neighbor, or move it up if it is already queued
+            queue.PushOrDecrease(neighbor_idx, g_value + CalculateHValue(&nodes[neighbor_idx]));
+        }
+    }, m_Context.Queue());
 }
 
 /**
- * Selects the next node to explore from the open list.
+ * Removes the node with the lowest f-value (g-value + h-value) from the open list.
  * @return A pointer to the next node.
  */
-RouteModel::Node* RoutePlanner::NextNode() {
-    // Sort the open list in descending order of f-value (g-value + h-value)
-    std::sort(this->open_list.begin(), this->open_list.end(),
-              [](const RouteModel::Node* v1, const RouteModel::Node* v2) {
-                  return (v1->h_value + v1->g_value) > (v2->h_value + v2->g_value);
-              });
-
-    auto next_node = this->open_list.back();  // Get the node with the lowest f-value
-    this->open_list.pop_back();  // Remove the node from the open list
-    return next_node;
+const RouteModel::Node* RoutePlanner::NextNode() {
+    // Pop the node with the lowest f-value in O(log n)
+    const int next_index = std::visit([](auto& queue) { return queue.Pop(); }, m_Context.Queue());
+    return &m_Model.SNodes()[next_index];
 }
 
 /**
@@ -67,15 +147,17 @@ RouteModel::Node* RoutePlanner::NextNode() {
  * @param current_node The final node in the path.
  * @return A vector of nodes representing the path.
  */
-std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(RouteModel::Node* current_node) {
+std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(const RouteModel::Node* current_node) {
+    const auto& nodes = m_Model.SNodes();
     distance = 0.0f;  // Initialize the total distance
     std::vector<RouteModel::Node> path_found;
 
     // Traverse the path from the end node to the start node
     while (current_node != this->start_node) {
+        const RouteModel::Node* parent = &nodes[m_Context.Parent(current_node->Index())];
         path_found.push_back(*current_node);  // Add the current node to the path
-        distance += current_node->distance(*current_node->parent);  // Add the distance to the parent node
-        current_node = current_node->parent;  // Move to the parent node
+        distance += current_node->distance(*parent);  // Add the distance to the parent node
+        current_node = parent;  // Move to the parent node
     }
     path_found.push_back(*this->start_node);  // Add the start node to the path
 
@@ -85,26 +167,229 @@ std::vector<RouteModel::Node> RoutePlanner::ConstructFinalPath(RouteModel::Node*
     return path_found;
 }
 
+/**
+ * Runs Dijkstra's algorithm from the start node to every node within a distance. Nodes are
+ * expanded in order of their distance, so the search stops at the first node beyond the cutoff.
+ * @param max_distance The largest distance of interest, in meters; infinity for no cutoff.
+ * @return The reached nodes in order of their distance, the start node first.
+ */
+std::vector<RoutePlanner::ReachableNode> RoutePlanner::OneToAll(float max_distance) {
+    const float scale = m_Model.MetricScale();
+    const float limit = max_distance / scale;  // Cutoff in the model's normalized units
+    std::vector<ReachableNode> reached;
+    m_SettledNodes = 0;
+    if (!this->start_node) {
+        return reached;  // No routable node
+    }
+    const int start_idx = this->start_node->Index();
+
+    m_Context.Prepare(m_Model.SNodes().size());
+    m_Context.SetLabel(start_idx, 0.0f, SearchContext::kNoParent);
+    std::visit([&](auto& queue) {
+        queue.Push(start_idx, 0.0f);
+        while (!queue.Empty() && queue.TopKey() <= limit) {
+            const int current_idx = queue.Pop();
+            ++m_SettledNodes;
+            const float current_g = m_Context.G(current_idx);
+            reached.push_back({current_idx, current_g * scale, m_Context.Parent(current_idx)});
+
+            const auto neighbor_indices = m_Model.Neighbors(current_idx);
+            const auto edge_lengths = m_Model.NeighborDistances(current_idx);
+            for (std::size_t i = 0; i < neighbor_indices.size(); ++i) {
+                const int neighbor_idx = neighbor_indices[i];
+                const bool reached_before = m_Context.Reached(neighbor_idx);
+                if (reached_before && !queue.Contains(neighbor_idx)) {
+                    continue;  // Already settled
+                }
+                const float g_value = current_g + edge_lengths[i];
+                if (reached_before && g_value >= m_Context.G(neighbor_idx)) {
+                    continue;
+                }
+                m_Context.SetLabel(neighbor_idx, g_value, current_idx);
+                queue.PushOrDecrease(neighbor_idx, g_value);
+            }
+        }
+    }, m_Context.Queue());
+    return reached;
+}
+
+/**
+ * Computes the area reachable from the start node within a distance (an isochrone).
+ * @param max_distance The distance, in meters.
+ * @param resolution The size of the grid cells the area is traced on, in meters.
+ * @return The outline of the area as a counter-clockwise polygon in model coordinates.
+ */
+std::vector<Model::Node> RoutePlanner::Isochrone(float max_distance, float resolution) {
+    return TraceIsochrone(m_Model, OneToAll(max_distance), max_distance, resolution);
+}
+
 /**
  * Performs the A* search algorithm to find the shortest path.
  */
 void RoutePlanner::AStarSearch() {
-    RouteModel::Node* current_node = nullptr;
+    distance = 0.0f;
+    m_Path.clear();
+    m_SettledNodes = 0;
+
+    if (!this->start_node) {
+        return;  // No routable node, so no path
+    } else if (m_SearchMode == SearchMode::Bidirectional) {
+        BidirectionalSearch();
+    } else if (m_SearchMode == SearchMode::ContractionHierarchy) {
+        HierarchySearch();
+    } else {
+        const RouteModel::Node* current_node = nullptr;
 
-    // Initialize the start node
-    this->start_node->visited = true;
-    this->open_list.push_back(this->start_node);
+        // Initialize the search with the start node
+        ResetSearch();
 
-    // Explore nodes until the open list is empty or the end node is found
-    while (!this->open_list.empty()) {
-        current_node = NextNode();  // Get the next node to explore
+        // Explore nodes until the open list is empty or the end node is found
+        while (!std::visit([](const auto& queue) { return queue.Empty(); }, m_Context.Queue())) {
+            current_node = NextNode();  // Get the next node to explore
+            ++m_SettledNodes;
 
-        // Check if the current node is the end node
-        if (current_node->x == this->end_node->x && current_node->y == this->end_node->y) {
-            m_Model.path = ConstructFinalPath(current_node);  // Construct and store the final path
-            break;
+            // Check if the current node is the end node
+            if (current_node == this->end_node) {
+                m_Path = ConstructFinalPath(current_node);  // Construct and store the final path
+                break;
+            }
+
+            AddNeighbors(current_node);  // Add neighbors of the current node to the open list
         }
+    }
 
-        AddNeighbors(current_node);  // Add neighbors of the current node to the open list
+    if (m_PathSink) {
+        m_PathSink->path = m_Path;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * Runs A* from both ends at once. The forward search uses the potential
+ * p(v) = (h_end(v) - h_start(v)) / 2, with h the bounds of LowerBound(), and the backward
+ * search -p(v); these average potentials are consistent for both directions, so each search
+ * settles nodes at their final distance and the two open lists can be compared directly. Every
+ * time an edge reaches a node the other search has labelled, the path through it is a candidate.
+ * The search stops once the sum of the two smallest keys reaches the best candidate: no
+ * unexplored path can be shorter.
+ */
+void RoutePlanner::BidirectionalSearch() {
+    const auto& nodes = m_Model.SNodes();
+    const int start_idx = this->start_node->Index();
+    const int end_idx = this->end_node->Index();
+    SearchContext& forward = m_Context;
+    SearchContext& backward = m_Context.Backward();
+
+    const auto potential = [&](int node_idx) {
+        return 0.5f * (LowerBound(nodes[node_idx], *this->end_node) - LowerBound(nodes[node_idx], *this->start_node));
+    };
+
+    forward.Prepare(nodes.size());
+    backward.Prepare(nodes.size());
+    forward.SetLabel(start_idx, 0.0f, SearchContext::kNoParent);
+    backward.SetLabel(end_idx, 0.0f, SearchContext::kNoParent);
+
+    float best = std::numeric_limits<float>::infinity();  // Length of the shortest path found so far
+    int meeting_idx = start_idx == end_idx ? start_idx : SearchContext::kNoParent;
+    if (meeting_idx != SearchContext::kNoParent) {
+        best = 0.0f;
+    }
+
+    std::visit([&](auto& forward_queue, auto& backward_queue) {
+        forward_queue.Push(start_idx, potential(start_idx));
+        backward_queue.Push(end_idx, -potential(end_idx));
+
+        // Expands the top node of one direction, relaxing its edges and looking for meeting points
+        const auto expand = [&](SearchContext& context, auto& queue, const SearchContext& other, float sign) {
+            const int current_idx = queue.Pop();
+            ++m_SettledNodes;
+            const float current_g = context.G(current_idx);
+            const auto neighbor_indices = m_Model.Neighbors(current_idx);
+            const auto edge_lengths = m_Model.NeighborDistances(current_idx);
+            for (std::size_t i = 0; i < neighbor_indices.size(); ++i) {
+                const int neighbor_idx = neighbor_indices[i];
+                const bool reached = context.Reached(neighbor_idx);
+                if (reached && !queue.Contains(neighbor_idx)) {
+                    continue;  // Already settled in this direction
+                }
+                const float g_value = current_g + edge_lengths[i];
+                if (reached && g_value >= context.G(neighbor_idx)) {
+                    continue;
+                }
+                context.SetLabel(neighbor_idx, g_value, current_idx);
+                queue.PushOrDecrease(neighbor_idx, g_value + sign * potential(neighbor_idx));
+
+                if (other.Reached(neighbor_idx) && g_value + other.G(neighbor_idx) < best) {
+                    best = g_value + other.G(neighbor_idx);
+                    meeting_idx = neighbor_idx;
+                }
+            }
+        };
+
+        while (!forward_queue.Empty() && !backward_queue.Empty()) {
+            const float forward_key = forward_queue.TopKey();
+            const float backward_key = backward_queue.TopKey();
+            if (forward_key + backward_key >= best) {
+                break;
+            }
+            if (forward_key <= backward_key) {
+                expand(forward, forward_queue, backward, 1.0f);
+            } else {
+                expand(backward, backward_queue, forward, -1.0f);
+            }
+        }
+    }, forward.Queue(), backward.Queue());
+
+    if (meeting_idx != SearchContext::kNoParent) {
+        m_Path = ConstructBidirectionalPath(meeting_idx);
+    }
+}
+
+/**
+ * Joins the forward and backward search trees at the meeting node into a start-to-end path.
+ * @param meeting_idx The node where the two searches met on the shortest path.
+ * @return A vector of nodes representing the path.
+ */
+std::vector<RouteModel::Node> RoutePlanner::ConstructBidirectionalPath(int meeting_idx) {
+    const auto& nodes = m_Model.SNodes();
+    SearchContext& backward = m_Context.Backward();
+
+    // Forward tree: start ... meeting node, then the backward tree: meeting node ... end
+    std::vector<RouteModel::Node> path_found = ConstructFinalPath(&nodes[meeting_idx]);
+    for (int node_idx = meeting_idx; node_idx != this->end_node->Index(); node_idx = backward.Parent(node_idx)) {
+        path_found.push_back(nodes[backward.Parent(node_idx)]);
+    }
+
+    distance = PathDistance(path_found);
+    return path_found;
+}
+
+/**
+ * Queries the contraction hierarchy and stores its path. The hierarchy must have been
+ * built for the model of the planner.
+ */
+void RoutePlanner::HierarchySearch() {
+    const auto& nodes = m_Model.SNodes();
+    if (!m_Hierarchy || m_Hierarchy->NodeCount() != nodes.size()) {
+        throw std::logic_error("No contraction hierarchy was set for this map.");
+    }
+    const auto route = m_Hierarchy->Query(this->start_node->Index(), this->end_node->Index(), m_Context);
+    m_SettledNodes = route.settled_nodes;
+    m_Path.reserve(route.nodes.size());
+    for (int node_idx : route.nodes) {
+        m_Path.push_back(nodes[node_idx]);
+    }
+    distance = PathDistance(m_Path);
+}
+
+/**
+ * Returns the length of a path in meters.
+ * @param path The path.
+ * @return The sum of the distances between consecutive nodes.
+ */
+float RoutePlanner::PathDistance(const std::vector<RouteModel::Node>& path) const {
+    float length = 0.0f;
+    for (std::size_t i = 1; i < path.size(); ++i) {
+        length += path[i].distance(path[i - 1]);
+    }
+    return length * m_Model.MetricScale();  // Convert the distance to meters
+}
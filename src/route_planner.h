@@ -2,25 +2,71 @@
 #define ROUTE_PLANNER_H
 
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <vector>
 #include <string>
+#include "contraction_hierarchy.h"
+#include "landmarks.h"
 #include "route_model.h"
+#include "search_context.h"
 
 /**
  * The RoutePlanner class is responsible for finding the shortest path
- * between two points using the A* search algorithm.
+ * between two points using the A* search algorithm, either forward from the start
+ * or bidirectionally from both ends, or with a preprocessed ContractionHierarchy.
+ *
+ * All search state lives in a SearchContext. A planner bound to a const RouteModel and a
+ * caller-provided context never writes to the model, so worker threads can each run
+ * planners against one shared map, reusing one context per thread across queries.
  */
 class RoutePlanner {
 public:
+    using QueueType = SearchContext::QueueType;
+
+    /**
+     * Search strategies available to AStarSearch().
+     */
+    enum class SearchMode {
+        Unidirectional,  // A* forward from the start node (default)
+        Bidirectional,   // A* from both ends with average potentials
+        ContractionHierarchy  // Upward searches in the hierarchy set by SetContractionHierarchy()
+    };
+
+    /**
+     * A node reached by OneToAll().
+     */
+    struct ReachableNode {
+        int index;       // Index of the node
+        float distance;  // Shortest distance from the start node, in meters
+        int parent;      // Previous node on the shortest path, or SearchContext::kNoParent for the start
+    };
+
     /**
      * Constructor: Initializes the RoutePlanner with start and end coordinates.
+     * The planner owns its search context and stores the found path in model.path.
      * @param model The RouteModel containing map data.
      * @param start_x The x-coordinate of the start point.
      * @param start_y The y-coordinate of the start point.
      * @param end_x The x-coordinate of the end point.
      * @param end_y The y-coordinate of the end point.
+     * @param queue_type The priority queue engine backing the open list.
      */
-    RoutePlanner(RouteModel& model, float start_x, float start_y, float end_x, float end_y);
+    RoutePlanner(RouteModel& model, float start_x, float start_y, float end_x, float end_y,
+                 QueueType queue_type = QueueType::DaryHeap);
+
+    /**
+     * Constructor: Initializes a RoutePlanner on a shared, read-only RouteModel.
+     * The found path is only available through Path().
+     * @param model The shared RouteModel containing map data.
+     * @param context The per-thread search state; must outlive the planner.
+     * @param start_x The x-coordinate of the start point.
+     * @param start_y The y-coordinate of the start point.
+     * @param end_x The x-coordinate of the end point.
+     * @param end_y The y-coordinate of the end point.
+     */
+    RoutePlanner(const RouteModel& model, SearchContext& context,
+                 float start_x, float start_y, float end_x, float end_y);
 
     /**
      * Returns the total distance of the calculated path.
@@ -28,8 +74,60 @@ public:
      */
     float GetDistance() const { return distance; }
 
+    /**
+     * Returns the calculated path, empty if no path was found.
+     */
+    const std::vector<RouteModel::Node>& Path() const noexcept { return m_Path; }
+
+    /**
+     * Returns the search context holding the state of the last search.
+     */
+    SearchContext& Context() noexcept { return m_Context; }
+
+    /**
+     * Selects the search strategy used by AStarSearch(). Both find a shortest path.
+     */
+    void SetSearchMode(SearchMode mode) noexcept { m_SearchMode = mode; }
+    SearchMode GetSearchMode() const noexcept { return m_SearchMode; }
+
+    /**
+     * Sets the hierarchy used in SearchMode::ContractionHierarchy. It must have been built
+     * for the model of the planner and outlive the planner.
+     */
+    void SetContractionHierarchy(const ::ContractionHierarchy* hierarchy) noexcept { m_Hierarchy = hierarchy; }
+
+    /**
+     * Tightens the heuristic of the A* searches with the lower bounds of landmarks (ALT).
+     * The landmarks must have been computed for the model of the planner and outlive the
+     * planner; nullptr restores the straight-line heuristic.
+     */
+    void SetLandmarks(const Landmarks* landmarks) noexcept { m_Landmarks = landmarks; }
+
+    /**
+     * Returns the number of nodes expanded by the last search, in both directions.
+     */
+    std::size_t SettledNodeCount() const noexcept { return m_SettledNodes; }
+
+    /**
+     * Runs Dijkstra's algorithm from the start node to every node within a distance; the end
+     * point is ignored. The result is the shortest-path tree of the start node.
+     * @param max_distance The largest distance of interest, in meters; infinity for no cutoff.
+     * @return The reached nodes in order of their distance, the start node first.
+     */
+    std::vector<ReachableNode> OneToAll(float max_distance = std::numeric_limits<float>::infinity());
+
+    /**
+     * Computes the area reachable from the start node within a distance (an isochrone).
+     * @param max_distance The distance, in meters.
+     * @param resolution The size of the grid cells the area is traced on, in meters.
+     * @return The outline of the area as a counter-clockwise polygon in model coordinates.
+     */
+    std::vector<Model::Node> Isochrone(float max_distance, float resolution = 25.0f);
+
     /**
      * Performs the A* search algorithm to find the shortest path.
+     * @throws std::logic_error if the search mode needs a contraction hierarchy and none
+     *         built for the model was set.
      */
     void AStarSearch();
 
@@ -39,35 +137,63 @@ public:
      * Adds neighboring nodes to the open list for exploration.
      * @param current_node The current node being explored.
      */
-    void AddNeighbors(RouteModel::Node* current_node);
+    void AddNeighbors(const RouteModel::Node* current_node);
 
     /**
      * Calculates the heuristic value (estimated cost to the goal) for a node.
      * @param node The node for which to calculate the heuristic.
      * @return The heuristic value.
      */
-    float CalculateHValue(const RouteModel::Node* node);
+    float CalculateHValue(const RouteModel::Node* node) const;
 
     /**
      * Constructs the final path from the start node to the end node.
      * @param final_node The final node in the path.
      * @return A vector of nodes representing the path.
      */
-    std::vector<RouteModel::Node> ConstructFinalPath(RouteModel::Node* final_node);
+    std::vector<RouteModel::Node> ConstructFinalPath(const RouteModel::Node* final_node);
 
     /**
-     * Selects the next node to explore from the open list.
+     * Removes the node with the lowest f-value (g-value + h-value) from the open list.
      * @return A pointer to the next node.
      */
-    RouteModel::Node* NextNode();
+    const RouteModel::Node* NextNode();
 
 private:
-    std::vector<RouteModel::Node*> open_list;  // List of nodes to be explored
-    RouteModel::Node* start_node;  // The starting node
-    RouteModel::Node* end_node;  // The goal node
+    // Snaps the start and end coordinates to the closest nodes and prepares the context.
+    void FindEndpoints(float start_x, float start_y, float end_x, float end_y);
+
+    // Starts a new query in the search context, with only the start node queued.
+    void ResetSearch();
+
+    // Returns a lower bound of the distance between two nodes.
+    float LowerBound(const RouteModel::Node& from, const RouteModel::Node& to) const;
+
+    // Runs the bidirectional search and stores its path.
+    void BidirectionalSearch();
+
+    // Joins the forward and backward search trees at the meeting node into a start-to-end path.
+    std::vector<RouteModel::Node> ConstructBidirectionalPath(int meeting_idx);
+
+    // Queries the contraction hierarchy and stores its path.
+    void HierarchySearch();
+
+    // Returns the length of a path in meters.
+    float PathDistance(const std::vector<RouteModel::Node>& path) const;
+
+    std::unique_ptr<SearchContext> m_OwnedContext;  // Context owned by planners that were not given one
+    SearchContext& m_Context;  // Per-query search state
+    const RouteModel::Node* start_node = nullptr;  // The starting node; nullptr without routable nodes
+    const RouteModel::Node* end_node = nullptr;  // The goal node
 
     float distance = 0.0f;  // Total distance of the calculated path
-    RouteModel& m_Model;  // Reference to the RouteModel containing map data
+    SearchMode m_SearchMode = SearchMode::Unidirectional;  // Strategy of AStarSearch()
+    const ::ContractionHierarchy* m_Hierarchy = nullptr;  // Hierarchy for SearchMode::ContractionHierarchy
+    const Landmarks* m_Landmarks = nullptr;  // Landmarks tightening the heuristic, if any
+    std::size_t m_SettledNodes = 0;  // Nodes expanded by the last search
+    std::vector<RouteModel::Node> m_Path;  // The calculated path
+    const RouteModel& m_Model;  // Reference to the RouteModel containing map data
+    RouteModel* m_PathSink = nullptr;  // Model whose path is updated after a search, if any
 };
 
-#endif
\ No newline at end of file
+#endif
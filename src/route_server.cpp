@@ -0,0 +1,369 @@
+#include "route_server.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include "search_context.h"
+#include "thread_pool.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::uint64_t kListenerKey = 0;
+constexpr std::uint64_t kWakeupKey = 1;
+
+// A connection stops reading while this many of its queries are unanswered
+constexpr std::size_t kMaxPendingReplies = 1024;
+
+// A connection stops reading while this many result bytes wait to be sent
+constexpr std::size_t kMaxBufferedOutput = std::size_t{1} << 20;
+
+// Connections sending a longer line are dropped
+constexpr std::size_t kMaxLineLength = 4096;
+
+// Returns an event registration tagged with a key.
+epoll_event MakeEvent(std::uint32_t events, std::uint64_t key) {
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = key;
+    return event;
+}
+
+}  // namespace
+
+/**
+ * Constructor: Binds and listens on the socket. A stale socket file at the path is replaced.
+ * @param map The map to serve.
+ * @param socket_path The path of the socket file.
+ * @param threads The number of workers; 0 uses one per hardware thread.
+ */
+RouteServer::RouteServer(ServedMap map, const std::string& socket_path, std::size_t threads)
+    : m_SocketPath(socket_path) {
+    if (!map.model) {
+        throw std::invalid_argument("A served map needs a route model.");
+    }
+    m_Map = std::make_shared<const ServedMap>(std::move(map));
+    sockaddr_un address{};
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::invalid_argument("Invalid socket path: " + socket_path);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    m_Listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_Listener < 0) Fail("create the socket");
+    struct stat info;
+    if (lstat(socket_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(socket_path.c_str());  // Left behind by a server that did not shut down cleanly
+    }
+    if (bind(m_Listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) Fail("bind the socket");
+    m_Bound = true;
+    if (listen(m_Listener, SOMAXCONN) < 0) Fail("listen on the socket");
+
+    m_Epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_Epoll < 0) Fail("create the event loop");
+    m_Wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_Wakeup < 0) Fail("create the wakeup event");
+    auto listener_event = MakeEvent(EPOLLIN, kListenerKey);
+    auto wakeup_event = MakeEvent(EPOLLIN, kWakeupKey);
+    if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Listener, &listener_event) < 0 ||
+        epoll_ctl(m_Epoll, EPOLL_CTL_ADD, m_Wakeup, &wakeup_event) < 0) {
+        Fail("register the socket");
+    }
+
+    m_Pool = std::make_unique<ThreadPool>(threads);
+}
+
+/**
+ * Destructor: Waits for a reload and the queries in progress, closes all connections and
+ * removes the socket file.
+ */
+RouteServer::~RouteServer() {
+    if (m_ReloadThread.joinable()) m_ReloadThread.join();
+    m_Pool.reset();  // Workers signal m_Wakeup, so they must finish first
+    for (const auto& [id, connection] : m_Connections) {
+        close(connection.socket);
+    }
+    if (m_Wakeup >= 0) close(m_Wakeup);
+    if (m_Epoll >= 0) close(m_Epoll);
+    if (m_Listener >= 0) close(m_Listener);
+    if (m_Bound) unlink(m_SocketPath.c_str());
+}
+
+/**
+ * Serves clients until Stop() is called.
+ */
+void RouteServer::Run() {
+    epoll_event events[64];
+    while (!m_Stopping.load()) {
+        const int count = epoll_wait(m_Epoll, events, std::size(events), -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error(std::string{"Failed to wait for events: "} + std::strerror(errno));
+        }
+        for (int i = 0; i < count; ++i) {
+            const auto key = events[i].data.u64;
+            if (key == kListenerKey) {
+                Accept();
+                continue;
+            }
+            if (key == kWakeupKey) {
+                std::uint64_t signals;
+                while (read(m_Wakeup, &signals, sizeof(signals)) > 0) {}
+                CollectReplies();
+                StartReload();
+                continue;
+            }
+            const auto found = m_Connections.find(key);
+            if (found == m_Connections.end()) continue;  // Closed while handling an earlier event
+            auto& connection = found->second;
+            const auto ready = events[i].events;
+            if ((ready & (EPOLLERR | EPOLLHUP)) ||                      // The client cannot receive results
+                ((ready & EPOLLIN) && !Read(key, connection)) ||
+                ((ready & EPOLLOUT) && !Write(connection))) {
+                Close(key);
+                continue;
+            }
+            Update(key, connection);
+        }
+    }
+}
+
+/**
+ * Makes Run() return. Safe to call from any thread and from signal handlers.
+ */
+void RouteServer::Stop() noexcept {
+    m_Stopping.store(true);
+    Wake();
+}
+
+/**
+ * Replaces the served map. The previous map is freed by whoever releases it last.
+ * @param map The new map.
+ */
+void RouteServer::Publish(ServedMap map) {
+    if (!map.model) {
+        throw std::invalid_argument("A served map needs a route model.");
+    }
+    std::atomic_store(&m_Map, std::make_shared<const ServedMap>(std::move(map)));
+}
+
+/**
+ * Requests a reload by the reloader; Run() starts it.
+ */
+void RouteServer::Reload() noexcept {
+    m_ReloadRequested.store(true);
+    Wake();
+}
+
+// Starts a requested reload on the reload thread, unless one is still running.
+void RouteServer::StartReload() {
+    if (!m_Reloader || m_Reloading.load() || !m_ReloadRequested.exchange(false)) return;
+    if (m_ReloadThread.joinable()) m_ReloadThread.join();
+    m_Reloading.store(true);
+    m_ReloadThread = std::thread{[this] {
+        try {
+            auto map = m_Reloader();
+            if (map.model) Publish(std::move(map));
+        } catch (const std::exception&) {
+            // Keep serving the current map
+        }
+        m_Reloading.store(false);
+        Wake();  // Start a reload requested in the meantime
+    }};
+}
+
+// Accepts all pending connections.
+void RouteServer::Accept() {
+    for (;;) {
+        const int socket = accept4(m_Listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            return;  // No more pending connections, or out of descriptors until a client leaves
+        }
+        const auto id = m_NextId++;
+        auto event = MakeEvent(EPOLLIN, id);
+        if (epoll_ctl(m_Epoll, EPOLL_CTL_ADD, socket, &event) < 0) {
+            close(socket);
+            continue;
+        }
+        auto& connection = m_Connections[id];
+        connection.socket = socket;
+        connection.events = EPOLLIN;
+    }
+}
+
+// Receives the available input and submits its complete lines; returns false if the connection failed.
+bool RouteServer::Read(std::uint64_t id, Connection& connection) {
+    char buffer[1 << 16];
+    while (connection.replies.size() < kMaxPendingReplies) {
+        const auto received = recv(connection.socket, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, received);
+            Split(id, connection);
+            if (connection.input.size() > kMaxLineLength) return false;
+            if (received < static_cast<ssize_t>(sizeof(buffer))) return true;
+            continue;
+        }
+        if (received == 0) {
+            connection.input_closed = true;
+            if (!connection.input.empty()) {
+                connection.input += '\n';  // Answer a last line without a line break
+                Split(id, connection);
+            }
+            return true;
+        }
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
+}
+
+// Sends as much of the pending output as the socket takes; returns false if the connection failed.
+bool RouteServer::Write(Connection& connection) {
+    std::size_t sent = 0;
+    while (sent < connection.output.size()) {
+        const auto written = send(connection.socket, connection.output.data() + sent,
+                                  connection.output.size() - sent, MSG_NOSIGNAL);
+        if (written >= 0) {
+            sent += written;
+        } else if (errno != EINTR) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            break;
+        }
+    }
+    connection.output.erase(0, sent);
+    return true;
+}
+
+// Submits the complete lines of the input, skipping empty lines and comments.
+void RouteServer::Split(std::uint64_t id, Connection& connection) {
+    std::size_t begin = 0;
+    for (auto end = connection.input.find('\n'); end != std::string::npos;
+         begin = end + 1, end = connection.input.find('\n', begin)) {
+        ++connection.line;
+        auto line = std::string_view{connection.input}.substr(begin, end - begin);
+        line.remove_prefix(std::min(line.find_first_not_of(" \t\r"), line.size()));
+        if (line.empty() || line.front() == '#') continue;
+        Submit(id, connection, line);
+    }
+    connection.input.erase(0, begin);
+}
+
+// Queues a query on the workers, reserving its place among the replies of the connection.
+void RouteServer::Submit(std::uint64_t id, Connection& connection, std::string_view query) {
+    auto reply = std::make_shared<Reply>();
+    connection.replies.push_back(reply);
+    m_Pool->Submit([this, id, reply, query = std::string{query}, line = connection.line] {
+        thread_local SearchContext context;
+        try {
+            const auto map = std::atomic_load(&m_Map);  // Kept alive until the query finishes
+            BatchOptions options;
+            options.hierarchy = map->hierarchy.get();
+            options.landmarks = map->landmarks.get();
+            AnswerQuery(*map->model, context, query, line, options, reply->text);
+        } catch (const std::exception&) {
+            reply->text = "error " + std::to_string(line);
+        }
+        reply->done.store(true, std::memory_order_release);
+        {
+            std::lock_guard lock{m_Mutex};
+            m_Completed.push_back(id);
+        }
+        Wake();
+    });
+}
+
+// Moves the finished replies at the front of each signalled connection to its output.
+void RouteServer::CollectReplies() {
+    std::vector<std::uint64_t> completed;
+    {
+        std::lock_guard lock{m_Mutex};
+        completed.swap(m_Completed);
+    }
+    for (const auto id : completed) {
+        const auto found = m_Connections.find(id);
+        if (found == m_Connections.end()) continue;
+        auto& connection = found->second;
+        auto& replies = connection.replies;
+        while (!replies.empty() && replies.front()->done.load(std::memory_order_acquire)) {
+            connection.output += replies.front()->text;
+            connection.output += '\n';
+            replies.pop_front();
+        }
+        if (!Write(connection)) {
+            Close(id);
+            continue;
+        }
+        Update(id, connection);
+    }
+}
+
+// Closes a finished connection, or adjusts the events its socket is watched for.
+void RouteServer::Update(std::uint64_t id, Connection& connection) {
+    if (connection.input_closed && connection.replies.empty() && connection.output.empty()) {
+        Close(id);
+        return;
+    }
+    const bool reading = !connection.input_closed && connection.replies.size() < kMaxPendingReplies &&
+                         connection.output.size() < kMaxBufferedOutput;
+    std::uint32_t events = 0;
+    if (reading) events |= EPOLLIN;
+    if (!connection.output.empty()) events |= EPOLLOUT;
+    if (events != connection.events) {
+        auto event = MakeEvent(events, id);
+        epoll_ctl(m_Epoll, EPOLL_CTL_MOD, connection.socket, &event);
+        connection.events = events;
+    }
+}
+
+// Drops a connection; replies still being computed for it are discarded.
+void RouteServer::Close(std::uint64_t id) {
+    const auto found = m_Connections.find(id);
+    epoll_ctl(m_Epoll, EPOLL_CTL_DEL, found->second.socket, nullptr);
+    close(found->second.socket);
+    m_Connections.erase(found);
+}
+
+// Interrupts epoll_wait() in Run().
+void RouteServer::Wake() noexcept {
+    const std::uint64_t signal = 1;
+    [[maybe_unused]] const auto written = write(m_Wakeup, &signal, sizeof(signal));
+}
+
+// Releases what the constructor set up so far and reports a failed system call.
+void RouteServer::Fail(const char* action) {
+    const std::string message = std::string{"Failed to "} + action + ": " + std::strerror(errno);
+    if (m_Wakeup >= 0) close(m_Wakeup);
+    if (m_Epoll >= 0) close(m_Epoll);
+    if (m_Listener >= 0) close(m_Listener);
+    if (m_Bound) unlink(m_SocketPath.c_str());
+    throw std::runtime_error(message);
+}
+
+#else
+
+RouteServer::RouteServer(ServedMap map, const std::string& socket_path, std::size_t threads)
+    : m_SocketPath(socket_path) {
+    throw std::runtime_error("The route server is only available on Linux.");
+}
+
+RouteServer::~RouteServer() = default;
+
+void RouteServer::Run() {}
+
+void RouteServer::Stop() noexcept {}
+
+void RouteServer::Publish(ServedMap map) {}
+
+void RouteServer::Reload() noexcept {}
+
+#endif
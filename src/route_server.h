@@ -0,0 +1,155 @@
+#ifndef ROUTE_SERVER_H
+#define ROUTE_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "batch_query.h"
+
+class ThreadPool;
+
+/**
+ * A map served by a RouteServer: the route model and the optional structures built for it,
+ * which are replaced together.
+ */
+struct ServedMap {
+    std::shared_ptr<const RouteModel> model{};
+    std::shared_ptr<const ContractionHierarchy> hierarchy{};  // Hierarchy of the model, if any
+    std::shared_ptr<const Landmarks> landmarks{};             // Landmarks of the model, if any
+};
+
+/**
+ * The RouteServer class answers route queries from local clients over a Unix domain socket,
+ * keeping one loaded map for its whole lifetime.
+ *
+ * The protocol is the line format of RunBatchQueries(): a client writes query lines and reads
+ * one result line per query, in the order of its queries. Clients may pipeline any number of
+ * queries; after a client shuts down its sending side, the server writes the outstanding results
+ * and closes the connection.
+ *
+ * A single thread runs an epoll loop that accepts connections, splits their input into lines and
+ * writes the results back. The queries themselves are solved on a worker pool, every worker
+ * reusing its own SearchContext. Only available on Linux.
+ *
+ * The map can be replaced while the server runs (see Publish() and Reload()). Every query reads
+ * the current map once when it starts and finishes on that map, so queries in flight are not
+ * disturbed and queries starting after the swap see the new map.
+ */
+class RouteServer {
+public:
+    /**
+     * Constructor: Binds and listens on the socket. A stale socket file at the path is replaced.
+     * @param map The map to serve.
+     * @param socket_path The path of the socket file.
+     * @param threads The number of workers; 0 uses one per hardware thread.
+     * @throws std::invalid_argument if the map has no model or the path is too long for a socket address.
+     * @throws std::runtime_error if the socket cannot be set up.
+     */
+    RouteServer(ServedMap map, const std::string& socket_path, std::size_t threads = 0);
+
+    RouteServer(const RouteServer&) = delete;
+    RouteServer& operator=(const RouteServer&) = delete;
+
+    /**
+     * Destructor: Waits for a reload and the queries in progress, closes all connections and
+     * removes the socket file.
+     */
+    ~RouteServer();
+
+    /**
+     * Serves clients until Stop() is called.
+     * @throws std::runtime_error if waiting for events fails.
+     */
+    void Run();
+
+    /**
+     * Makes Run() return. Safe to call from any thread and from signal handlers.
+     */
+    void Stop() noexcept;
+
+    /**
+     * Replaces the served map. Queries starting afterwards use the new map. Returns at once: the
+     * previous map is freed when the last query running on it, or the last holder of Map(),
+     * releases it. Safe to call from any thread.
+     * @param map The new map.
+     * @throws std::invalid_argument if the map has no model.
+     */
+    void Publish(ServedMap map);
+
+    /**
+     * Sets the function that builds a new map when a reload is requested. It runs on a thread of
+     * its own, so the workers keep answering queries on the current map meanwhile. If it throws
+     * or returns a map without a model, the current map stays in place.
+     * @param reloader The function building the new map.
+     */
+    void SetReloader(std::function<ServedMap()> reloader) { m_Reloader = std::move(reloader); }
+
+    /**
+     * Requests a reload by the reloader; Run() starts it. A request made during a reload starts
+     * another one once it has finished. Safe to call from any thread and from signal handlers.
+     */
+    void Reload() noexcept;
+
+    /**
+     * Returns the map that new queries are answered on.
+     */
+    std::shared_ptr<const ServedMap> Map() const { return std::atomic_load(&m_Map); }
+
+    const std::string& SocketPath() const noexcept { return m_SocketPath; }
+
+private:
+    // The result of a query, filled in by a worker.
+    struct Reply {
+        std::string text;               // Result line, without the line break
+        std::atomic<bool> done{false};  // Set once text is complete
+    };
+
+    // A client connection, owned by the event loop thread.
+    struct Connection {
+        int socket = -1;
+        std::string input;                          // Received bytes not yet split into lines
+        std::string output;                         // Result bytes not yet sent
+        std::deque<std::shared_ptr<Reply>> replies; // Queries not yet answered, oldest first
+        std::size_t line = 0;                       // Number of lines received
+        bool input_closed = false;                  // The client shut down its sending side
+        std::uint32_t events = 0;                   // Events the loop is waiting for
+    };
+
+    void Accept();
+    bool Read(std::uint64_t id, Connection& connection);
+    bool Write(Connection& connection);
+    void Split(std::uint64_t id, Connection& connection);
+    void Submit(std::uint64_t id, Connection& connection, std::string_view query);
+    void CollectReplies();
+    void Update(std::uint64_t id, Connection& connection);
+    void Close(std::uint64_t id);
+    void StartReload();
+    void Wake() noexcept;
+    [[noreturn]] void Fail(const char* action);
+
+    std::shared_ptr<const ServedMap> m_Map;                    // Current map, accessed atomically
+    std::function<ServedMap()> m_Reloader;
+    std::atomic<bool> m_ReloadRequested{false};
+    std::atomic<bool> m_Reloading{false};                      // m_ReloadThread is building a map
+    std::thread m_ReloadThread;
+    std::string m_SocketPath;
+    int m_Listener = -1;                                       // Listening socket
+    int m_Epoll = -1;                                          // Event loop
+    int m_Wakeup = -1;                                         // eventfd that interrupts the event loop
+    bool m_Bound = false;                                      // The socket file was created by the server
+    std::atomic<bool> m_Stopping{false};
+    std::uint64_t m_NextId = 2;                                // Event loop keys; 0 and 1 are the listener and the eventfd
+    std::unordered_map<std::uint64_t, Connection> m_Connections;
+    std::mutex m_Mutex;                                        // Guards m_Completed
+    std::vector<std::uint64_t> m_Completed;                    // Connections with newly finished replies
+    std::unique_ptr<ThreadPool> m_Pool;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "search_context.h"
+#include <algorithm>
+
+/**
+ * Constructor: Sizes the context for a graph.
+ * @param node_count The number of nodes in the graph.
+ * @param queue_type The priority queue engine backing the open list.
+ */
+SearchContext::SearchContext(std::size_t node_count, QueueType queue_type) {
+    if (queue_type == QueueType::PairingHeap) {
+        m_OpenList.emplace<PairingHeap>();
+    }
+    Prepare(node_count);
+}
+
+/**
+ * Starts a new query: invalidates all labels and empties the open list.
+ * @param node_count The number of nodes in the graph.
+ */
+void SearchContext::Prepare(std::size_t node_count) {
+    if (node_count != m_G.size()) {
+        // Resizing invalidates everything anyway, so start over from a clean epoch
+        m_G.assign(node_count, 0.0f);
+        m_Parent.assign(node_count, kNoParent);
+        m_Stamp.assign(node_count, 0);
+        m_Epoch = 1;
+        std::visit([node_count](auto& queue) { queue.Resize(node_count); }, m_OpenList);
+        return;
+    }
+
+    // Bump the epoch; on wrap-around the stamps must be wiped once so stale labels stay invalid
+    if (++m_Epoch == 0) {
+        std::fill(m_Stamp.begin(), m_Stamp.end(), 0);
+        m_Epoch = 1;
+    }
+    std::visit([](auto& queue) { queue.Clear(); }, m_OpenList);
+}
+
+/**
+ * Returns the companion context holding the backward half of bidirectional searches.
+ * @return The backward context, created on first use.
+ */
+SearchContext& SearchContext::Backward() {
+    if (!m_Backward) {
+        // The variant alternatives are declared in QueueType order
+        m_Backward = std::make_unique<SearchContext>(m_G.size(), static_cast<QueueType>(m_OpenList.index()));
+    }
+    return *m_Backward;
+}
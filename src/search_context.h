@@ -0,0 +1,101 @@
+#ifndef SEARCH_CONTEXT_H
+#define SEARCH_CONTEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <variant>
+#include <vector>
+#include "priority_queue.h"
+
+/**
+ * The SearchContext class holds the per-query state of a route search: g-values,
+ * parents and the open list. The RouteModel itself stays read-only, so any number of
+ * threads can search one loaded map concurrently, each with its own context.
+ *
+ * Labels are stamped with an epoch; starting a new query bumps the epoch, which
+ * invalidates every label in O(1) instead of clearing the arrays.
+ */
+class SearchContext {
+public:
+    /**
+     * Priority queue engines available for the open list.
+     */
+    enum class QueueType {
+        DaryHeap,     // Indexed 4-ary heap (default)
+        PairingHeap   // Indexed pairing heap
+    };
+
+    using OpenList = std::variant<IndexedDaryHeap<4>, PairingHeap>;
+
+    static constexpr int kNoParent = -1;
+
+    SearchContext() = default;
+
+    /**
+     * Constructor: Sizes the context for a graph.
+     * @param node_count The number of nodes in the graph.
+     * @param queue_type The priority queue engine backing the open list.
+     */
+    explicit SearchContext(std::size_t node_count, QueueType queue_type = QueueType::DaryHeap);
+
+    /**
+     * Starts a new query: invalidates all labels and empties the open list.
+     * Grows the arrays if the graph has more nodes than the context was sized for.
+     * @param node_count The number of nodes in the graph.
+     */
+    void Prepare(std::size_t node_count);
+
+    /**
+     * Returns true if the node has been labelled during the current query.
+     */
+    bool Reached(int node) const noexcept { return m_Stamp[node] == m_Epoch; }
+
+    /**
+     * Returns the cost from the start to the node, or infinity if it is not reached.
+     */
+    float G(int node) const noexcept { return Reached(node) ? m_G[node] : std::numeric_limits<float>::infinity(); }
+
+    /**
+     * Returns the parent of the node in the search tree, or kNoParent.
+     */
+    int Parent(int node) const noexcept { return Reached(node) ? m_Parent[node] : kNoParent; }
+
+    /**
+     * Labels a node with its cost and parent for the current query.
+     */
+    void SetLabel(int node, float g, int parent) noexcept {
+        m_Stamp[node] = m_Epoch;
+        m_G[node] = g;
+        m_Parent[node] = parent;
+    }
+
+    /**
+     * Returns true if the node is reached and no longer queued, i.e. it has been expanded.
+     */
+    bool Settled(int node) const {
+        return Reached(node) && !std::visit([node](const auto& queue) { return queue.Contains(node); }, m_OpenList);
+    }
+
+    /**
+     * Returns the companion context holding the backward half of bidirectional searches.
+     * It is created on first use with the same queue engine and then reused across queries.
+     */
+    SearchContext& Backward();
+
+    // Accessors for the open list and the size of the context
+    OpenList& Queue() noexcept { return m_OpenList; }
+    const OpenList& Queue() const noexcept { return m_OpenList; }
+    std::size_t Size() const noexcept { return m_G.size(); }
+
+private:
+    std::vector<float> m_G;              // Cost from the start node per node
+    std::vector<int> m_Parent;           // Parent node index per node
+    std::vector<std::uint32_t> m_Stamp;  // Epoch in which the label of a node was written
+    std::uint32_t m_Epoch = 1;           // Current query epoch
+    OpenList m_OpenList;                 // Nodes to be explored
+    std::unique_ptr<SearchContext> m_Backward;  // Backward search state, created on demand
+};
+
+#endif
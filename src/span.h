@@ -0,0 +1,37 @@
+#ifndef SPAN_H
+#define SPAN_H
+
+#include <cassert>
+#include <cstddef>
+
+/**
+ * A non-owning view of a contiguous array, used to hand out slices of the flat
+ * model arrays without copying them (a minimal stand-in for C++20 std::span).
+ */
+template <typename T>
+class Span {
+public:
+    using value_type = T;
+    using iterator = T*;
+
+    constexpr Span() noexcept = default;
+    constexpr Span(T* data, std::size_t size) noexcept : m_Data(data), m_Size(size) {}
+    constexpr Span(T* first, T* last) noexcept : m_Data(first), m_Size(static_cast<std::size_t>(last - first)) {}
+
+    constexpr T* data() const noexcept { return m_Data; }
+    constexpr std::size_t size() const noexcept { return m_Size; }
+    constexpr bool empty() const noexcept { return m_Size == 0; }
+
+    constexpr T* begin() const noexcept { return m_Data; }
+    constexpr T* end() const noexcept { return m_Data + m_Size; }
+
+    constexpr T& front() const { assert(!empty()); return m_Data[0]; }
+    constexpr T& back() const { assert(!empty()); return m_Data[m_Size - 1]; }
+    constexpr T& operator[](std::size_t i) const { assert(i < m_Size); return m_Data[i]; }
+
+private:
+    T* m_Data = nullptr;
+    std::size_t m_Size = 0;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+/**
+ * Constructor: Builds the grid over a set of points.
+ * @param points The points to index; ids are returned by the queries.
+ * @param points_per_cell The average number of points per grid cell.
+ */
+SpatialIndex::SpatialIndex(std::vector<Point> points, double points_per_cell) {
+    if (points.empty()) {
+        return;
+    }
+
+    // Fit a grid of square cells to the bounding box of the points
+    double max_x = points.front().x, max_y = points.front().y;
+    m_MinX = points.front().x;
+    m_MinY = points.front().y;
+    for (const auto& p : points) {
+        m_MinX = std::min(m_MinX, p.x);
+        m_MinY = std::min(m_MinY, p.y);
+        max_x = std::max(max_x, p.x);
+        max_y = std::max(max_y, p.y);
+    }
+    const double width = std::max(max_x - m_MinX, 1e-9);
+    const double height = std::max(max_y - m_MinY, 1e-9);
+    const double cells = std::max(1.0, static_cast<double>(points.size()) / points_per_cell);
+    m_CellSize = std::max(std::sqrt(width * height / cells), std::max(width, height) / 4096.0);
+    m_Columns = static_cast<int>(width / m_CellSize) + 1;
+    m_Rows = static_cast<int>(height / m_CellSize) + 1;
+
+    // Counting sort of the points by cell
+    const auto cell_of = [&](const Point& p) { return CellY(p.y) * m_Columns + CellX(p.x); };
+    m_CellStart.assign(static_cast<std::size_t>(m_Columns) * m_Rows + 1, 0);
+    for (const auto& p : points) {
+        ++m_CellStart[cell_of(p) + 1];
+    }
+    for (std::size_t c = 1; c < m_CellStart.size(); ++c) {
+        m_CellStart[c] += m_CellStart[c - 1];
+    }
+    m_Points.resize(points.size());
+    std::vector<int> fill(m_CellStart.begin(), m_CellStart.end() - 1);
+    for (const auto& p : points) {
+        m_Points[fill[cell_of(p)]++] = p;
+    }
+}
+
+int SpatialIndex::CellX(double x) const {
+    return std::clamp(static_cast<int>(std::floor((x - m_MinX) / m_CellSize)), 0, m_Columns - 1);
+}
+
+int SpatialIndex::CellY(double y) const {
+    return std::clamp(static_cast<int>(std::floor((y - m_MinY) / m_CellSize)), 0, m_Rows - 1);
+}
+
+template <typename Visit>
+void SpatialIndex::VisitRing(int cx, int cy, int r, Visit&& visit) const {
+    const auto visit_cell = [&](int x, int y) {
+        if (x < 0 || y < 0 || x >= m_Columns || y >= m_Rows) return;
+        const auto c = static_cast<std::size_t>(y) * m_Columns + x;
+        for (int i = m_CellStart[c]; i < m_CellStart[c + 1]; ++i) {
+            visit(m_Points[i]);
+        }
+    };
+    if (r == 0) {
+        visit_cell(cx, cy);
+        return;
+    }
+    for (int x = cx - r; x <= cx + r; ++x) {
+        visit_cell(x, cy - r);
+        visit_cell(x, cy + r);
+    }
+    for (int y = cy - r + 1; y <= cy + r - 1; ++y) {
+        visit_cell(cx - r, y);
+        visit_cell(cx + r, y);
+    }
+}
+
+double SpatialIndex::RingClearance(double x, double y, int cx, int cy, int r) const {
+    // Distance from the query point to the nearest side of the visited block of cells
+    // beyond which the grid still has cells
+    double clearance = std::numeric_limits<double>::infinity();
+    if (cx - r > 0) clearance = std::min(clearance, x - (m_MinX + (cx - r) * m_CellSize));
+    if (cx + r < m_Columns - 1) clearance = std::min(clearance, (m_MinX + (cx + r + 1) * m_CellSize) - x);
+    if (cy - r > 0) clearance = std::min(clearance, y - (m_MinY + (cy - r) * m_CellSize));
+    if (cy + r < m_Rows - 1) clearance = std::min(clearance, (m_MinY + (cy + r + 1) * m_CellSize) - y);
+    return std::max(0.0, clearance);
+}
+
+int SpatialIndex::MaxRing(int cx, int cy) const {
+    return std::max({cx, m_Columns - 1 - cx, cy, m_Rows - 1 - cy});
+}
+
+/**
+ * Finds the point closest to the given coordinates; ties go to the smallest id.
+ * @return The id of the closest point, or -1 if the index is empty.
+ */
+int SpatialIndex::Nearest(double x, double y) const {
+    auto nearest = KNearest(x, y, 1);
+    return nearest.empty() ? -1 : nearest.front();
+}
+
+/**
+ * Finds the k points closest to the given coordinates.
+ * @return The ids of up to k points, nearest first.
+ */
+std::vector<int> SpatialIndex::KNearest(double x, double y, std::size_t k) const {
+    std::vector<int> result;
+    if (m_Points.empty() || k == 0) {
+        return result;
+    }
+
+    // Max-heap of the best k candidates seen so far
+    std::priority_queue<Hit> best;
+    const int cx = CellX(x), cy = CellY(y), max_ring = MaxRing(cx, cy);
+    for (int r = 0; r <= max_ring; ++r) {
+        VisitRing(cx, cy, r, [&](const Point& p) {
+            const Hit hit{(p.x - x) * (p.x - x) + (p.y - y) * (p.y - y), p.id};
+            if (best.size() < k) {
+                best.push(hit);
+            } else if (hit < best.top()) {
+                best.pop();
+                best.push(hit);
+            }
+        });
+        // Stop once every unvisited cell is farther away than the k-th candidate
+        if (best.size() == k) {
+            const double clearance = RingClearance(x, y, cx, cy, r);
+            if (best.top().dist2 < clearance * clearance) break;
+        }
+    }
+
+    result.resize(best.size());
+    for (auto i = result.size(); i-- > 0;) {
+        result[i] = best.top().id;
+        best.pop();
+    }
+    return result;
+}
+
+/**
+ * Finds all points within a radius of the given coordinates.
+ * @return The ids of the points, nearest first.
+ */
+std::vector<int> SpatialIndex::WithinRadius(double x, double y, double radius) const {
+    std::vector<Hit> hits;
+    if (m_Points.empty() || radius < 0.0) {
+        return {};
+    }
+
+    const double radius2 = radius * radius;
+    const int cx = CellX(x), cy = CellY(y), max_ring = MaxRing(cx, cy);
+    for (int r = 0; r <= max_ring; ++r) {
+        VisitRing(cx, cy, r, [&](const Point& p) {
+            const double dist2 = (p.x - x) * (p.x - x) + (p.y - y) * (p.y - y);
+            if (dist2 <= radius2) {
+                hits.push_back({dist2, p.id});
+            }
+        });
+        if (RingClearance(x, y, cx, cy, r) > radius) break;
+    }
+
+    std::sort(hits.begin(), hits.end());
+    std::vector<int> result;
+    result.reserve(hits.size());
+    for (const auto& hit : hits) {
+        result.push_back(hit.id);
+    }
+    return result;
+}
@@ -0,0 +1,87 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * The SpatialIndex class is a static uniform grid over a set of points, used to snap
+ * coordinates to the nearest routable node without scanning the whole map.
+ * Points are bucketed once into cells stored in compressed-sparse-row form; queries
+ * visit rings of cells around the query point and stop as soon as no closer point
+ * can exist outside the rings visited so far.
+ */
+class SpatialIndex {
+public:
+    // A point of the index with the id it was inserted with.
+    struct Point {
+        double x = 0.0;
+        double y = 0.0;
+        int id = -1;
+    };
+
+    SpatialIndex() = default;
+
+    /**
+     * Constructor: Builds the grid over a set of points.
+     * @param points The points to index; ids are returned by the queries.
+     * @param points_per_cell The average number of points per grid cell.
+     */
+    explicit SpatialIndex(std::vector<Point> points, double points_per_cell = 2.0);
+
+    /**
+     * Finds the point closest to the given coordinates; ties go to the smallest id.
+     * @return The id of the closest point, or -1 if the index is empty.
+     */
+    int Nearest(double x, double y) const;
+
+    /**
+     * Finds the k points closest to the given coordinates.
+     * @return The ids of up to k points, nearest first.
+     */
+    std::vector<int> KNearest(double x, double y, std::size_t k) const;
+
+    /**
+     * Finds all points within a radius of the given coordinates.
+     * @return The ids of the points, nearest first.
+     */
+    std::vector<int> WithinRadius(double x, double y, double radius) const;
+
+    // Returns the number of indexed points.
+    std::size_t Size() const noexcept { return m_Points.size(); }
+    bool Empty() const noexcept { return m_Points.empty(); }
+
+private:
+    // A candidate found by a query, ordered by distance and then by id.
+    struct Hit {
+        double dist2;
+        int id;
+        bool operator<(const Hit& other) const {
+            return dist2 < other.dist2 || (dist2 == other.dist2 && id < other.id);
+        }
+    };
+
+    // Returns the cell column/row of a coordinate, clamped to the grid.
+    int CellX(double x) const;
+    int CellY(double y) const;
+
+    // Calls visit(point) for every point of the cells on ring r around cell (cx, cy).
+    template <typename Visit>
+    void VisitRing(int cx, int cy, int r, Visit&& visit) const;
+
+    // Returns a lower bound of the distance from (x, y) to any cell outside ring r.
+    double RingClearance(double x, double y, int cx, int cy, int r) const;
+
+    // Returns the ring at which every cell of the grid has been visited.
+    int MaxRing(int cx, int cy) const;
+
+    std::vector<Point> m_Points;    // Points grouped by cell
+    std::vector<int> m_CellStart;   // Points of cell c are [m_CellStart[c], m_CellStart[c + 1])
+    double m_MinX = 0.0;            // Grid origin
+    double m_MinY = 0.0;
+    double m_CellSize = 1.0;        // Side length of a square cell
+    int m_Columns = 0;              // Grid dimensions
+    int m_Rows = 0;
+};
+
+#endif
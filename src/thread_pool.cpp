@@ -0,0 +1,62 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+/**
+ * Constructor: Starts the workers.
+ * @param threads The number of workers; 0 uses one per hardware thread.
+ */
+ThreadPool::ThreadPool(std::size_t threads) {
+    if (threads == 0) {
+        threads = HardwareThreads();
+    }
+    m_Workers.reserve(threads);
+    for (std::size_t i = 0; i < threads; ++i) {
+        m_Workers.emplace_back([this] { Work(); });
+    }
+}
+
+/**
+ * Destructor: Finishes the queued tasks and joins the workers.
+ */
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_Stopping = true;
+    }
+    m_Ready.notify_all();
+    for (auto& worker : m_Workers) {
+        worker.join();
+    }
+}
+
+/**
+ * Returns the number of hardware threads, at least 1.
+ */
+std::size_t ThreadPool::HardwareThreads() noexcept {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::Enqueue(std::function<void()> task) {
+    {
+        std::lock_guard lock{m_Mutex};
+        m_Tasks.push_back(std::move(task));
+    }
+    m_Ready.notify_one();
+}
+
+/**
+ * Worker loop: runs queued tasks until the pool stops and the queue is empty.
+ */
+void ThreadPool::Work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock{m_Mutex};
+            m_Ready.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+            if (m_Tasks.empty()) return;
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+        task();  // Exceptions are captured by the packaged task
+    }
+}
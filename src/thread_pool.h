@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * The ThreadPool class runs tasks on a fixed set of worker threads. Tasks are taken
+ * from a single FIFO queue; results and exceptions are delivered through futures.
+ * The destructor finishes every queued task before joining the workers.
+ */
+class ThreadPool {
+public:
+    /**
+     * Constructor: Starts the workers.
+     * @param threads The number of workers; 0 uses one per hardware thread.
+     */
+    explicit ThreadPool(std::size_t threads = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    /**
+     * Returns the number of workers.
+     */
+    std::size_t Size() const noexcept { return m_Workers.size(); }
+
+    /**
+     * Queues a task.
+     * @param task A callable without arguments.
+     * @return A future for the result of the task.
+     */
+    template <typename F>
+    auto Submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        auto result = packaged->get_future();
+        Enqueue([packaged] { (*packaged)(); });
+        return result;
+    }
+
+    /**
+     * Calls body(i) for every i in [0, count) on the workers and waits for all calls.
+     * If calls throw, the exception of the lowest i is rethrown once all calls finished.
+     * Must not be called from a task running on the same pool.
+     * @param count The number of calls.
+     * @param body A callable taking a std::size_t.
+     */
+    template <typename F>
+    void ParallelFor(std::size_t count, F&& body) {
+        std::vector<std::future<void>> done;
+        done.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            done.push_back(Submit([&body, i] { body(i); }));
+        }
+        for (auto& d : done) d.wait();
+        for (auto& d : done) d.get();
+    }
+
+    /**
+     * Returns the number of hardware threads, at least 1.
+     */
+    static std::size_t HardwareThreads() noexcept;
+
+private:
+    void Enqueue(std::function<void()> task);
+    void Work();
+
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Tasks;  // Queued tasks, oldest first
+    std::mutex m_Mutex;                         // Guards m_Tasks and m_Stopping
+    std::condition_variable m_Ready;            // Signalled when a task is queued or the pool stops
+    bool m_Stopping = false;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/batch_query.h"
+#include "../src/contraction_hierarchy.h"
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+
+//--------------------------------//
+//   Beginning Batch Query Tests.
+//--------------------------------//
+
+class BatchQueryTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    RouteModel model{osm_data->Bytes()};
+    std::string queries = "10 10 90 90\n"
+                          "\n"
+                          "# a comment\n"
+                          "50 50 20 80\r\n"
+                          "  33.5 71 5 95\n"
+                          "90 20 62 12\n";
+
+    std::string Run(const std::string& input, const BatchOptions& options, std::size_t expected_count) {
+        std::istringstream in{input};
+        std::ostringstream out;
+        EXPECT_EQ(RunBatchQueries(model, in, out, options), expected_count);
+        return out.str();
+    }
+
+    // Checks every result line against a single route query.
+    void ExpectMatchesPlanner(const std::string& output) {
+        const float coords[][4] = {{10, 10, 90, 90}, {50, 50, 20, 80}, {33.5, 71, 5, 95}, {90, 20, 62, 12}};
+        const RouteModel& shared_model = model;
+        SearchContext context;
+        std::istringstream lines{output};
+        std::string line;
+        for (const auto& c : coords) {
+            ASSERT_TRUE(std::getline(lines, line));
+            RoutePlanner planner{shared_model, context, c[0], c[1], c[2], c[3]};
+            planner.AStarSearch();
+            std::istringstream fields{line};
+            float distance;
+            fields >> distance;
+            EXPECT_NEAR(distance, planner.GetDistance(), 0.01f);
+            std::vector<int> path;
+            for (int index; fields >> index;) path.push_back(index);
+            ASSERT_EQ(path.size(), planner.Path().size());
+            for (std::size_t i = 0; i < path.size(); i++) {
+                EXPECT_EQ(path[i], planner.Path()[i].Index());
+            }
+        }
+        EXPECT_FALSE(std::getline(lines, line));
+    }
+};
+
+
+// Test that the results match the route planner, in input order, for any number of threads.
+TEST_F(BatchQueryTest, TestMatchesPlanner) {
+    BatchOptions options;
+    options.threads = 1;
+    const auto single = Run(queries, options, 4);
+    ExpectMatchesPlanner(single);
+
+    options.threads = 3;
+    options.chunk_size = 3;
+    EXPECT_EQ(Run(queries, options, 4), single);
+}
+
+
+// Test that queries answered with a contraction hierarchy have the same distances.
+TEST_F(BatchQueryTest, TestHierarchy) {
+    ContractionHierarchy hierarchy{model};
+    BatchOptions options;
+    options.threads = 2;
+    options.hierarchy = &hierarchy;
+    std::istringstream plain{Run(queries, {}, 4)};
+    std::istringstream contracted{Run(queries, options, 4)};
+    std::string plain_line, contracted_line;
+    while (std::getline(plain, plain_line)) {
+        ASSERT_TRUE(std::getline(contracted, contracted_line));
+        EXPECT_NEAR(std::stof(contracted_line), std::stof(plain_line), 0.01f);
+    }
+    EXPECT_FALSE(std::getline(contracted, contracted_line));
+}
+
+
+// Test that invalid lines are reported by line number without stopping the batch.
+TEST_F(BatchQueryTest, TestInvalidLines) {
+    const auto output = Run("10 10 90\n# skipped\n10 10 90 90 7\nten 10 90 90\n10 10 90 90\n", {}, 4);
+    std::istringstream lines{output};
+    std::string line;
+    ASSERT_TRUE(std::getline(lines, line));
+    EXPECT_EQ(line, "error 1");
+    ASSERT_TRUE(std::getline(lines, line));
+    EXPECT_EQ(line, "error 3");
+    ASSERT_TRUE(std::getline(lines, line));
+    EXPECT_EQ(line, "error 4");
+    ASSERT_TRUE(std::getline(lines, line));
+    EXPECT_GT(std::stof(line), 0.0f);
+
+    EXPECT_EQ(Run("", {}, 0), "");
+}
+
+
+// Test that a map without routable roads answers every query with no route.
+TEST(BatchQueryWithoutRoadsTest, TestNoRoutableNode) {
+    const std::string xml = "<osm version=\"0.6\">\n"
+                            " <bounds minlat=\"0\" minlon=\"0\" maxlat=\"0.01\" maxlon=\"0.01\"/>\n"
+                            " <node id=\"1\" lat=\"0.001\" lon=\"0.001\"/>\n"
+                            " <node id=\"2\" lat=\"0.009\" lon=\"0.009\"/>\n"
+                            " <node id=\"3\" lat=\"0.001\" lon=\"0.009\"/>\n"
+                            " <way id=\"10\"><nd ref=\"1\"/><nd ref=\"2\"/><tag k=\"highway\" v=\"footway\"/></way>\n"
+                            " <way id=\"11\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"1\"/>"
+                            "<tag k=\"building\" v=\"yes\"/></way>\n"
+                            "</osm>\n";
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    const RouteModel model{bytes, 1};
+    ASSERT_FALSE(model.SNodes().empty());
+    EXPECT_EQ(model.FindClosestNode(0.1f, 0.1f), RouteModel::kNoNode);
+
+    std::istringstream in{"10 10 90 90\n50 50 20 80\n"};
+    std::ostringstream out;
+    EXPECT_EQ(RunBatchQueries(model, in, out, {}), 2);
+    EXPECT_EQ(out.str(), "-1\n-1\n");
+}
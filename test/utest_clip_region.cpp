@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "../src/clip_region.h"
+
+//--------------------------------//
+//   Beginning ClipRegion Tests.
+//--------------------------------//
+
+// Test that a box contains the points within its edges, edges included.
+TEST(ClipRegionTest, TestBox) {
+    const auto box = ClipRegion::ParseBox(" 10.5, -2,11 ,+1e0");
+    EXPECT_EQ(box.MinLat(), 10.5);
+    EXPECT_EQ(box.MinLon(), -2);
+    EXPECT_EQ(box.MaxLat(), 11);
+    EXPECT_EQ(box.MaxLon(), 1);
+    EXPECT_TRUE(box.Contains(10.7, 0));
+    EXPECT_TRUE(box.Contains(10.5, -2));
+    EXPECT_TRUE(box.Contains(11, 1));
+    EXPECT_FALSE(box.Contains(10.4, 0));
+    EXPECT_FALSE(box.Contains(10.7, 1.1));
+
+    EXPECT_THROW(ClipRegion::Box(1, 0, 1, 2), std::invalid_argument);
+    EXPECT_THROW(ClipRegion::ParseBox("1,2,3"), std::invalid_argument);
+    EXPECT_THROW(ClipRegion::ParseBox("1,2,3,4,5"), std::invalid_argument);
+    EXPECT_THROW(ClipRegion::ParseBox("1,2,3,x"), std::invalid_argument);
+    EXPECT_THROW(ClipRegion::ParseBox("3,2,1,4"), std::invalid_argument);
+}
+
+
+// Test that a polygon with a hole agrees with a direct even-odd test at every point of a grid.
+TEST(ClipRegionTest, TestPolygonWithHole) {
+    // A star of many edges, so that its edges fall into many bands, around a square hole
+    std::vector<ClipRegion::Point> star, hole = {{-1, -1}, {-1, 1}, {1, 1}, {1, -1}};
+    for (int i = 0; i < 200; ++i) {
+        const double angle = 2 * M_PI * i / 200, radius = i % 2 == 0 ? 10 : 6;
+        star.push_back({radius * std::sin(angle), radius * std::cos(angle)});
+    }
+    const auto region = ClipRegion::Polygon({star, hole});
+    EXPECT_NEAR(region.MaxLat(), 10, 1e-9);
+    EXPECT_NEAR(region.MinLon(), -10, 1e-9);
+
+    const auto inside_ring = [](const std::vector<ClipRegion::Point>& ring, double lat, double lon) {
+        bool inside = false;
+        for (std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+            if ((ring[i].lat > lat) != (ring[j].lat > lat) &&
+                lon < ring[i].lon + (lat - ring[i].lat) * (ring[j].lon - ring[i].lon) / (ring[j].lat - ring[i].lat)) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    };
+    for (double lat = -11.05; lat < 11; lat += 0.1) {
+        for (double lon = -11.05; lon < 11; lon += 0.1) {
+            EXPECT_EQ(region.Contains(lat, lon), inside_ring(star, lat, lon) != inside_ring(hole, lat, lon));
+        }
+    }
+    EXPECT_TRUE(region.Contains(0, 3));
+    EXPECT_FALSE(region.Contains(0, 0));
+    EXPECT_FALSE(region.Contains(0, 10.5));
+
+    EXPECT_THROW(ClipRegion::Polygon({}), std::invalid_argument);
+    EXPECT_THROW(ClipRegion::Polygon({{{0, 0}, {1, 1}}}), std::invalid_argument);
+}
+
+
+// Test that .poly files are parsed with their holes, and malformed ones rejected.
+TEST(ClipRegionTest, TestParsePoly) {
+    const auto region = ClipRegion::ParsePoly(
+        "city\n"
+        "1\n"
+        "   0.0E+00   0.0E+00\n   1.0E+01   0.0E+00\n   1.0E+01   5.0E+00\n   0.0E+00   5.0E+00\nEND\n"
+        "!2\n"
+        "   4 2\n   6 2\n   6 3\n   4 3\r\nEND\n"
+        "END\n");
+    EXPECT_EQ(region.MinLat(), 0);
+    EXPECT_EQ(region.MaxLat(), 5);
+    EXPECT_EQ(region.MaxLon(), 10);
+    EXPECT_TRUE(region.Contains(1, 1));    // lat 1, lon 1
+    EXPECT_TRUE(region.Contains(4, 9));
+    EXPECT_FALSE(region.Contains(2.5, 5));  // In the hole
+    EXPECT_FALSE(region.Contains(1, 11));
+
+    EXPECT_THROW(ClipRegion::ParsePoly("city\n1\n 0 0\n 1 0\n 1 1\nEND\n"), std::invalid_argument);
+    EXPECT_THROW(ClipRegion::ParsePoly("city\n1\n 0 0\n 1 x\n 1 1\nEND\nEND\n"), std::invalid_argument);
+    EXPECT_THROW(ClipRegion::ParsePoly("city\nEND\n"), std::invalid_argument);
+}
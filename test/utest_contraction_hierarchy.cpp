@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../src/contraction_hierarchy.h"
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+
+//--------------------------------//
+//   Beginning ContractionHierarchy Tests.
+//--------------------------------//
+
+class ContractionHierarchyTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    RouteModel model{osm_data->Bytes()};
+    ContractionHierarchy hierarchy{model};
+
+    std::vector<std::array<float, 4>> Queries() const {
+        std::vector<std::array<float, 4>> queries{{10, 10, 90, 90}, {50, 50, 50, 50}, {90, 20, 10, 80}};
+        for (int i = 0; i < 12; i++) {
+            queries.push_back({7.f * i, 95.f - 6.f * i, 100.f - 8.f * i, 3.f * i});
+        }
+        return queries;
+    }
+
+    // Checks that hierarchy queries find routes as short as A* and made of graph edges.
+    void ExpectSameRoutes(const ContractionHierarchy& ch) {
+        const RouteModel& shared_model = model;
+        SearchContext context{shared_model.SNodes().size()};
+        for (auto& q : Queries()) {
+            RoutePlanner forward{shared_model, context, q[0], q[1], q[2], q[3]};
+            forward.AStarSearch();
+            RoutePlanner planner{shared_model, context, q[0], q[1], q[2], q[3]};
+            planner.SetSearchMode(RoutePlanner::SearchMode::ContractionHierarchy);
+            planner.SetContractionHierarchy(&ch);
+            planner.AStarSearch();
+
+            EXPECT_NEAR(planner.GetDistance(), forward.GetDistance(), 1e-4f * std::max(1.f, forward.GetDistance()));
+            const auto& path = planner.Path();
+            ASSERT_EQ(path.empty(), forward.Path().empty());
+            if (path.empty()) continue;
+            EXPECT_EQ(path.front().Index(), forward.Path().front().Index());
+            EXPECT_EQ(path.back().Index(), forward.Path().back().Index());
+            for (std::size_t i = 1; i < path.size(); i++) {
+                auto neighbors = model.Neighbors(path[i - 1].Index());
+                EXPECT_NE(std::find(neighbors.begin(), neighbors.end(), path[i].Index()), neighbors.end());
+            }
+        }
+    }
+};
+
+
+// Test that hierarchy queries match the A* search.
+TEST_F(ContractionHierarchyTest, TestMatchesAStar) {
+    EXPECT_EQ(hierarchy.NodeCount(), model.SNodes().size());
+    EXPECT_GT(hierarchy.ShortcutCount(), 0);
+    ExpectSameRoutes(hierarchy);
+
+    // A planner bound to a mutable model publishes the unpacked path.
+    RoutePlanner planner{model, 10, 10, 90, 90};
+    planner.SetSearchMode(RoutePlanner::SearchMode::ContractionHierarchy);
+    EXPECT_THROW(planner.AStarSearch(), std::logic_error);
+    planner.SetContractionHierarchy(&hierarchy);
+    planner.AStarSearch();
+    EXPECT_FALSE(model.path.empty());
+    EXPECT_EQ(model.path.size(), planner.Path().size());
+}
+
+
+// Test that a hierarchy survives a round trip through its file format.
+TEST_F(ContractionHierarchyTest, TestRoundTrip) {
+    std::ostringstream os;
+    hierarchy.Write(os);
+    const std::string image = os.str();
+    std::vector<std::byte> bytes(image.size());
+    std::memcpy(bytes.data(), image.data(), image.size());
+    Span<const std::byte> data{bytes.data(), bytes.size()};
+    ASSERT_TRUE(ContractionHierarchy::Matches(data));
+
+    const auto loaded = ContractionHierarchy::Load(data, model);
+    EXPECT_EQ(loaded.EdgeCount(), hierarchy.EdgeCount());
+    EXPECT_EQ(loaded.ShortcutCount(), hierarchy.ShortcutCount());
+    for (std::size_t i = 0; i < model.SNodes().size(); i++) {
+        ASSERT_EQ(loaded.Rank(i), hierarchy.Rank(i));
+    }
+    ExpectSameRoutes(loaded);
+
+    // Truncated and corrupted files are rejected.
+    EXPECT_THROW(ContractionHierarchy::Load({bytes.data(), bytes.size() / 2}, model), std::logic_error);
+    auto corrupt = bytes;
+    const std::uint64_t huge = ~0ULL;
+    std::memcpy(corrupt.data() + 32, &huge, sizeof(huge));
+    EXPECT_THROW(ContractionHierarchy::Load({corrupt.data(), corrupt.size()}, model), std::logic_error);
+}
@@ -0,0 +1,120 @@
+#include "gtest/gtest.h"
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <bzlib.h>
+#include <zlib.h>
+#include "../src/decompressor.h"
+#include "../src/mapped_file.h"
+#include "../src/model.h"
+
+//--------------------------------//
+//   Beginning Decompressor Tests.
+//--------------------------------//
+
+class DecompressorTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    std::string xml{reinterpret_cast<const char*>(osm_data->Bytes().data()), osm_data->Bytes().size()};
+
+    static std::vector<std::byte> Gzip(const std::string& text) {
+        z_stream stream{};
+        deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        std::vector<std::byte> out(deflateBound(&stream, text.size()));
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(text.data()));
+        stream.avail_in = text.size();
+        stream.next_out = reinterpret_cast<Bytef*>(out.data());
+        stream.avail_out = out.size();
+        EXPECT_EQ(deflate(&stream, Z_FINISH), Z_STREAM_END);
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return out;
+    }
+
+    static std::vector<std::byte> Bzip2(const std::string& text) {
+        std::vector<std::byte> out(text.size() + text.size() / 100 + 600);
+        unsigned size = out.size();
+        EXPECT_EQ(BZ2_bzBuffToBuffCompress(reinterpret_cast<char*>(out.data()), &size, const_cast<char*>(text.data()),
+                                           text.size(), 9, 0, 0), BZ_OK);
+        out.resize(size);
+        return out;
+    }
+
+    static std::string Decompress(const std::vector<std::byte>& data, std::size_t chunk_size) {
+        std::string out;
+        Decompressor::Stream({data.data(), data.size()}, [&](const char* chunk, std::size_t size) {
+            EXPECT_LE(size, chunk_size);
+            out.append(chunk, size);
+        }, chunk_size);
+        return out;
+    }
+};
+
+
+// Test that gzip and bzip2 data are recognised and restored exactly, in chunks of any size.
+TEST_F(DecompressorTest, TestRoundTrip) {
+    const auto gzip = Gzip(xml), bzip2 = Bzip2(xml);
+    EXPECT_EQ(Decompressor::Detect({gzip.data(), gzip.size()}), Decompressor::Format::Gzip);
+    EXPECT_EQ(Decompressor::Detect({bzip2.data(), bzip2.size()}), Decompressor::Format::Bzip2);
+    EXPECT_EQ(Decompressor::Detect(osm_data->Bytes()), Decompressor::Format::None);
+    for (std::size_t chunk_size : {1000, 65536, 1 << 24}) {
+        EXPECT_EQ(Decompress(gzip, chunk_size), xml);
+        EXPECT_EQ(Decompress(bzip2, chunk_size), xml);
+    }
+}
+
+
+// Test that concatenated compressed streams are decompressed one after the other.
+TEST_F(DecompressorTest, TestConcatenatedStreams) {
+    const auto half = xml.size() / 2;
+    for (auto compress : {&Gzip, &Bzip2}) {
+        auto data = compress(xml.substr(0, half));
+        const auto second = compress(xml.substr(half));
+        data.insert(data.end(), second.begin(), second.end());
+        EXPECT_EQ(Decompress(data, 4096), xml);
+    }
+}
+
+
+// Test that truncated or corrupt data and errors of the consumer are reported.
+TEST_F(DecompressorTest, TestErrors) {
+    for (auto compress : {&Gzip, &Bzip2}) {
+        auto data = compress(xml);
+        auto truncated = data;
+        truncated.resize(truncated.size() / 2);
+        EXPECT_THROW(Decompress(truncated, 4096), std::logic_error);
+        std::memset(data.data() + 20, 0x55, 64);
+        EXPECT_THROW(Decompress(data, 4096), std::logic_error);
+    }
+
+    const auto gzip = Gzip(xml);
+    int calls = 0;
+    const auto consume = [&](const char*, std::size_t) {
+        if (++calls == 3) throw std::runtime_error("Stop");
+    };
+    EXPECT_THROW(Decompressor::Stream({gzip.data(), gzip.size()}, consume, 1000), std::runtime_error);
+    EXPECT_EQ(calls, 3);
+}
+
+
+// Test that a model loads the same from compressed and uncompressed OSM data.
+TEST_F(DecompressorTest, TestCompressedModel) {
+    const Model plain{osm_data->Bytes()};
+    for (auto compress : {&Gzip, &Bzip2}) {
+        const Model model{compress(xml)};
+        ASSERT_EQ(model.Nodes().size(), plain.Nodes().size());
+        for (std::size_t i = 0; i < plain.Nodes().size(); ++i) {
+            EXPECT_EQ(model.Nodes()[i].x, plain.Nodes()[i].x);
+            EXPECT_EQ(model.Nodes()[i].y, plain.Nodes()[i].y);
+        }
+        EXPECT_EQ(model.WayIds(), plain.WayIds());
+        EXPECT_EQ(model.Roads().size(), plain.Roads().size());
+        EXPECT_EQ(model.Buildings().size(), plain.Buildings().size());
+    }
+
+    auto truncated = Gzip(xml);
+    truncated.resize(truncated.size() / 2);
+    EXPECT_THROW((Model{truncated}), std::logic_error);
+}
@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <vector>
+#include "../src/contraction_hierarchy.h"
+#include "../src/distance_matrix.h"
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+
+//--------------------------------//
+//   Beginning DistanceMatrix Tests.
+//--------------------------------//
+
+class DistanceMatrixTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    RouteModel model{osm_data->Bytes()};
+    std::vector<DistanceMatrix::Point> sources{{10, 10}, {50, 50}, {90, 20}, {33, 71}, {5, 95}};
+    std::vector<DistanceMatrix::Point> targets{{90, 90}, {10, 80}, {50, 50}, {62, 12}};
+
+    // Checks every entry against a single route query between the two points.
+    void ExpectMatchesPlanner(const DistanceMatrix& matrix) {
+        ASSERT_EQ(matrix.Rows(), sources.size());
+        ASSERT_EQ(matrix.Cols(), targets.size());
+        ASSERT_EQ(matrix.Values().size(), sources.size() * targets.size());
+        const RouteModel& shared_model = model;
+        SearchContext context{shared_model.SNodes().size()};
+        for (std::size_t row = 0; row < sources.size(); row++) {
+            for (std::size_t col = 0; col < targets.size(); col++) {
+                RoutePlanner planner{shared_model, context, sources[row].x, sources[row].y, targets[col].x, targets[col].y};
+                planner.AStarSearch();
+                if (planner.Path().empty()) {
+                    EXPECT_EQ(matrix(row, col), std::numeric_limits<float>::infinity());
+                } else {
+                    EXPECT_NEAR(matrix(row, col), planner.GetDistance(), 1e-4f * std::max(1.f, planner.GetDistance()));
+                }
+            }
+        }
+    }
+};
+
+
+// Test that the Dijkstra sweeps match the route planner.
+TEST_F(DistanceMatrixTest, TestSweeps) {
+    ExpectMatchesPlanner(DistanceMatrix{model, sources, targets, nullptr, 1});
+    ExpectMatchesPlanner(DistanceMatrix{model, sources, targets, nullptr, 3});
+}
+
+
+// Test that the bucket search in a contraction hierarchy matches the route planner.
+TEST_F(DistanceMatrixTest, TestHierarchyBuckets) {
+    ContractionHierarchy hierarchy{model};
+    ExpectMatchesPlanner(DistanceMatrix{model, sources, targets, &hierarchy, 1});
+    ExpectMatchesPlanner(DistanceMatrix{model, sources, targets, &hierarchy, 3});
+
+    DistanceMatrix empty{model, std::vector<DistanceMatrix::Point>{}, targets, &hierarchy};
+    EXPECT_EQ(empty.Rows(), 0);
+    EXPECT_TRUE(empty.Values().empty());
+}
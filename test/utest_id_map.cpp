@@ -0,0 +1,29 @@
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include "../src/id_map.h"
+
+//--------------------------------//
+//   Beginning IdMap Tests.
+//--------------------------------//
+
+// Test lookups, overwrites and growth against std::unordered_map.
+TEST(IdMapTest, TestMatchesUnorderedMap) {
+    std::mt19937_64 rng{7};
+    IdMap ids;
+    std::unordered_map<std::int64_t, int> expected;
+    for (int i = 0; i < 20000; ++i) {
+        // Mix sequential IDs (as in OSM files), negative IDs and large random IDs
+        const std::int64_t id = i % 3 == 0 ? i : i % 3 == 1 ? -static_cast<std::int64_t>(rng() % 5000)
+                                                           : static_cast<std::int64_t>(rng() >> 2);
+        ids.Insert(id, i);
+        expected[id] = i;
+    }
+    EXPECT_EQ(ids.Size(), expected.size());
+    for (const auto& [id, index] : expected) {
+        EXPECT_EQ(ids.Find(id), index);
+    }
+    EXPECT_EQ(ids.Find(-123456789), IdMap::kNotFound);
+    EXPECT_EQ(IdMap{}.Find(0), IdMap::kNotFound);
+}
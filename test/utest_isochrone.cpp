@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include "../src/isochrone.h"
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+
+//--------------------------------//
+//   Beginning One-to-all and Isochrone Tests.
+//--------------------------------//
+
+static double SignedArea(const std::vector<Model::Node>& polygon) {
+    double area = 0;
+    for (std::size_t i = 0; i < polygon.size(); ++i) {
+        const auto& a = polygon[i];
+        const auto& b = polygon[(i + 1) % polygon.size()];
+        area += a.x * b.y - b.x * a.y;
+    }
+    return area / 2;
+}
+
+static bool Contains(const std::vector<Model::Node>& polygon, double x, double y) {
+    bool inside = false;
+    for (std::size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const auto& a = polygon[i];
+        const auto& b = polygon[j];
+        if ((a.y > y) != (b.y > y) && x < (b.x - a.x) * (y - a.y) / (b.y - a.y) + a.x) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+class IsochroneTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    RouteModel model{osm_data->Bytes()};
+    SearchContext context{model.SNodes().size()};
+};
+
+
+// Test that the one-to-all search labels nodes with their shortest distances, up to the cutoff.
+TEST_F(IsochroneTest, TestOneToAll) {
+    const RouteModel& shared_model = model;
+    RoutePlanner planner{shared_model, context, 50, 50, 50, 50};
+    const auto all = planner.OneToAll();
+    ASSERT_FALSE(all.empty());
+    EXPECT_EQ(all.front().distance, 0.f);
+    EXPECT_EQ(all.front().parent, SearchContext::kNoParent);
+    EXPECT_EQ(planner.SettledNodeCount(), all.size());
+    EXPECT_TRUE(std::is_sorted(all.begin(), all.end(), [](auto& a, auto& b) { return a.distance < b.distance; }));
+
+    std::vector<float> dist(model.SNodes().size(), std::numeric_limits<float>::infinity());
+    for (auto& r : all) {
+        dist[r.index] = r.distance;
+    }
+    for (auto& r : all) {
+        if (r.parent == SearchContext::kNoParent) continue;
+        const float edge = model.SNodes()[r.index].distance(model.SNodes()[r.parent]) * model.MetricScale();
+        EXPECT_NEAR(r.distance, dist[r.parent] + edge, 1e-3f * std::max(1.f, r.distance));
+    }
+
+    // A* agrees with the tree on a few targets.
+    for (float t : {10.f, 35.f, 80.f}) {
+        RoutePlanner route{shared_model, context, 50, 50, t, 100 - t};
+        route.AStarSearch();
+        if (route.Path().empty()) continue;
+        EXPECT_NEAR(dist[route.Path().back().Index()], route.GetDistance(), 1e-3f * std::max(1.f, route.GetDistance()));
+    }
+
+    // The cutoff keeps exactly the nodes within the distance.
+    const float cutoff = all[all.size() / 3].distance;
+    const auto near = planner.OneToAll(cutoff);
+    EXPECT_EQ(near.size(), std::count_if(all.begin(), all.end(), [&](auto& r) { return r.distance <= cutoff; }));
+    for (auto& r : near) {
+        EXPECT_LE(r.distance, cutoff);
+        EXPECT_EQ(r.distance, dist[r.index]);
+    }
+}
+
+
+// Test that isochrones enclose the reached nodes and grow with the distance.
+TEST_F(IsochroneTest, TestIsochrone) {
+    const RouteModel& shared_model = model;
+    RoutePlanner planner{shared_model, context, 50, 50, 50, 50};
+    double last_area = 0;
+    for (float cutoff : {100.f, 300.f, 600.f}) {
+        const auto polygon = planner.Isochrone(cutoff, 10.f);
+        ASSERT_GE(polygon.size(), 4);
+        const double area = SignedArea(polygon);
+        EXPECT_GT(area, last_area);  // Counter-clockwise and growing
+        last_area = area;
+        for (auto& r : planner.OneToAll(cutoff)) {
+            const auto& node = model.SNodes()[r.index];
+            EXPECT_TRUE(Contains(polygon, node.x, node.y));
+        }
+    }
+    EXPECT_THROW(planner.Isochrone(100.f, 0.f), std::invalid_argument);
+    EXPECT_TRUE(TraceIsochrone(model, {}, 100.f, 10.f).empty());
+}
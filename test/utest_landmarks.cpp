@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <vector>
+#include "../src/landmarks.h"
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+#include "../src/route_planner.h"
+
+//--------------------------------//
+//   Beginning Landmarks Tests.
+//--------------------------------//
+
+class LandmarksTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    RouteModel model{osm_data->Bytes()};
+
+    std::vector<std::array<float, 4>> Queries() const {
+        std::vector<std::array<float, 4>> queries{{10, 10, 90, 90}, {50, 50, 50, 50}, {90, 20, 10, 80}};
+        for (int i = 0; i < 12; i++) {
+            queries.push_back({7.f * i, 95.f - 6.f * i, 100.f - 8.f * i, 3.f * i});
+        }
+        return queries;
+    }
+};
+
+
+// Test that landmark bounds never exceed the shortest distances and ALT finds the same routes.
+TEST_F(LandmarksTest, TestAltSearch) {
+    for (auto selection : {Landmarks::Selection::Farthest, Landmarks::Selection::Avoid}) {
+        Landmarks landmarks{model, 8, selection, 2};
+        ASSERT_EQ(landmarks.Count(), 8);
+        const RouteModel& shared_model = model;
+        SearchContext context{shared_model.SNodes().size()};
+        std::size_t plain_settled = 0, alt_settled = 0;
+        for (auto& q : Queries()) {
+            RoutePlanner plain{shared_model, context, q[0], q[1], q[2], q[3]};
+            plain.AStarSearch();
+            plain_settled += plain.SettledNodeCount();
+            if (plain.Path().empty()) continue;
+            const int from = plain.Path().front().Index();
+            const int to = plain.Path().back().Index();
+            EXPECT_LE(landmarks.LowerBound(from, to) * model.MetricScale(), plain.GetDistance() * (1 + 1e-4f) + 1e-3f);
+
+            for (auto mode : {RoutePlanner::SearchMode::Unidirectional, RoutePlanner::SearchMode::Bidirectional}) {
+                RoutePlanner alt{shared_model, context, q[0], q[1], q[2], q[3]};
+                alt.SetLandmarks(&landmarks);
+                alt.SetSearchMode(mode);
+                alt.AStarSearch();
+                EXPECT_NEAR(alt.GetDistance(), plain.GetDistance(), 1e-4f * std::max(1.f, plain.GetDistance()));
+                if (mode == RoutePlanner::SearchMode::Unidirectional) {
+                    alt_settled += alt.SettledNodeCount();
+                }
+            }
+        }
+        EXPECT_LT(alt_settled, plain_settled);
+    }
+}
+
+
+// Test that the distance tables do not depend on the number of threads computing them.
+TEST_F(LandmarksTest, TestParallelTables) {
+    Landmarks serial{model, 6, Landmarks::Selection::Farthest, 1};
+    Landmarks parallel{model, 6, Landmarks::Selection::Farthest, 3};
+    ASSERT_EQ(serial.Nodes(), parallel.Nodes());
+    for (std::size_t l = 0; l < serial.Count(); l++) {
+        EXPECT_EQ(serial.Distance(l, serial.Nodes()[l]), 0.f);
+        for (std::size_t v = 0; v < model.SNodes().size(); v++) {
+            ASSERT_EQ(serial.Distance(l, v), parallel.Distance(l, v));
+        }
+    }
+}
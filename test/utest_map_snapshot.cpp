@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../src/clip_region.h"
+#include "../src/map_snapshot.h"
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+
+//--------------------------------//
+//   Beginning MapSnapshot Tests.
+//--------------------------------//
+
+static std::vector<std::byte> ToBytes(const std::string& s) {
+    std::vector<std::byte> bytes(s.size());
+    std::memcpy(bytes.data(), s.data(), s.size());
+    return bytes;
+}
+
+static std::vector<int> ToVector(Span<const int> span) { return {span.begin(), span.end()}; }
+
+template <typename MP>
+static void ExpectSameMultipolygons(const Model& model_a, const std::vector<MP>& a, const Model& model_b,
+                                    const std::vector<MP>& b) {
+    ASSERT_EQ(a.size(), b.size());
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        EXPECT_EQ(ToVector(model_a.OuterWays(a[i])), ToVector(model_b.OuterWays(b[i])));
+        EXPECT_EQ(ToVector(model_a.InnerWays(a[i])), ToVector(model_b.InnerWays(b[i])));
+    }
+}
+
+class MapSnapshotTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    RouteModel model{osm_data->Bytes()};
+};
+
+
+// Test that a model loaded from a mapped snapshot is identical to the parsed one.
+TEST_F(MapSnapshotTest, TestRoundTrip) {
+    const std::string path = ::testing::TempDir() + "map_snapshot_round_trip.rpmap";
+    MapSnapshot::Write(model, path);
+    auto snapshot = MappedFile::Open(path);
+    ASSERT_TRUE(snapshot);
+    ASSERT_TRUE(MapSnapshot::Matches(snapshot->Bytes()));
+    EXPECT_FALSE(MapSnapshot::Matches(osm_data->Bytes()));
+
+    RouteModel loaded{snapshot->Bytes()};
+    EXPECT_EQ(loaded.MetricScale(), model.MetricScale());
+
+    ASSERT_EQ(loaded.SNodes().size(), model.SNodes().size());
+    for (std::size_t i = 0; i < model.SNodes().size(); ++i) {
+        EXPECT_EQ(loaded.SNodes()[i].x, model.SNodes()[i].x);
+        EXPECT_EQ(loaded.SNodes()[i].y, model.SNodes()[i].y);
+        const auto neighbors = loaded.Neighbors(i), expected = model.Neighbors(i);
+        EXPECT_TRUE(std::equal(neighbors.begin(), neighbors.end(), expected.begin(), expected.end()));
+        const auto lengths = loaded.NeighborDistances(i), expected_lengths = model.NeighborDistances(i);
+        EXPECT_TRUE(std::equal(lengths.begin(), lengths.end(), expected_lengths.begin(), expected_lengths.end()));
+    }
+
+    ASSERT_EQ(loaded.Ways().size(), model.Ways().size());
+    for (std::size_t i = 0; i < model.Ways().size(); ++i) {
+        EXPECT_EQ(ToVector(loaded.WayNodes(loaded.Ways()[i])), ToVector(model.WayNodes(model.Ways()[i])));
+    }
+    EXPECT_EQ(loaded.NodeIds(), model.NodeIds());
+    EXPECT_EQ(loaded.WayIds(), model.WayIds());
+    ASSERT_EQ(loaded.Roads().size(), model.Roads().size());
+    for (std::size_t i = 0; i < model.Roads().size(); ++i) {
+        EXPECT_EQ(loaded.Roads()[i].way, model.Roads()[i].way);
+        EXPECT_EQ(loaded.Roads()[i].type, model.Roads()[i].type);
+    }
+    ASSERT_EQ(loaded.Railways().size(), model.Railways().size());
+    for (std::size_t i = 0; i < model.Railways().size(); ++i) {
+        EXPECT_EQ(loaded.Railways()[i].way, model.Railways()[i].way);
+    }
+    ExpectSameMultipolygons(loaded, loaded.Buildings(), model, model.Buildings());
+    ExpectSameMultipolygons(loaded, loaded.Leisures(), model, model.Leisures());
+    ExpectSameMultipolygons(loaded, loaded.Waters(), model, model.Waters());
+    ExpectSameMultipolygons(loaded, loaded.Landuses(), model, model.Landuses());
+    for (std::size_t i = 0; i < model.Landuses().size(); ++i) {
+        EXPECT_EQ(loaded.Landuses()[i].type, model.Landuses()[i].type);
+    }
+
+    EXPECT_EQ(loaded.FindClosestNode(0.3f, 0.6f), model.FindClosestNode(0.3f, 0.6f));
+}
+
+
+// Test that truncated, corrupted and outdated snapshots are rejected.
+TEST_F(MapSnapshotTest, TestRejectInvalid) {
+    std::ostringstream os;
+    MapSnapshot::Write(model, os);
+    const std::string image = os.str();
+
+    const auto truncated = ToBytes(image.substr(0, image.size() / 2));
+    EXPECT_THROW(RouteModel{truncated}, std::logic_error);
+
+    std::string corrupt = image;
+    std::memset(&corrupt[40], 0xff, 8);  // Length of the first array after the header
+    EXPECT_THROW(RouteModel{ToBytes(corrupt)}, std::logic_error);
+
+    std::string outdated = image;
+    const std::uint32_t version = MapSnapshot::kVersion + 1;
+    std::memcpy(&outdated[8], &version, sizeof(version));
+    EXPECT_THROW(RouteModel{ToBytes(outdated)}, std::logic_error);
+}
+
+
+// Test that a multipolygon referring to a way past the last one is rejected, even when the index
+// is a valid node index.
+TEST_F(MapSnapshotTest, TestRejectRingWayOutOfRange) {
+    ASSERT_FALSE(model.Buildings().empty());
+    ASSERT_GT(model.Nodes().size(), model.Ways().size());
+    std::ostringstream os;
+    MapSnapshot::Write(model, os);
+    std::string corrupt = os.str();
+
+    // Skip the bounds, nodes, way lists, roads and railways to the outer ways of the buildings
+    std::uint64_t model_offset;
+    std::memcpy(&model_offset, &corrupt[16], sizeof(model_offset));
+    std::size_t pos = model_offset;
+    const auto skip = [&](std::size_t element_size) {
+        std::uint64_t count;
+        std::memcpy(&count, &corrupt[pos], sizeof(count));
+        pos = (pos + sizeof(count) + count * element_size + 7) / 8 * 8;
+    };
+    for (const std::size_t element_size : {sizeof(double), 2 * sizeof(double), sizeof(int), sizeof(int), sizeof(int),
+                                           sizeof(int), sizeof(int), sizeof(int)}) {
+        skip(element_size);
+    }
+    std::uint64_t count;
+    std::memcpy(&count, &corrupt[pos], sizeof(count));
+    ASSERT_GT(count, 0);
+    const int way = static_cast<int>(model.Nodes().size()) - 1;
+    std::memcpy(&corrupt[pos + sizeof(count)], &way, sizeof(way));
+    EXPECT_THROW(RouteModel{ToBytes(corrupt)}, std::logic_error);
+}
+
+
+// Test that a snapshot is not clipped on load, and only passes as routing-only when it is.
+TEST_F(MapSnapshotTest, TestRejectOptionsForSnapshot) {
+    std::ostringstream os;
+    MapSnapshot::Write(model, os);
+    const std::vector<std::byte> full = ToBytes(os.str());
+    const Span<const std::byte> full_bytes{full.data(), full.size()};
+    const auto region = ClipRegion::Box(-90, -180, 90, 180);
+    EXPECT_THROW(RouteModel(full_bytes, 1, Model::Profile::Full, &region), std::invalid_argument);
+    EXPECT_THROW(RouteModel(full_bytes, 1, Model::Profile::Routing), std::invalid_argument);
+    EXPECT_NO_THROW(RouteModel(full_bytes, 1, Model::Profile::Full));
+
+    const RouteModel routing{osm_data->Bytes(), 1, Model::Profile::Routing};
+    std::ostringstream routing_os;
+    MapSnapshot::Write(routing, routing_os);
+    const std::vector<std::byte> roads = ToBytes(routing_os.str());
+    const RouteModel loaded{Span<const std::byte>{roads.data(), roads.size()}, 1, Model::Profile::Routing};
+    EXPECT_EQ(loaded.Nodes().size(), routing.Nodes().size());
+    EXPECT_EQ(loaded.Roads().size(), routing.Roads().size());
+}
@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+
+//--------------------------------//
+//   Beginning MappedFile Tests.
+//--------------------------------//
+
+static std::string WriteTempFile(const std::string& name, const std::string& contents) {
+    std::string path = ::testing::TempDir() + name;
+    std::ofstream os{path, std::ios::binary | std::ios::trunc};
+    os << contents;
+    return path;
+}
+
+
+// Test that the mapping exposes the file contents and survives a move.
+TEST(MappedFileTest, TestMapContents) {
+    const std::string contents = "<osm version=\"0.6\"></osm>\n";
+    auto file = MappedFile::Open(WriteTempFile("mapped_file_contents.osm", contents));
+    ASSERT_TRUE(file);
+    ASSERT_EQ(file->Size(), contents.size());
+    EXPECT_EQ(std::memcmp(file->Bytes().data(), contents.data(), contents.size()), 0);
+
+    MappedFile moved = std::move(*file);
+    EXPECT_EQ(file->Size(), 0);
+    ASSERT_EQ(moved.Size(), contents.size());
+    EXPECT_EQ(std::memcmp(moved.Bytes().data(), contents.data(), contents.size()), 0);
+}
+
+
+// Test that missing and empty files are rejected.
+TEST(MappedFileTest, TestOpenFailure) {
+    EXPECT_FALSE(MappedFile::Open(::testing::TempDir() + "mapped_file_missing.osm"));
+    EXPECT_FALSE(MappedFile::Open(WriteTempFile("mapped_file_empty.osm", "")));
+}
+
+
+// Test that a model parsed in place from a mapping matches one parsed from a buffer.
+TEST(MappedFileTest, TestModelFromMapping) {
+    const std::string path = "../map.osm";
+    auto file = MappedFile::Open(path);
+    ASSERT_TRUE(file);
+    auto bytes = file->Bytes();
+    std::vector<std::byte> buffer(bytes.begin(), bytes.end());
+
+    RouteModel mapped{file->Bytes()};
+    RouteModel copied{buffer};
+    ASSERT_EQ(mapped.SNodes().size(), copied.SNodes().size());
+    for (std::size_t i = 0; i < mapped.SNodes().size(); ++i) {
+        EXPECT_EQ(mapped.SNodes()[i].x, copied.SNodes()[i].x);
+        EXPECT_EQ(mapped.SNodes()[i].y, copied.SNodes()[i].y);
+    }
+    EXPECT_EQ(mapped.Ways().size(), copied.Ways().size());
+    EXPECT_EQ(mapped.Roads().size(), copied.Roads().size());
+    EXPECT_EQ(mapped.MetricScale(), copied.MetricScale());
+}
@@ -0,0 +1,447 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../src/clip_region.h"
+#include "../src/model.h"
+#include "../src/route_model.h"
+
+//--------------------------------//
+//   Beginning Model Tests.
+//--------------------------------//
+
+// Builds an OSM document of a grid of nodes joined by residential roads, a few MB in size.
+static std::string GridDocument(int size) {
+    std::string xml = "<?xml version=\"1.0\"?>\n<osm version=\"0.6\">\n"
+                      " <bounds minlat=\"0\" minlon=\"0\" maxlat=\"0.1\" maxlon=\"0.1\"/>\n";
+    for (int r = 0; r < size; ++r) {
+        for (int c = 0; c < size; ++c) {
+            xml += " <node id=\"" + std::to_string(1000 + r * size + c) + "\" lat=\"" + std::to_string(0.1 * r / size) +
+                   "\" lon=\"" + std::to_string(0.1 * c / size) + "\" version=\"1\" user=\"mapper\"/>\n";
+        }
+    }
+    for (int r = 0; r < size; ++r) {
+        xml += " <way id=\"" + std::to_string(50 + r) + "\">\n";
+        for (int c = 0; c < size; ++c) {
+            xml += "  <nd ref=\"" + std::to_string(1000 + r * size + c) + "\"/>\n";
+        }
+        xml += r % 7 == 0 ? "  <tag k=\"building\" v=\"yes\"/>\n" : "  <tag k=\"highway\" v=\"residential\"/>\n";
+        xml += " </way>\n";
+    }
+    xml += " <relation id=\"9\">\n  <member type=\"way\" ref=\"50\" role=\"outer\"/>\n"
+           "  <member type=\"way\" ref=\"57\" role=\"inner\"/>\n  <tag k=\"building\" v=\"yes\"/>\n </relation>\n";
+    xml += "</osm>\n";
+    return xml;
+}
+
+static std::vector<int> ToVector(Span<const int> span) { return {span.begin(), span.end()}; }
+
+
+// Test that loading on several threads gives exactly the single-threaded model.
+TEST(ModelTest, TestParallelLoadMatchesSerial) {
+    const std::string xml = GridDocument(200);
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    const Model serial{bytes, 1};
+
+    for (std::size_t threads : {2, 3, 8}) {
+        const Model parallel{bytes, threads};
+        ASSERT_EQ(parallel.Nodes().size(), serial.Nodes().size());
+        for (std::size_t i = 0; i < serial.Nodes().size(); ++i) {
+            EXPECT_EQ(parallel.Nodes()[i].x, serial.Nodes()[i].x);
+            EXPECT_EQ(parallel.Nodes()[i].y, serial.Nodes()[i].y);
+        }
+        EXPECT_EQ(parallel.NodeIds(), serial.NodeIds());
+        EXPECT_EQ(parallel.WayIds(), serial.WayIds());
+        ASSERT_EQ(parallel.Ways().size(), serial.Ways().size());
+        for (std::size_t i = 0; i < serial.Ways().size(); ++i) {
+            EXPECT_EQ(ToVector(parallel.WayNodes(parallel.Ways()[i])), ToVector(serial.WayNodes(serial.Ways()[i])));
+        }
+        ASSERT_EQ(parallel.Roads().size(), serial.Roads().size());
+        for (std::size_t i = 0; i < serial.Roads().size(); ++i) {
+            EXPECT_EQ(parallel.Roads()[i].way, serial.Roads()[i].way);
+        }
+        ASSERT_EQ(parallel.Buildings().size(), serial.Buildings().size());
+        for (std::size_t i = 0; i < serial.Buildings().size(); ++i) {
+            EXPECT_EQ(ToVector(parallel.OuterWays(parallel.Buildings()[i])), ToVector(serial.OuterWays(serial.Buildings()[i])));
+            EXPECT_EQ(ToVector(parallel.InnerWays(parallel.Buildings()[i])), ToVector(serial.InnerWays(serial.Buildings()[i])));
+        }
+    }
+}
+
+
+// Test that a missing <bounds> element is still reported when loading in pieces.
+TEST(ModelTest, TestParallelLoadWithoutBounds) {
+    std::string xml = GridDocument(200);
+    xml.erase(xml.find(" <bounds"), xml.find("<node") - xml.find(" <bounds") - 1);
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    EXPECT_THROW((Model{bytes, 4}), std::logic_error);
+}
+
+
+// Test that the node lists of the ways and the ring ways of the multipolygons are stored back to back.
+TEST(ModelTest, TestFlatWayStorage) {
+    const std::string xml = GridDocument(20);
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    for (std::size_t threads : {1, 3}) {
+        const Model model{bytes, threads};
+        ASSERT_EQ(model.Ways().size(), 20);
+        for (std::size_t i = 0; i < model.Ways().size(); ++i) {
+            const auto nodes = model.WayNodes(model.Ways()[i]);
+            ASSERT_EQ(nodes.size(), 20);
+            EXPECT_EQ(nodes.front(), 20 * i);
+            EXPECT_EQ(nodes.back(), 20 * i + 19);
+            if (i > 0) {
+                EXPECT_EQ(nodes.data(), model.WayNodes(model.Ways()[i - 1]).end());
+            }
+        }
+
+        // Buildings from ways 0, 7 and 14 followed by the relation of ways 0 and 7
+        ASSERT_EQ(model.Buildings().size(), 4);
+        const std::vector<std::vector<int>> outer = {{0}, {7}, {14}, {0}}, inner = {{}, {}, {}, {7}};
+        for (std::size_t i = 0; i < 4; ++i) {
+            EXPECT_EQ(ToVector(model.OuterWays(model.Buildings()[i])), outer[i]);
+            EXPECT_EQ(ToVector(model.InnerWays(model.Buildings()[i])), inner[i]);
+        }
+    }
+}
+
+
+// Builds an OSM document with the given nodes (OSM ID = position + 1), untagged ways of node
+// positions, and a forest multipolygon relation of ways given by position as outer members.
+static std::string RingDocument(int node_count, const std::vector<std::vector<int>>& ways, const std::vector<int>& members) {
+    std::string xml = "<osm version=\"0.6\">\n <bounds minlat=\"0\" minlon=\"0\" maxlat=\"0.1\" maxlon=\"0.1\"/>\n";
+    for (int i = 0; i < node_count; ++i) {
+        xml += " <node id=\"" + std::to_string(i + 1) + "\" lat=\"" + std::to_string(0.05 + 0.04 * std::sin(i)) +
+               "\" lon=\"" + std::to_string(0.05 + 0.04 * std::cos(i)) + "\"/>\n";
+    }
+    for (std::size_t w = 0; w < ways.size(); ++w) {
+        xml += " <way id=\"" + std::to_string(w + 1) + "\">\n";
+        for (int node : ways[w]) {
+            xml += "  <nd ref=\"" + std::to_string(node + 1) + "\"/>\n";
+        }
+        xml += " </way>\n";
+    }
+    xml += " <relation id=\"1\">\n";
+    for (int way : members) {
+        xml += "  <member type=\"way\" ref=\"" + std::to_string(way + 1) + "\" role=\"outer\"/>\n";
+    }
+    xml += "  <tag k=\"landuse\" v=\"forest\"/>\n </relation>\n</osm>\n";
+    return xml;
+}
+
+
+// Test that open ways are joined into rings in member order, reversing ways as needed, and
+// that ways which cannot be closed are dropped.
+TEST(ModelTest, TestRingAssembly) {
+    const std::string xml = RingDocument(8, {{0, 1, 2}, {4, 3, 2}, {4, 5, 0}, {6, 7}, {6, 7, 6}}, {2, 0, 3, 1, 4});
+    const Model model{{reinterpret_cast<const std::byte*>(xml.data()), xml.size()}};
+    ASSERT_EQ(model.Landuses().size(), 1);
+    const auto& forest = model.Landuses().front();
+    EXPECT_EQ(forest.type, Model::Landuse::Forest);
+    EXPECT_EQ(ToVector(model.OuterWays(forest)), (std::vector<int>{4, 5}));
+    EXPECT_TRUE(model.InnerWays(forest).empty());
+    ASSERT_EQ(model.Ways().size(), 6);
+    EXPECT_EQ(ToVector(model.WayNodes(model.Ways()[5])), (std::vector<int>{4, 5, 0, 0, 1, 2, 2, 3, 4}));
+    EXPECT_EQ(model.WayIds()[5], 0);
+}
+
+
+// Test that a ring of many ways listed out of order is assembled in one piece.
+TEST(ModelTest, TestLargeRingAssembly) {
+    constexpr int kWays = 20000;
+    std::vector<std::vector<int>> ways;
+    for (int w = 0; w < kWays; ++w) {
+        const int from = w, to = (w + 1) % kWays;
+        ways.push_back(w % 3 == 0 ? std::vector<int>{to, from} : std::vector<int>{from, to});
+    }
+    std::vector<int> members;
+    for (int i = 0; i < kWays; ++i) {
+        members.push_back(static_cast<int>((i * 7919LL) % kWays));  // A permutation, as 7919 is prime
+    }
+    const std::string xml = RingDocument(kWays, ways, members);
+    const Model model{{reinterpret_cast<const std::byte*>(xml.data()), xml.size()}};
+    ASSERT_EQ(model.Landuses().size(), 1);
+    const auto outer = model.OuterWays(model.Landuses().front());
+    ASSERT_EQ(outer.size(), 1);
+    const auto ring = model.WayNodes(model.Ways()[outer.front()]);
+    ASSERT_EQ(ring.size(), 2 * kWays);
+    EXPECT_EQ(ring.front(), ring.back());
+    for (std::size_t i = 1; i + 1 < ring.size(); i += 2) {
+        EXPECT_EQ(ring[i], ring[i + 1]);  // Consecutive ways share their end node
+    }
+}
+
+
+// Test that the routing profile keeps the roads and their nodes only, with dense node indices,
+// and that they match the roads of the full model.
+TEST(ModelTest, TestRoutingProfile) {
+    const std::string xml = GridDocument(50);
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    const Model full{bytes, 1};
+    for (std::size_t threads : {1, 3}) {
+        const Model routing{bytes, threads, Model::Profile::Routing};
+        EXPECT_TRUE(routing.Buildings().empty());
+        EXPECT_TRUE(routing.Leisures().empty());
+        EXPECT_TRUE(routing.Waters().empty());
+        EXPECT_TRUE(routing.Landuses().empty());
+        EXPECT_TRUE(routing.Railways().empty());
+        ASSERT_EQ(routing.Roads().size(), full.Roads().size());
+        ASSERT_EQ(routing.Ways().size(), full.Roads().size());
+        EXPECT_EQ(routing.Nodes().size(), 50 * 50 - 8 * 50);  // Rows 0, 7, ..., 49 are buildings
+
+        std::vector<bool> referenced(routing.Nodes().size(), false);
+        for (std::size_t i = 0; i < full.Roads().size(); ++i) {
+            const auto& road = routing.Roads()[i];
+            const auto& full_road = full.Roads()[i];
+            EXPECT_EQ(road.type, full_road.type);
+            EXPECT_EQ(routing.WayIds()[road.way], full.WayIds()[full_road.way]);
+            const auto nodes = routing.WayNodes(routing.Ways()[road.way]);
+            const auto full_nodes = full.WayNodes(full.Ways()[full_road.way]);
+            ASSERT_EQ(nodes.size(), full_nodes.size());
+            for (std::size_t j = 0; j < nodes.size(); ++j) {
+                EXPECT_EQ(routing.NodeIds()[nodes[j]], full.NodeIds()[full_nodes[j]]);
+                EXPECT_EQ(routing.Nodes()[nodes[j]].x, full.Nodes()[full_nodes[j]].x);
+                EXPECT_EQ(routing.Nodes()[nodes[j]].y, full.Nodes()[full_nodes[j]].y);
+                referenced[nodes[j]] = true;
+            }
+        }
+        for (std::size_t i = 0; i < routing.Nodes().size(); ++i) {
+            EXPECT_TRUE(referenced[i]);
+            EXPECT_EQ(routing.Nodes()[i].Index(), i);
+            if (i > 0) {
+                EXPECT_LT(routing.NodeIds()[i - 1], routing.NodeIds()[i]);  // File order is kept
+            }
+        }
+    }
+
+    // A map without roads leaves nothing to route on
+    const std::string buildings = "<osm version=\"0.6\">\n"
+                                  " <bounds minlat=\"0\" minlon=\"0\" maxlat=\"0.01\" maxlon=\"0.01\"/>\n"
+                                  " <node id=\"1\" lat=\"0.001\" lon=\"0.001\"/>\n"
+                                  " <node id=\"2\" lat=\"0.009\" lon=\"0.009\"/>\n"
+                                  " <node id=\"3\" lat=\"0.001\" lon=\"0.009\"/>\n"
+                                  " <way id=\"10\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"1\"/>"
+                                  "<tag k=\"building\" v=\"yes\"/></way>\n"
+                                  "</osm>\n";
+    const Span<const std::byte> building_bytes{reinterpret_cast<const std::byte*>(buildings.data()), buildings.size()};
+    EXPECT_EQ(Model(building_bytes, 1).Buildings().size(), 1);
+    EXPECT_THROW(Model(building_bytes, 1, Model::Profile::Routing), std::invalid_argument);
+}
+
+
+// Test that clipping keeps the nodes inside the region only, splits roads where they leave it,
+// truncates areas to their nodes inside, and fits the map bounds to the region.
+TEST(ModelTest, TestClip) {
+    // Rows and columns 3 to 15 of the grid are inside, less rows and columns 8 to 12 in the hole
+    const std::string xml = GridDocument(20);
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    const auto region = ClipRegion::Polygon({{{0.0125, 0.0125}, {0.0125, 0.0775}, {0.0775, 0.0775}, {0.0775, 0.0125}},
+                                             {{0.0375, 0.0375}, {0.0375, 0.0625}, {0.0625, 0.0625}, {0.0625, 0.0375}}});
+    const Model serial{bytes, 1, Model::Profile::Full, &region};
+    EXPECT_EQ(serial.Nodes().size(), 13 * 13 - 5 * 5);
+    for (const auto& node : serial.Nodes()) {
+        EXPECT_GE(node.x, 0);
+        EXPECT_LE(node.x, 1);
+        EXPECT_GE(node.y, 0);
+        EXPECT_LE(node.y, 1);
+    }
+
+    // Rows 3 to 15 but the buildings 7 and 14, in two runs through the hole
+    std::vector<std::vector<int>> expected;
+    for (int r = 3; r <= 15; ++r) {
+        const auto row = [&](int first, int last) {
+            std::vector<int> ids;
+            for (int c = first; c <= last; ++c) ids.push_back(1000 + r * 20 + c);
+            return ids;
+        };
+        if (r == 7 || r == 14) continue;
+        if (r >= 8 && r <= 12) {
+            expected.push_back(row(3, 7));
+            expected.push_back(row(13, 15));
+        } else {
+            expected.push_back(row(3, 15));
+        }
+    }
+    const auto road_ids = [](const Model& model) {
+        std::vector<std::vector<int>> roads;
+        for (const auto& road : model.Roads()) {
+            auto& ids = roads.emplace_back();
+            for (const int node : model.WayNodes(model.Ways()[road.way])) ids.push_back(model.NodeIds()[node]);
+        }
+        return roads;
+    };
+    EXPECT_EQ(road_ids(serial), expected);
+    EXPECT_EQ(serial.WayIds()[serial.Roads()[4].way], serial.WayIds()[serial.Roads()[5].way]);  // Both runs of row 8
+
+    // The buildings of rows 7 and 14, then the relation, whose outer way in row 0 is outside
+    ASSERT_EQ(serial.Buildings().size(), 3);
+    for (int i = 0; i < 2; ++i) {
+        const auto outer = serial.OuterWays(serial.Buildings()[i]);
+        ASSERT_EQ(outer.size(), 1);
+        EXPECT_EQ(serial.WayNodes(serial.Ways()[outer.front()]).size(), 13);  // Columns 3 to 15
+        EXPECT_EQ(serial.WayIds()[outer.front()], 57 + 7 * i);
+    }
+    EXPECT_TRUE(serial.OuterWays(serial.Buildings()[2]).empty());
+    EXPECT_EQ(serial.InnerWays(serial.Buildings()[2]).size(), 1);
+
+    const Model parallel{bytes, 3, Model::Profile::Full, &region};
+    EXPECT_EQ(parallel.NodeIds(), serial.NodeIds());
+    EXPECT_EQ(parallel.WayIds(), serial.WayIds());
+    EXPECT_EQ(road_ids(parallel), expected);
+    const Model routing{bytes, 3, Model::Profile::Routing, &region};
+    EXPECT_EQ(road_ids(routing), expected);
+    EXPECT_LT(routing.Nodes().size(), serial.Nodes().size());
+
+    // A box outside the map bounds
+    const auto outside = ClipRegion::Box(1, 1, 2, 2);
+    EXPECT_THROW((Model{bytes, 1, Model::Profile::Full, &outside}), std::invalid_argument);
+
+    // A box within the bounds, but between the nodes of the grid, leaves nothing to route on
+    const auto between = ClipRegion::Box(0.0011, 0.0011, 0.0039, 0.0039);
+    EXPECT_TRUE((Model{bytes, 1, Model::Profile::Full, &between}).Nodes().empty());
+    EXPECT_THROW((RouteModel{bytes, 1, Model::Profile::Full, &between}), std::invalid_argument);
+}
+
+
+// An osmChange document for GridDocument(20): a new road and a new building, a moved node, a
+// retagged and shortened road, and a deleted road and building.
+static const std::string kGridChange = R"(<osmChange version="0.6">
+ <create>
+  <node id="5000" lat="0.0275" lon="0.0025"/>
+  <way id="99"><nd ref="1060"/><nd ref="5000"/><nd ref="1021"/><tag k="highway" v="primary"/></way>
+  <way id="98"><nd ref="1100"/><nd ref="1101"/><nd ref="1121"/><nd ref="1100"/><tag k="building" v="yes"/></way>
+ </create>
+ <modify>
+  <node id="1001" lat="0.05" lon="0.05"/>
+  <way id="51"><nd ref="1020"/><nd ref="1021"/><nd ref="1022"/><tag k="highway" v="footway"/></way>
+ </modify>
+ <delete>
+  <way id="52"/>
+  <way id="57"/>
+ </delete>
+</osmChange>
+)";
+
+
+// Test that a change creates, modifies and deletes nodes and ways in place, that the roads and
+// areas follow, and that a malformed document leaves the model unchanged.
+TEST(ModelTest, TestApplyChange) {
+    const std::string xml = GridDocument(20);
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    const Span<const std::byte> change{reinterpret_cast<const std::byte*>(kGridChange.data()), kGridChange.size()};
+    const auto road_ids = [](const Model& model) {
+        std::vector<std::pair<std::int64_t, std::vector<std::int64_t>>> roads;
+        for (const auto& road : model.Roads()) {
+            auto& [way_id, ids] = roads.emplace_back(model.WayIds()[road.way], std::vector<std::int64_t>{});
+            for (const int node : model.WayNodes(model.Ways()[road.way])) ids.push_back(model.NodeIds()[node]);
+        }
+        std::sort(roads.begin(), roads.end());
+        return roads;
+    };
+
+    Model model{bytes, 1};
+    EXPECT_EQ(model.ApplyChange(change), 7);
+    ASSERT_EQ(model.Nodes().size(), 401);
+    EXPECT_EQ(model.NodeIds().back(), 5000);
+    EXPECT_NEAR(model.Nodes()[1].x, 0.5, 1e-3);
+    EXPECT_NEAR(model.Nodes()[1].y, 0.5, 1e-3);
+    EXPECT_NEAR(model.Nodes()[400].x, 0.025, 1e-3);
+    EXPECT_NEAR(model.Nodes()[400].y, 0.275, 1e-3);
+
+    // Rows 1 and 3 to 19 but the buildings 7 and 14, then the new road
+    auto roads = road_ids(model);
+    ASSERT_EQ(roads.size(), 17);
+    EXPECT_EQ(roads[0], (std::pair<std::int64_t, std::vector<std::int64_t>>{51, {1020, 1021, 1022}}));
+    EXPECT_EQ(roads[1].first, 53);
+    EXPECT_EQ(roads[16], (std::pair<std::int64_t, std::vector<std::int64_t>>{99, {1060, 5000, 1021}}));
+    EXPECT_TRUE(std::is_sorted(model.Roads().begin(), model.Roads().end(),
+                               [](const auto& first, const auto& second) { return first.type < second.type; }));
+    EXPECT_EQ(model.Roads().back().type, Model::Road::Footway);
+    EXPECT_EQ(model.WayIds()[7], 0);
+    EXPECT_TRUE(model.WayNodes(model.Ways()[7]).empty());
+
+    // The buildings of rows 0 and 14, the relation of rows 0 and 7, and the new building
+    ASSERT_EQ(model.Buildings().size(), 4);
+    EXPECT_EQ(model.WayIds()[model.OuterWays(model.Buildings()[1]).front()], 64);
+    EXPECT_EQ(ToVector(model.OuterWays(model.Buildings()[2])), std::vector<int>{0});
+    EXPECT_EQ(model.WayIds()[model.OuterWays(model.Buildings()[3]).front()], 98);
+
+    // Without buildings and with dense nodes under the routing profile
+    Model routing{bytes, 1, Model::Profile::Routing};
+    routing.ApplyChange(change, Model::Profile::Routing);
+    EXPECT_EQ(road_ids(routing), roads);
+    EXPECT_TRUE(routing.Buildings().empty());
+    EXPECT_EQ(routing.Nodes().size(), 17 * 20 - 20 - 17 + 1);  // Less the nodes no road refers to any more
+    for (std::size_t i = 0; i < routing.Nodes().size(); ++i) {
+        EXPECT_EQ(routing.Nodes()[i].Index(), i);
+    }
+
+    // The routing graph takes the new road
+    RouteModel route_model{bytes, 1};
+    route_model.ApplyChange(change);
+    const auto neighbors = route_model.Neighbors(400);
+    ASSERT_EQ(neighbors.size(), 2);
+    EXPECT_EQ(route_model.NodeIds()[neighbors[0]], 1021);
+    EXPECT_EQ(route_model.NodeIds()[neighbors[1]], 1060);
+
+    // Malformed and plain documents are rejected before anything changes
+    const auto nodes = model.NodeIds();
+    const std::string truncated = kGridChange.substr(0, kGridChange.size() - 20);
+    EXPECT_THROW(model.ApplyChange({reinterpret_cast<const std::byte*>(truncated.data()), truncated.size()}),
+                 std::logic_error);
+    EXPECT_THROW(model.ApplyChange(bytes), std::logic_error);
+    EXPECT_EQ(model.NodeIds(), nodes);
+    EXPECT_EQ(road_ids(model), roads);
+}
+
+
+// Test that under the routing profile, a change making a road of nodes the model dropped on load
+// is rejected, unless it lists those nodes.
+TEST(ModelTest, TestApplyChangeRetag) {
+    const std::string xml = GridDocument(20);
+    const Span<const std::byte> bytes{reinterpret_cast<const std::byte*>(xml.data()), xml.size()};
+    const std::string retag = R"(<osmChange version="0.6">
+ <modify>
+  <way id="57"><nd ref="1140"/><nd ref="1141"/><nd ref="1142"/><tag k="highway" v="residential"/></way>
+ </modify>
+</osmChange>
+)";
+    const std::string listed = R"(<osmChange version="0.6">
+ <modify>
+  <node id="1140" lat="0.035" lon="0"/>
+  <node id="1141" lat="0.035" lon="0.005"/>
+  <node id="1142" lat="0.035" lon="0.01"/>
+  <way id="57"><nd ref="1140"/><nd ref="1141"/><nd ref="1142"/><tag k="highway" v="residential"/></way>
+ </modify>
+</osmChange>
+)";
+    const Span<const std::byte> retag_bytes{reinterpret_cast<const std::byte*>(retag.data()), retag.size()};
+    const Span<const std::byte> listed_bytes{reinterpret_cast<const std::byte*>(listed.data()), listed.size()};
+    const auto road_nodes = [](const Model& model, std::int64_t id) {
+        std::vector<std::int64_t> ids;
+        for (const auto& road : model.Roads()) {
+            if (model.WayIds()[road.way] != id) continue;
+            for (const int node : model.WayNodes(model.Ways()[road.way])) ids.push_back(model.NodeIds()[node]);
+        }
+        return ids;
+    };
+    const std::vector<std::int64_t> expected{1140, 1141, 1142};
+
+    Model full{bytes, 1};
+    full.ApplyChange(retag_bytes);
+    EXPECT_EQ(road_nodes(full, 57), expected);
+
+    Model routing{bytes, 1, Model::Profile::Routing};
+    const auto nodes = routing.NodeIds();
+    const auto roads = routing.Roads().size();
+    EXPECT_THROW(routing.ApplyChange(retag_bytes, Model::Profile::Routing), std::logic_error);
+    EXPECT_EQ(routing.NodeIds(), nodes);
+    EXPECT_EQ(routing.Roads().size(), roads);
+
+    routing.ApplyChange(listed_bytes, Model::Profile::Routing);
+    EXPECT_EQ(road_nodes(routing, 57), expected);
+}
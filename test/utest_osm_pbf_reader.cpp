@@ -0,0 +1,300 @@
+#include "gtest/gtest.h"
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+#include "../src/mapped_file.h"
+#include "../src/model.h"
+#include "../src/osm_pbf_reader.h"
+#include "../src/osm_xml_reader.h"
+
+//--------------------------------//
+//   Beginning OsmPbfReader Tests.
+//--------------------------------//
+
+namespace {
+
+// An element reported by a reader.
+struct Element {
+    enum Kind { Bounds, Node, Way, Relation } kind;
+    OsmId id = 0;
+    std::vector<double> coords;  // lat, lon of a node; min_lat, min_lon, max_lat, max_lon of the bounds
+    std::vector<OsmId> refs;
+    std::vector<std::pair<std::string, std::string>> tags;
+    std::vector<std::tuple<std::string, OsmId, std::string>> members;
+
+    Element(Kind kind, OsmId id, std::vector<double> coords = {}) : kind(kind), id(id), coords(std::move(coords)) {}
+
+    bool operator==(const Element& other) const {
+        return std::tie(kind, id, coords, refs, tags, members) ==
+               std::tie(other.kind, other.id, other.coords, other.refs, other.tags, other.members);
+    }
+};
+
+// Records every element reported by a reader.
+class RecordingHandler : public OsmHandler {
+  public:
+    void Bounds(double min_lat, double min_lon, double max_lat, double max_lon) override {
+        elements.emplace_back(Element::Bounds, 0, std::vector<double>{min_lat, min_lon, max_lat, max_lon});
+    }
+    void Node(OsmId id, double lat, double lon) override { elements.emplace_back(Element::Node, id, std::vector<double>{lat, lon}); }
+    void Way(OsmId id, const std::vector<OsmId>& refs, const std::vector<OsmTag>& tags) override {
+        auto& way = elements.emplace_back(Element::Way, id);
+        way.refs = refs;
+        for (const auto& tag : tags) way.tags.emplace_back(tag.key, tag.value);
+    }
+    void Relation(OsmId id, const std::vector<OsmMember>& members, const std::vector<OsmTag>& tags) override {
+        auto& relation = elements.emplace_back(Element::Relation, id);
+        for (const auto& m : members) relation.members.emplace_back(m.type, m.ref, m.role);
+        for (const auto& tag : tags) relation.tags.emplace_back(tag.key, tag.value);
+    }
+
+    std::vector<Element> elements;
+};
+
+// Writes protocol buffer messages.
+class ProtoWriter {
+  public:
+    void Varint(std::uint32_t field, std::uint64_t value) {
+        Raw(field << 3);
+        Raw(value);
+    }
+    void Signed(std::uint32_t field, std::int64_t value) { Varint(field, ZigZag(value)); }
+    void Bytes(std::uint32_t field, std::string_view bytes) {
+        Raw(field << 3 | 2);
+        Raw(bytes.size());
+        out += bytes;
+    }
+    void Packed(std::uint32_t field, const std::vector<std::uint64_t>& values) {
+        ProtoWriter packed;
+        for (auto value : values) packed.Raw(value);
+        Bytes(field, packed.out);
+    }
+    static std::uint64_t ZigZag(std::int64_t value) {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    std::string out;
+
+  private:
+    void Raw(std::uint64_t value) {
+        for (; value >= 0x80; value >>= 7) out += static_cast<char>(value | 0x80);
+        out += static_cast<char>(value);
+    }
+};
+
+// Appends a blob to a PBF file, zlib-compressed or raw.
+void WriteBlob(std::string& file, std::string_view type, const std::string& block, bool compress) {
+    ProtoWriter blob;
+    if (compress) {
+        std::string compressed(compressBound(block.size()), '\0');
+        uLongf size = compressed.size();
+        compress2(reinterpret_cast<Bytef*>(compressed.data()), &size, reinterpret_cast<const Bytef*>(block.data()),
+                  block.size(), Z_DEFAULT_COMPRESSION);
+        compressed.resize(size);
+        blob.Varint(2, block.size());
+        blob.Bytes(3, compressed);
+    } else {
+        blob.Bytes(1, block);
+    }
+    ProtoWriter header;
+    header.Bytes(1, type);
+    header.Varint(3, blob.out.size());
+    for (int shift = 24; shift >= 0; shift -= 8) file += static_cast<char>(header.out.size() >> shift);
+    file += header.out + blob.out;
+}
+
+// Converts degrees to the default PBF coordinate unit of 100 nanodegrees.
+std::int64_t Units(double degrees) { return std::llround(degrees * 1e7); }
+
+// Encodes elements as a PBF file, with the nodes as dense nodes and at most block_size elements
+// of one kind per block. Every other block is compressed.
+std::string WritePbf(const std::vector<Element>& elements, std::size_t block_size,
+                     const std::vector<std::string>& features = {"OsmSchema-V0.6", "DenseNodes"}) {
+    std::string file;
+    ProtoWriter header;
+    for (const auto& e : elements) {
+        if (e.kind != Element::Bounds) continue;
+        ProtoWriter bbox;
+        bbox.Signed(1, Units(e.coords[1]) * 100);
+        bbox.Signed(2, Units(e.coords[3]) * 100);
+        bbox.Signed(3, Units(e.coords[2]) * 100);
+        bbox.Signed(4, Units(e.coords[0]) * 100);
+        header.Bytes(1, bbox.out);
+    }
+    for (const auto& feature : features) header.Bytes(4, feature);
+    WriteBlob(file, "OSMHeader", header.out, false);
+
+    std::size_t blocks = 0;
+    for (std::size_t first = 0; first < elements.size();) {
+        const auto kind = elements[first].kind;
+        if (kind == Element::Bounds) {
+            ++first;
+            continue;
+        }
+        std::size_t last = first;
+        while (last < elements.size() && elements[last].kind == kind && last - first < block_size) ++last;
+
+        std::vector<std::string> strings{""};
+        const auto index = [&](const std::string& s) -> std::uint64_t {
+            for (std::size_t i = 0; i < strings.size(); ++i) {
+                if (strings[i] == s) return i;
+            }
+            strings.push_back(s);
+            return strings.size() - 1;
+        };
+        ProtoWriter group;
+        if (kind == Element::Node) {
+            std::vector<std::uint64_t> ids, lats, lons;
+            std::int64_t id = 0, lat = 0, lon = 0;
+            for (std::size_t i = first; i < last; ++i) {
+                const auto& e = elements[i];
+                ids.push_back(ProtoWriter::ZigZag(e.id - id));
+                lats.push_back(ProtoWriter::ZigZag(Units(e.coords[0]) - lat));
+                lons.push_back(ProtoWriter::ZigZag(Units(e.coords[1]) - lon));
+                id = e.id;
+                lat = Units(e.coords[0]);
+                lon = Units(e.coords[1]);
+            }
+            ProtoWriter dense;
+            dense.Packed(1, ids);
+            dense.Packed(8, lats);
+            dense.Packed(9, lons);
+            group.Bytes(2, dense.out);
+        }
+        for (std::size_t i = first; i < last && kind != Element::Node; ++i) {
+            const auto& e = elements[i];
+            ProtoWriter element;
+            element.Varint(1, e.id);
+            std::vector<std::uint64_t> keys, values, roles, refs, types;
+            for (const auto& [key, value] : e.tags) {
+                keys.push_back(index(key));
+                values.push_back(index(value));
+            }
+            element.Packed(2, keys);
+            element.Packed(3, values);
+            OsmId previous = 0;
+            if (kind == Element::Way) {
+                for (auto ref : e.refs) {
+                    refs.push_back(ProtoWriter::ZigZag(ref - previous));
+                    previous = ref;
+                }
+                element.Packed(8, refs);
+                group.Bytes(3, element.out);
+            } else {
+                for (const auto& [type, ref, role] : e.members) {
+                    roles.push_back(index(role));
+                    refs.push_back(ProtoWriter::ZigZag(ref - previous));
+                    types.push_back(type == "node" ? 0 : type == "way" ? 1 : 2);
+                    previous = ref;
+                }
+                element.Packed(8, roles);
+                element.Packed(9, refs);
+                element.Packed(10, types);
+                group.Bytes(4, element.out);
+            }
+        }
+
+        ProtoWriter table, block;
+        for (const auto& s : strings) table.Bytes(1, s);
+        block.Bytes(1, table.out);
+        block.Bytes(2, group.out);
+        if (blocks % 2 == 1) block.Varint(17, 100);  // Coordinate unit after the groups
+        WriteBlob(file, "OSMData", block.out, blocks++ % 2 == 0);
+        first = last;
+    }
+    return file;
+}
+
+Span<const std::byte> Bytes(const std::string& s) { return {reinterpret_cast<const std::byte*>(s.data()), s.size()}; }
+
+}  // namespace
+
+class OsmPbfReaderTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    std::vector<Element> xml_elements = ReadXml();
+    std::string pbf = WritePbf(xml_elements, 500);
+
+    std::vector<Element> ReadXml() {
+        RecordingHandler handler;
+        OsmXmlReader::Parse({reinterpret_cast<const char*>(osm_data->Bytes().data()), osm_data->Bytes().size()}, handler);
+        return handler.elements;
+    }
+};
+
+
+// Test that a PBF file reports exactly the elements of the XML it was converted from.
+TEST_F(OsmPbfReaderTest, TestMatchesXml) {
+    ASSERT_TRUE(OsmPbfReader::Matches(Bytes(pbf)));
+    EXPECT_FALSE(OsmPbfReader::Matches(osm_data->Bytes()));
+    EXPECT_FALSE(OsmPbfReader::Matches({}));
+
+    RecordingHandler handler;
+    OsmPbfReader::Parse(Bytes(pbf), handler);
+    ASSERT_EQ(handler.elements.size(), xml_elements.size());
+    for (std::size_t i = 0; i < xml_elements.size(); ++i) {
+        ASSERT_EQ(handler.elements[i], xml_elements[i]) << "element " << i;
+    }
+}
+
+
+// Test that the pieces of a split file cover it in whole blobs and parse to the same elements.
+TEST_F(OsmPbfReaderTest, TestSplit) {
+    const auto pieces = OsmPbfReader::Split(Bytes(pbf), 4, 1);
+    ASSERT_EQ(pieces.size(), 4);
+    RecordingHandler handler;
+    auto next = Bytes(pbf).data();
+    for (const auto& piece : pieces) {
+        EXPECT_EQ(piece.data(), next);
+        next = piece.end();
+        OsmPbfReader::Parse(piece, handler);
+    }
+    EXPECT_EQ(next, Bytes(pbf).end());
+    EXPECT_TRUE(handler.elements == xml_elements);
+    EXPECT_EQ(OsmPbfReader::Split(Bytes(pbf), 4).size(), 1);  // Below the minimum piece size
+}
+
+
+// Test that a model loads the same from PBF and XML data.
+TEST_F(OsmPbfReaderTest, TestModel) {
+    const Model xml_model{osm_data->Bytes()};
+    const Model model{Bytes(pbf)};
+    ASSERT_EQ(model.Nodes().size(), xml_model.Nodes().size());
+    for (std::size_t i = 0; i < model.Nodes().size(); ++i) {
+        EXPECT_EQ(model.Nodes()[i].x, xml_model.Nodes()[i].x);
+        EXPECT_EQ(model.Nodes()[i].y, xml_model.Nodes()[i].y);
+    }
+    EXPECT_EQ(model.NodeIds(), xml_model.NodeIds());
+    EXPECT_EQ(model.WayIds(), xml_model.WayIds());
+    for (std::size_t i = 0; i < model.Ways().size(); ++i) {
+        const auto nodes = model.WayNodes(model.Ways()[i]), xml_nodes = xml_model.WayNodes(xml_model.Ways()[i]);
+        EXPECT_TRUE(std::equal(nodes.begin(), nodes.end(), xml_nodes.begin(), xml_nodes.end()));
+    }
+    EXPECT_EQ(model.Roads().size(), xml_model.Roads().size());
+    EXPECT_EQ(model.Buildings().size(), xml_model.Buildings().size());
+    EXPECT_EQ(model.Landuses().size(), xml_model.Landuses().size());
+}
+
+
+// Test that corrupt files and unsupported features are rejected.
+TEST_F(OsmPbfReaderTest, TestErrors) {
+    RecordingHandler handler;
+    EXPECT_THROW(OsmPbfReader::Parse(Bytes(pbf.substr(0, pbf.size() - 10)), handler), std::logic_error);
+    EXPECT_THROW(OsmPbfReader::Split(Bytes(pbf.substr(0, pbf.size() / 2)), 2), std::logic_error);
+
+    auto corrupt = pbf;
+    const auto data = corrupt.find("OSMData");
+    corrupt.replace(data + 20, 16, 16, '\x55');  // Inside the first, compressed block
+    EXPECT_THROW(OsmPbfReader::Parse(Bytes(corrupt), handler), std::logic_error);
+
+    const auto historical = WritePbf(xml_elements, 500, {"OsmSchema-V0.6", "HistoricalInformation"});
+    EXPECT_THROW(OsmPbfReader::Parse(Bytes(historical), handler), std::logic_error);
+    EXPECT_THROW((Model{Bytes(historical)}), std::logic_error);
+}
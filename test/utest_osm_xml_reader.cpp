@@ -0,0 +1,179 @@
+#include "gtest/gtest.h"
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../src/osm_xml_reader.h"
+
+//--------------------------------//
+//   Beginning OsmXmlReader Tests.
+//--------------------------------//
+
+// Records every element as one line of text.
+class RecordingHandler : public OsmHandler {
+  public:
+    void Bounds(double min_lat, double min_lon, double max_lat, double max_lon) override {
+        log.push_back("bounds " + std::to_string(min_lat) + " " + std::to_string(min_lon) + " " +
+                      std::to_string(max_lat) + " " + std::to_string(max_lon));
+    }
+    void Node(OsmId id, double lat, double lon) override {
+        log.push_back("node " + std::to_string(id) + " " + std::to_string(lat) + " " + std::to_string(lon));
+    }
+    void Way(OsmId id, const std::vector<OsmId>& refs, const std::vector<OsmTag>& tags) override {
+        std::string line = "way " + std::to_string(id);
+        for (auto ref : refs) line += " nd:" + std::to_string(ref);
+        for (auto& tag : tags) line += " " + std::string{tag.key} + "=" + std::string{tag.value};
+        log.push_back(line);
+    }
+    void Relation(OsmId id, const std::vector<OsmMember>& members, const std::vector<OsmTag>& tags) override {
+        std::string line = "relation " + std::to_string(id);
+        for (auto& m : members) line += " " + std::string{m.type} + ":" + std::to_string(m.ref) + ":" + std::string{m.role};
+        for (auto& tag : tags) line += " " + std::string{tag.key} + "=" + std::string{tag.value};
+        log.push_back(line);
+    }
+    void Section(OsmAction action) override {
+        log.push_back(action == OsmAction::Create ? "create" : action == OsmAction::Modify ? "modify" : "delete");
+    }
+
+    std::vector<std::string> log;
+};
+
+static const std::string kDocument = R"(<?xml version="1.0" encoding="UTF-8"?>
+<!-- extract -->
+<osm version="0.6" generator="test">
+ <bounds minlat="20.2" minlon="85.78" maxlat="20.3" maxlon="85.88"/>
+ <node id="1" lat="20.25" lon="85.8" user="a &gt; b"/>
+ <node id='2' lat='20.26' lon='85.81'><tag k="name" v="x"/></node>
+ <changeset id="9"><tag k="comment" v="skipped"/></changeset>
+ <way id="10">
+  <nd ref="1"/>
+  <nd ref="2"/>
+  <!-- a comment inside a way -->
+  <tag k="highway" v="residential"/>
+  <tag k="name" v="Fish &amp; Chips &#x263A; &#65;"/>
+ </way>
+ <relation id="20">
+  <member type="way" ref="10" role="outer"/>
+  <member type="node" ref="1" role=""/>
+  <tag k="type" v="multipolygon"/>
+ </relation>
+</osm>
+)";
+
+
+// Test that every element is reported once, in order, with decoded values.
+TEST(OsmXmlReaderTest, TestParseDocument) {
+    RecordingHandler handler;
+    OsmXmlReader::Parse(kDocument, handler);
+    std::vector<std::string> expected{
+        "bounds 20.200000 85.780000 20.300000 85.880000",
+        "node 1 20.250000 85.800000",
+        "node 2 20.260000 85.810000",
+        "way 10 nd:1 nd:2 highway=residential name=Fish & Chips ☺ A",
+        "relation 20 way:10:outer node:1: type=multipolygon",
+    };
+    EXPECT_EQ(handler.log, expected);
+}
+
+
+// Test that feeding the document in small chunks gives the same result.
+TEST(OsmXmlReaderTest, TestChunkedFeed) {
+    RecordingHandler whole;
+    OsmXmlReader::Parse(kDocument, whole);
+
+    for (std::size_t chunk : {1, 2, 7, 64}) {
+        RecordingHandler handler;
+        OsmXmlReader reader{handler};
+        for (std::size_t i = 0; i < kDocument.size(); i += chunk) {
+            reader.Feed(kDocument.data() + i, std::min(chunk, kDocument.size() - i));
+        }
+        reader.Finish();
+        EXPECT_EQ(handler.log, whole.log) << "chunk size " << chunk;
+    }
+}
+
+
+// Test that a document split into pieces parses to the same elements, piece by piece.
+TEST(OsmXmlReaderTest, TestSplitPieces) {
+    RecordingHandler whole;
+    OsmXmlReader::Parse(kDocument, whole);
+
+    for (std::size_t count : {1, 2, 3, 10}) {
+        const auto pieces = OsmXmlReader::Split(kDocument, count, 1);
+        ASSERT_GE(pieces.size(), 1);
+        ASSERT_LE(pieces.size(), count);
+        RecordingHandler handler;
+        std::string joined;
+        for (std::size_t i = 0; i < pieces.size(); ++i) {
+            OsmXmlReader::ParsePiece(pieces[i], i == 0, i + 1 == pieces.size(), handler);
+            joined += pieces[i];
+        }
+        EXPECT_EQ(joined, kDocument);
+        EXPECT_EQ(handler.log, whole.log) << "pieces " << count;
+    }
+    EXPECT_EQ(OsmXmlReader::Split(kDocument, 4).size(), 1);  // Too small to be worth splitting
+}
+
+
+// Test that malformed or truncated input is rejected.
+TEST(OsmXmlReaderTest, TestMalformedInput) {
+    RecordingHandler handler;
+    EXPECT_THROW(OsmXmlReader::Parse(kDocument.substr(0, kDocument.size() / 2), handler), std::logic_error);
+    EXPECT_THROW(OsmXmlReader::Parse("<osm><way id=\"1\"></node></osm>", handler), std::logic_error);
+    EXPECT_THROW(OsmXmlReader::Parse("<osm><node id=1/></osm>", handler), std::logic_error);
+    EXPECT_THROW(OsmXmlReader::Parse("", handler), std::logic_error);
+    EXPECT_THROW(OsmXmlReader::Parse("<osm><node id=\"n1\" lat=\"1\" lon=\"2\"/></osm>", handler), std::invalid_argument);
+    EXPECT_THROW(OsmXmlReader::Parse("<osm><way id=\"1\"><nd ref=\"\"/></way></osm>", handler), std::invalid_argument);
+}
+
+
+// Test that IDs are parsed as 64-bit integers, including negative IDs of unsaved edits.
+TEST(OsmXmlReaderTest, TestIds) {
+    RecordingHandler handler;
+    OsmXmlReader::Parse(R"(<osm>
+ <node id="12345678901" lat="1" lon="2"/>
+ <node id="-7" lat="1" lon="2"/>
+ <way id="+0042"><nd ref="12345678901"/><nd ref="-7"/></way>
+</osm>)", handler);
+    std::vector<std::string> expected{
+        "node 12345678901 1.000000 2.000000",
+        "node -7 1.000000 2.000000",
+        "way 42 nd:12345678901 nd:-7",
+    };
+    EXPECT_EQ(handler.log, expected);
+}
+
+
+// Test that the elements of an osmChange document follow their sections, that deleted nodes may
+// lack coordinates, and that other elements under the root are skipped.
+TEST(OsmXmlReaderTest, TestChangeDocument) {
+    RecordingHandler handler;
+    OsmXmlReader::Parse(R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6" generator="test">
+ <create>
+  <node id="3" lat="20.27" lon="85.82"/>
+  <way id="11"><nd ref="1"/><nd ref="3"/><tag k="highway" v="service"/></way>
+ </create>
+ <modify><node id="1" lat="20.2" lon="85.9"/></modify>
+ <note><node id="4" lat="1" lon="2"/></note>
+ <delete>
+  <way id="10" version="3"/>
+  <node id="2" version="2"/>
+ </delete>
+ <delete/>
+</osmChange>
+)", handler);
+    std::vector<std::string> expected{
+        "create",
+        "node 3 20.270000 85.820000",
+        "way 11 nd:1 nd:3 highway=service",
+        "modify",
+        "node 1 20.200000 85.900000",
+        "delete",
+        "way 10",
+        "node 2 0.000000 0.000000",
+    };
+    EXPECT_EQ(handler.log, expected);
+
+    EXPECT_THROW(OsmXmlReader::Parse("<osmChange><modify><node id=\"1\"/></modify></osmChange>", handler),
+                 std::invalid_argument);
+}
@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "../src/priority_queue.h"
+
+//--------------------------------//
+//   Beginning Priority Queue Tests.
+//--------------------------------//
+
+template <typename Queue>
+class PriorityQueueTest : public ::testing::Test {};
+
+using QueueTypes = ::testing::Types<IndexedDaryHeap<2>, IndexedDaryHeap<4>, PairingHeap>;
+TYPED_TEST_SUITE(PriorityQueueTest, QueueTypes);
+
+
+// Popping returns ids in ascending key order.
+TYPED_TEST(PriorityQueueTest, TestPopOrder) {
+    TypeParam queue{100};
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> key{0.f, 1000.f};
+    std::vector<float> keys(100);
+    for (int id = 0; id < 100; ++id) {
+        keys[id] = key(rng);
+        queue.Push(id, keys[id]);
+    }
+    EXPECT_EQ(queue.Size(), 100);
+
+    float last = -1.f;
+    while (!queue.Empty()) {
+        EXPECT_FLOAT_EQ(queue.TopKey(), keys[queue.TopId()]);
+        int id = queue.Pop();
+        EXPECT_FALSE(queue.Contains(id));
+        EXPECT_LE(last, keys[id]);
+        last = keys[id];
+    }
+}
+
+
+// Decrease-key moves ids ahead without duplicating them.
+TYPED_TEST(PriorityQueueTest, TestDecreaseKey) {
+    TypeParam queue{10};
+    for (int id = 0; id < 10; ++id) {
+        queue.Push(id, 10.f + id);
+    }
+    queue.DecreaseKey(7, 1.f);
+    EXPECT_FALSE(queue.PushOrDecrease(3, 20.f));
+    EXPECT_TRUE(queue.PushOrDecrease(5, 2.f));
+    EXPECT_EQ(queue.Size(), 10);
+
+    EXPECT_EQ(queue.Pop(), 7);
+    EXPECT_EQ(queue.Pop(), 5);
+    EXPECT_EQ(queue.Pop(), 0);
+    EXPECT_FLOAT_EQ(queue.Key(3), 13.f);
+
+    queue.Clear();
+    EXPECT_TRUE(queue.Empty());
+    EXPECT_FALSE(queue.Contains(3));
+    EXPECT_TRUE(queue.PushOrDecrease(3, 0.5f));
+    EXPECT_EQ(queue.Pop(), 3);
+}
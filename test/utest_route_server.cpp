@@ -0,0 +1,211 @@
+#include "gtest/gtest.h"
+#ifdef __linux__
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../src/batch_query.h"
+#include "../src/mapped_file.h"
+#include "../src/route_model.h"
+#include "../src/route_server.h"
+#include "../src/search_context.h"
+
+//--------------------------------//
+//   Beginning RouteServer Tests.
+//--------------------------------//
+
+class RouteServerTest : public ::testing::Test {
+  protected:
+    std::optional<MappedFile> osm_data = MappedFile::Open("../map.osm");
+    std::shared_ptr<const RouteModel> model = std::make_shared<const RouteModel>(osm_data->Bytes());
+    std::string socket_path = "utest_route_server_" + std::to_string(getpid()) + ".sock";
+
+    // Connects to the server, or returns -1.
+    int Connect() {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strcpy(address.sun_path, socket_path.c_str());
+        const int client = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(client, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            close(client);
+            return -1;
+        }
+        return client;
+    }
+
+    // Sends the queries over a new connection and returns everything the server replies.
+    std::string Query(const std::string& queries) {
+        const int client = Connect();
+        EXPECT_GE(client, 0);
+        std::thread sender{[&] {
+            EXPECT_EQ(send(client, queries.data(), queries.size(), MSG_NOSIGNAL), queries.size());
+            shutdown(client, SHUT_WR);
+        }};
+        std::string replies;
+        char buffer[4096];
+        for (ssize_t received; (received = recv(client, buffer, sizeof(buffer), 0)) > 0;) {
+            replies.append(buffer, received);
+        }
+        sender.join();
+        close(client);
+        return replies;
+    }
+
+    // Returns the expected reply to a single query line.
+    std::string Expected(const std::string& query, std::size_t line, const RouteModel* on = nullptr) {
+        SearchContext context;
+        std::string result;
+        AnswerQuery(on ? *on : *model, context, query, line, {}, result);
+        return result + '\n';
+    }
+
+    // Builds a small model of a grid of residential roads.
+    static std::shared_ptr<const RouteModel> GridModel(int size) {
+        std::string xml = "<osm version=\"0.6\">\n <bounds minlat=\"0\" minlon=\"0\" maxlat=\"0.01\" maxlon=\"0.01\"/>\n";
+        for (int r = 0; r < size; r++) {
+            for (int c = 0; c < size; c++) {
+                xml += " <node id=\"" + std::to_string(1 + r * size + c) + "\" lat=\"" + std::to_string(0.01 * r / (size - 1)) +
+                       "\" lon=\"" + std::to_string(0.01 * c / (size - 1)) + "\"/>\n";
+            }
+        }
+        for (int r = 0; r < size; r++) {
+            for (int vertical = 0; vertical < 2; vertical++) {
+                xml += " <way id=\"" + std::to_string(1 + 2 * r + vertical) + "\">\n";
+                for (int c = 0; c < size; c++) {
+                    const int node = vertical ? 1 + c * size + r : 1 + r * size + c;
+                    xml += "  <nd ref=\"" + std::to_string(node) + "\"/>\n";
+                }
+                xml += "  <tag k=\"highway\" v=\"residential\"/>\n </way>\n";
+            }
+        }
+        xml += "</osm>\n";
+        return std::make_shared<const RouteModel>(std::vector<std::byte>{reinterpret_cast<const std::byte*>(xml.data()),
+                                                                         reinterpret_cast<const std::byte*>(xml.data()) + xml.size()});
+    }
+};
+
+
+// Test that pipelined queries are answered in order, including invalid ones.
+TEST_F(RouteServerTest, TestPipelinedQueries) {
+    RouteServer server{{model}, socket_path, 3};
+    std::thread loop{[&] { server.Run(); }};
+
+    std::string queries, expected;
+    for (int i = 0; i < 40; i++) {
+        const auto query = std::to_string(i * 2.5) + " 10 " + std::to_string(97 - i * 2) + " 90";
+        queries += query + '\n';
+        expected += Expected(query, 2 * i + 1);
+        queries += "# comment\n";
+    }
+    queries += "10 10 bad";  // Last line without a line break
+    expected += "error 81\n";
+    EXPECT_EQ(Query(queries), expected);
+
+    server.Stop();
+    loop.join();
+}
+
+
+// Test that concurrent connections each receive their own replies.
+TEST_F(RouteServerTest, TestConcurrentClients) {
+    RouteServer server{{model}, socket_path, 2};
+    std::thread loop{[&] { server.Run(); }};
+
+    const std::string queries[] = {"10 10 90 90\n50 50 20 80\n", "90 20 62 12\n", "33 71 5 95\n10 10 90 90\n"};
+    std::string replies[3];
+    std::vector<std::thread> clients;
+    for (int i = 0; i < 3; i++) {
+        clients.emplace_back([&, i] { replies[i] = Query(queries[i]); });
+    }
+    for (auto& client : clients) client.join();
+    EXPECT_EQ(replies[0], Expected("10 10 90 90", 1) + Expected("50 50 20 80", 2));
+    EXPECT_EQ(replies[1], Expected("90 20 62 12", 1));
+    EXPECT_EQ(replies[2], Expected("33 71 5 95", 1) + Expected("10 10 90 90", 2));
+
+    server.Stop();
+    loop.join();
+}
+
+
+// Test that the socket file is removed when the server shuts down.
+TEST_F(RouteServerTest, TestShutdown) {
+    {
+        RouteServer server{{model}, socket_path};
+        EXPECT_EQ(access(socket_path.c_str(), F_OK), 0);
+        server.Stop();
+        server.Run();  // Returns at once
+    }
+    EXPECT_NE(access(socket_path.c_str(), F_OK), 0);
+    EXPECT_LT(Connect(), 0);
+    EXPECT_THROW((RouteServer{{model}, std::string(200, 'x')}), std::invalid_argument);
+    EXPECT_THROW((RouteServer{{}, socket_path}), std::invalid_argument);
+}
+
+
+// Test that queries after publishing a map are answered on the new map.
+TEST_F(RouteServerTest, TestPublish) {
+    RouteServer server{{model}, socket_path, 2};
+    std::thread loop{[&] { server.Run(); }};
+    const std::string query = "10 10 90 90";
+    EXPECT_EQ(Query(query + '\n'), Expected(query, 1));
+
+    const auto grid = GridModel(8);
+    server.Publish({grid});
+    EXPECT_EQ(server.Map()->model, grid);
+    EXPECT_EQ(Query(query + '\n'), Expected(query, 1, grid.get()));
+    EXPECT_NE(Expected(query, 1, grid.get()), Expected(query, 1));
+    EXPECT_THROW(server.Publish({}), std::invalid_argument);
+
+    // Publishing does not wait for the holders of the previous map, which stays valid for them
+    auto held = server.Map();
+    server.Publish({model});
+    EXPECT_EQ(server.Map()->model, model);
+    EXPECT_EQ(held->model, grid);
+    held.reset();
+    EXPECT_EQ(Query(query + '\n'), Expected(query, 1));
+
+    server.Stop();
+    loop.join();
+}
+
+
+// Test that a reload builds the new map in the background and keeps the old one if it fails.
+TEST_F(RouteServerTest, TestReload) {
+    RouteServer server{{model}, socket_path, 2};
+    std::thread loop{[&] { server.Run(); }};
+    std::atomic<int> reloads{0};
+    server.SetReloader([&] {
+        if (reloads++ == 0) throw std::runtime_error("Broken map");
+        ServedMap map;
+        map.model = GridModel(8);
+        return map;
+    });
+
+    const std::string query = "10 10 90 90";
+    server.Reload();
+    for (int i = 0; i < 2000 && reloads.load() == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(Query(query + '\n'), Expected(query, 1));
+    EXPECT_EQ(server.Map()->model, model);
+
+    server.Reload();
+    for (int i = 0; i < 2000 && server.Map()->model == model; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    const auto reloaded = server.Map()->model;
+    ASSERT_NE(reloaded, model);
+    EXPECT_EQ(reloads.load(), 2);
+    EXPECT_EQ(Query(query + '\n'), Expected(query, 1, reloaded.get()));
+
+    server.Stop();
+    loop.join();
+}
+#endif
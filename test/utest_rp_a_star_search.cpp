@@ -1,7 +1,10 @@
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <iostream>
 #include <optional>
+#include <thread>
 #include <vector>
 #include "../src/route_model.h"
 #include "../src/route_planner.h"
@@ -51,13 +54,13 @@ class RoutePlannerTest : public ::testing::Test {
     float start_y = 0.1;
     float end_x = 0.9;
     float end_y = 0.9;
-    RouteModel::Node* start_node = &model.FindClosestNode(start_x, start_y);
-    RouteModel::Node* end_node = &model.FindClosestNode(end_x, end_y);
+    const RouteModel::Node* start_node = &model.SNodes()[model.FindClosestNode(start_x, start_y)];
+    const RouteModel::Node* end_node = &model.SNodes()[model.FindClosestNode(end_x, end_y)];
 
     // Construct another node in the middle of the map for testing.
     float mid_x = 0.5;
     float mid_y = 0.5;
-    RouteModel::Node* mid_node = &model.FindClosestNode(mid_x, mid_y);
+    const RouteModel::Node* mid_node = &model.SNodes()[model.FindClosestNode(mid_x, mid_y)];
 };
 
 
@@ -70,25 +73,67 @@ TEST_F(RoutePlannerTest, TestCalculateHValue) {
 
 
 
+// Test the FindClosestNode method against a scan of all routable nodes.
+TEST_F(RoutePlannerTest, TestFindClosestNode) {
+    for (auto [x, y] : std::vector<std::pair<float, float>>{{0.1f, 0.1f}, {0.5f, 0.5f}, {0.9f, 0.2f}, {-0.5f, 1.5f}}) {
+        const RouteModel::Node& closest = model.SNodes()[model.FindClosestNode(x, y)];
+        EXPECT_GT(model.Neighbors(closest.Index()).size(), 0);
+
+        RouteModel::Node input;
+        input.x = x;
+        input.y = y;
+        for (const RouteModel::Node& node : model.SNodes()) {
+            if (!model.Neighbors(node.Index()).empty()) {
+                EXPECT_LE(input.distance(closest), input.distance(node));
+            }
+        }
+
+        auto nearest = model.FindClosestNodes(x, y, 5);
+        ASSERT_EQ(nearest.size(), 5);
+        EXPECT_EQ(nearest.front(), closest.Index());
+        float radius = input.distance(model.SNodes()[nearest.back()]) * 1.0001f;
+        EXPECT_GE(model.FindNodesWithinRadius(x, y, radius).size(), 5);
+    }
+}
+
+
 // Test the AddNeighbors method.
-bool NodesSame(RouteModel::Node* a, RouteModel::Node* b) { return a == b; }
+bool NodesSame(const RouteModel::Node* a, const RouteModel::Node* b) { return a == b; }
 TEST_F(RoutePlannerTest, TestAddNeighbors) {
     route_planner.AddNeighbors(start_node);
+    SearchContext& context = route_planner.Context();
+
+    // The neighbors are the adjacent nodes along the roads through start_node.
+    auto neighbor_indices = model.Neighbors(start_node->Index());
+    auto edge_lengths = model.NeighborDistances(start_node->Index());
+    ASSERT_EQ(neighbor_indices.size(), edge_lengths.size());
+    EXPECT_GT(neighbor_indices.size(), 0);
 
-    // Correct h and g values for the neighbors of start_node.
-    std::vector<float> start_neighbor_g_vals{ 0.051776856, 0.055291083, 0.082997195, 0.10671431 };
-    std::vector<float> start_neighbor_h_vals{ 1.0858033, 1.1831238, 1.0998145, 1.1828455 };
-    auto neighbors = start_node->neighbors;
-    std::sort(std::begin(neighbors), std::end(neighbors),
-        [](RouteModel::Node* a, RouteModel::Node* b) { return a->g_value < b->g_value; });
-    EXPECT_EQ(neighbors.size(), 4);
+    // Correct g and h values for the neighbors of start_node, in order of g.
+    std::vector<float> start_neighbor_g_vals{ 0.017637653, 0.024126023 };
+    std::vector<float> start_neighbor_h_vals{ 1.1490291, 1.1191038 };
+    std::vector<int> neighbors(neighbor_indices.begin(), neighbor_indices.end());
+    std::sort(neighbors.begin(), neighbors.end(), [&](int a, int b) { return context.G(a) < context.G(b); });
+    ASSERT_EQ(neighbors.size(), 2);
+    for (std::size_t i = 0; i < neighbors.size(); i++) {
+        EXPECT_FLOAT_EQ(context.G(neighbors[i]), start_neighbor_g_vals[i]);
+        EXPECT_FLOAT_EQ(route_planner.CalculateHValue(&model.SNodes()[neighbors[i]]), start_neighbor_h_vals[i]);
+    }
 
     // Check results for each neighbor.
-    for (int i = 0; i < neighbors.size(); i++) {
-        EXPECT_PRED2(NodesSame, neighbors[i]->parent, start_node);
-        EXPECT_FLOAT_EQ(neighbors[i]->g_value, start_neighbor_g_vals[i]);
-        EXPECT_FLOAT_EQ(neighbors[i]->h_value, start_neighbor_h_vals[i]);
-        EXPECT_EQ(neighbors[i]->visited, true);
+    for (std::size_t i = 0; i < neighbor_indices.size(); i++) {
+        int neighbor = neighbor_indices[i];
+        EXPECT_PRED2(NodesSame, &model.SNodes()[context.Parent(neighbor)], start_node);
+        EXPECT_FLOAT_EQ(edge_lengths[i], start_node->distance(model.SNodes()[neighbor]));
+        EXPECT_FLOAT_EQ(context.G(neighbor), edge_lengths[i]);
+        EXPECT_EQ(context.Reached(neighbor), true);
+    }
+
+    // The model itself is untouched: a new query starts from a clean context.
+    context.Prepare(model.SNodes().size());
+    for (int neighbor : neighbor_indices) {
+        EXPECT_EQ(context.Reached(neighbor), false);
+        EXPECT_EQ(context.Parent(neighbor), SearchContext::kNoParent);
     }
 }
 
@@ -96,8 +141,9 @@ TEST_F(RoutePlannerTest, TestAddNeighbors) {
 // Test the ConstructFinalPath method.
 TEST_F(RoutePlannerTest, TestConstructFinalPath) {
     // Construct a path.
-    mid_node->parent = start_node;
-    end_node->parent = mid_node;
+    SearchContext& context = route_planner.Context();
+    context.SetLabel(mid_node->Index(), start_node->distance(*mid_node), start_node->Index());
+    context.SetLabel(end_node->Index(), 0.0f, mid_node->Index());
     std::vector<RouteModel::Node> path = route_planner.ConstructFinalPath(end_node);
 
     // Test the path.
@@ -112,7 +158,7 @@ TEST_F(RoutePlannerTest, TestConstructFinalPath) {
 // Test the AStarSearch method.
 TEST_F(RoutePlannerTest, TestAStarSearch) {
     route_planner.AStarSearch();
-    EXPECT_EQ(model.path.size(), 33);
+    ASSERT_EQ(model.path.size(), 93);
     RouteModel::Node path_start = model.path.front();
     RouteModel::Node path_end = model.path.back();
     // The start_node and end_node x, y values should be the same as in the path.
@@ -120,5 +166,105 @@ TEST_F(RoutePlannerTest, TestAStarSearch) {
     EXPECT_FLOAT_EQ(start_node->y, path_start.y);
     EXPECT_FLOAT_EQ(end_node->x, path_end.x);
     EXPECT_FLOAT_EQ(end_node->y, path_end.y);
-    EXPECT_FLOAT_EQ(route_planner.GetDistance(), 873.41565);
+
+    // Consecutive path nodes are joined by graph edges, and the distance is their total length.
+    float length = 0.0f;
+    for (std::size_t i = 1; i < model.path.size(); i++) {
+        auto neighbors = model.Neighbors(model.path[i - 1].Index());
+        EXPECT_NE(std::find(neighbors.begin(), neighbors.end(), model.path[i].Index()), neighbors.end());
+        length += model.path[i].distance(model.path[i - 1]);
+    }
+    EXPECT_FLOAT_EQ(route_planner.GetDistance(), length * model.MetricScale());
+    EXPECT_FLOAT_EQ(route_planner.GetDistance(), 8953.9639);
+    EXPECT_GE(route_planner.GetDistance(), start_node->distance(*end_node) * model.MetricScale());
+}
+
+
+// Test that both open list engines find the same route.
+TEST_F(RoutePlannerTest, TestAStarSearchPairingHeap) {
+    route_planner.AStarSearch();
+    auto expected_distance = route_planner.GetDistance();
+    auto expected_size = model.path.size();
+
+    RouteModel pairing_model{osm_data};
+    RoutePlanner pairing_planner{pairing_model, 10, 10, 90, 90, RoutePlanner::QueueType::PairingHeap};
+    pairing_planner.AStarSearch();
+    EXPECT_EQ(pairing_model.path.size(), expected_size);
+    EXPECT_FLOAT_EQ(pairing_planner.GetDistance(), expected_distance);
+}
+
+
+// Test that the bidirectional search finds routes as short as the unidirectional search.
+TEST_F(RoutePlannerTest, TestBidirectionalSearch) {
+    const RouteModel& shared_model = model;
+    SearchContext context{shared_model.SNodes().size()};
+    std::vector<std::array<float, 4>> queries{{10, 10, 90, 90}, {50, 50, 50, 50}, {90, 20, 10, 80}};
+    for (int i = 0; i < 12; i++) {
+        queries.push_back({7.f * i, 95.f - 6.f * i, 100.f - 8.f * i, 3.f * i});
+    }
+
+    for (auto& q : queries) {
+        RoutePlanner forward{shared_model, context, q[0], q[1], q[2], q[3]};
+        forward.AStarSearch();
+        RoutePlanner bidirectional{shared_model, context, q[0], q[1], q[2], q[3]};
+        bidirectional.SetSearchMode(RoutePlanner::SearchMode::Bidirectional);
+        bidirectional.AStarSearch();
+
+        EXPECT_NEAR(bidirectional.GetDistance(), forward.GetDistance(), 1e-4f * std::max(1.f, forward.GetDistance()));
+        const auto& path = bidirectional.Path();
+        ASSERT_EQ(path.empty(), forward.Path().empty());
+        if (path.empty()) continue;
+        EXPECT_TRUE(path.size() == 1 || bidirectional.SettledNodeCount() > 0);
+        EXPECT_EQ(path.front().Index(), forward.Path().front().Index());
+        EXPECT_EQ(path.back().Index(), forward.Path().back().Index());
+        for (std::size_t i = 1; i < path.size(); i++) {
+            auto neighbors = model.Neighbors(path[i - 1].Index());
+            EXPECT_NE(std::find(neighbors.begin(), neighbors.end(), path[i].Index()), neighbors.end());
+        }
+    }
+
+    // A planner bound to a mutable model publishes the bidirectional path too.
+    route_planner.SetSearchMode(RoutePlanner::SearchMode::Bidirectional);
+    route_planner.AStarSearch();
+    EXPECT_EQ(model.path.size(), route_planner.Path().size());
+}
+
+
+// Test that concurrent searches on one shared model match the serial results.
+TEST_F(RoutePlannerTest, TestConcurrentSearches) {
+    const RouteModel& shared_model = model;
+    std::vector<std::array<float, 4>> queries;
+    for (int i = 0; i < 16; i++) {
+        queries.push_back({5.f + 5.f * i, 10.f, 90.f - 5.f * i, 85.f});
+    }
+
+    // Serial reference, reusing one context across queries.
+    std::vector<float> expected;
+    SearchContext serial_context{shared_model.SNodes().size()};
+    for (auto& q : queries) {
+        RoutePlanner planner{shared_model, serial_context, q[0], q[1], q[2], q[3]};
+        planner.AStarSearch();
+        expected.push_back(planner.GetDistance());
+    }
+
+    std::vector<float> results(queries.size());
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&, t] {
+            SearchContext context{shared_model.SNodes().size()};
+            for (std::size_t i = t; i < queries.size(); i += 4) {
+                auto& q = queries[i];
+                RoutePlanner planner{shared_model, context, q[0], q[1], q[2], q[3]};
+                planner.AStarSearch();
+                results[i] = planner.GetDistance();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (std::size_t i = 0; i < queries.size(); i++) {
+        EXPECT_FLOAT_EQ(results[i], expected[i]);
+    }
+    EXPECT_TRUE(model.path.empty());
 }
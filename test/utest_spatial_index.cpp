@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "../src/spatial_index.h"
+
+//--------------------------------//
+//   Beginning SpatialIndex Tests.
+//--------------------------------//
+
+class SpatialIndexTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        std::mt19937 rng{7};
+        std::uniform_real_distribution<double> coord{0.0, 1.0};
+        for (int id = 0; id < 2000; id++) {
+            points.push_back({coord(rng), coord(rng) * 0.5, id});
+        }
+        // Duplicate coordinates resolve to the smaller id.
+        points.push_back({points[10].x, points[10].y, 5000});
+        index = SpatialIndex(points);
+    }
+
+    // Brute-force reference: ids sorted by distance, then by id.
+    std::vector<int> SortedByDistance(double x, double y) const {
+        std::vector<SpatialIndex::Point> sorted = points;
+        std::sort(sorted.begin(), sorted.end(), [&](const auto& a, const auto& b) {
+            double da = (a.x - x) * (a.x - x) + (a.y - y) * (a.y - y);
+            double db = (b.x - x) * (b.x - x) + (b.y - y) * (b.y - y);
+            return da < db || (da == db && a.id < b.id);
+        });
+        std::vector<int> ids;
+        for (const auto& p : sorted) ids.push_back(p.id);
+        return ids;
+    }
+
+    std::vector<SpatialIndex::Point> points;
+    SpatialIndex index;
+    std::vector<std::pair<double, double>> queries{
+        {0.5, 0.25}, {0.0, 0.0}, {1.0, 0.5}, {-3.0, 0.2}, {0.3, 4.0}, {0.91, 0.07}, {0.123, 0.0}};
+};
+
+
+// Test the Nearest method against a linear scan.
+TEST_F(SpatialIndexTest, TestNearest) {
+    for (auto [x, y] : queries) {
+        EXPECT_EQ(index.Nearest(x, y), SortedByDistance(x, y).front());
+    }
+    EXPECT_EQ(index.Nearest(points[10].x, points[10].y), 10);
+    EXPECT_EQ(SpatialIndex{}.Nearest(0.5, 0.5), -1);
+}
+
+
+// Test the KNearest method against a linear scan.
+TEST_F(SpatialIndexTest, TestKNearest) {
+    for (auto [x, y] : queries) {
+        auto expected = SortedByDistance(x, y);
+        expected.resize(25);
+        EXPECT_EQ(index.KNearest(x, y, 25), expected);
+    }
+    EXPECT_EQ(index.KNearest(0.5, 0.5, 5000).size(), points.size());
+}
+
+
+// Test the WithinRadius method against a linear scan.
+TEST_F(SpatialIndexTest, TestWithinRadius) {
+    for (auto [x, y] : queries) {
+        for (double radius : {0.0, 0.01, 0.1, 0.7}) {
+            std::vector<int> expected;
+            for (int id : SortedByDistance(x, y)) {
+                const auto& p = id == 5000 ? points.back() : points[id];
+                if ((p.x - x) * (p.x - x) + (p.y - y) * (p.y - y) <= radius * radius) expected.push_back(id);
+            }
+            EXPECT_EQ(index.WithinRadius(x, y, radius), expected);
+        }
+    }
+}
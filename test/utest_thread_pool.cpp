@@ -0,0 +1,42 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "../src/thread_pool.h"
+
+//--------------------------------//
+//   Beginning ThreadPool Tests.
+//--------------------------------//
+
+// Test that submitted tasks deliver their results.
+TEST(ThreadPoolTest, TestSubmit) {
+    ThreadPool pool{3};
+    EXPECT_EQ(pool.Size(), 3);
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 100; ++i) {
+        results.push_back(pool.Submit([i] { return i * i; }));
+    }
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(results[i].get(), i * i);
+    }
+}
+
+
+// Test that ParallelFor runs every index once and rethrows the exception of the lowest index.
+TEST(ThreadPoolTest, TestParallelFor) {
+    ThreadPool pool{4};
+    std::vector<std::atomic<int>> calls(1000);
+    pool.ParallelFor(calls.size(), [&](std::size_t i) { ++calls[i]; });
+    for (const auto& c : calls) {
+        EXPECT_EQ(c.load(), 1);
+    }
+
+    try {
+        pool.ParallelFor(10, [](std::size_t i) {
+            if (i % 3 == 2) throw std::runtime_error(std::to_string(i));
+        });
+        FAIL() << "Expected an exception";
+    } catch (const std::runtime_error& e) {
+        EXPECT_STREQ(e.what(), "2");
+    }
+}